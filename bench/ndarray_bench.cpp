@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <benchmark/benchmark.h>
+#include <green/ndarray/ndarray_math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace green;
+
+namespace {
+  using complex_t = std::complex<double>;
+
+  /**
+   * Arrays of shape (nk, n, n) with about `bytes` bytes, at least a single block of n x n elements
+   */
+  struct size_class {
+    std::string name;
+    size_t      n;
+    size_t      bytes;
+  };
+
+  /**
+   * Single small per-k block, arrays that fit into cache and arrays that are much larger than cache. Size of the
+   * largest arrays in MiB is read from `GREEN_NDARRAY_BENCH_LARGE_MB`, e.g. 4096 for multi-GB tensors.
+   */
+  std::vector<size_class> size_classes() {
+    size_t large_mb = 512;
+    if (const char* env = std::getenv("GREEN_NDARRAY_BENCH_LARGE_MB")) large_mb = std::stoul(env);
+    return {
+        {"block", 8,  0                },
+        {"cache", 32, size_t(1) << 20  },
+        {"large", 64, large_mb << 20   }
+    };
+  }
+
+  template <typename T>
+  std::array<size_t, 3> shape_of(const size_class& c) {
+    return {std::max(c.bytes / (c.n * c.n * sizeof(T)), size_t(1)), c.n, c.n};
+  }
+
+  template <typename T>
+  ndarray::ndarray<T, 3> make_array(const size_class& c) {
+    ndarray::ndarray<T, 3> array(shape_of<T>(c), ndarray::uninitialized);
+    // every page is touched before the measurement
+    std::fill(array.begin(), array.end(), T(1.5));
+    return array;
+  }
+
+  /**
+   * Bandwidth of `std::memcpy` of `bytes` bytes as read plus written bytes per second, best of several runs
+   */
+  double memcpy_bandwidth(size_t bytes) {
+    static std::map<size_t, double> cache;
+    auto                            it = cache.find(bytes);
+    if (it != cache.end()) return it->second;
+    std::vector<char> src(bytes, 1);
+    std::vector<char> dst(bytes, 0);
+    const size_t      reps = std::max((size_t(1) << 26) / bytes, size_t(1));
+    double            best = std::numeric_limits<double>::max();
+    for (int run = 0; run < 5; ++run) {
+      auto start = std::chrono::steady_clock::now();
+      for (size_t r = 0; r < reps; ++r) {
+        std::memcpy(dst.data(), src.data(), bytes);
+        benchmark::ClobberMemory();
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      best                                  = std::min(best, elapsed.count() / double(reps));
+    }
+    return cache[bytes] = 2.0 * double(bytes) / best;
+  }
+
+  template <typename T>
+  size_t bytes_of(const std::array<size_t, 3>& shape) {
+    return shape[0] * shape[1] * shape[2] * sizeof(T);
+  }
+
+  template <typename T>
+  size_t bytes_of(const ndarray::ndarray<T, 3>& array) {
+    return array.size() * sizeof(T);
+  }
+
+  /**
+   * Run `body` in the benchmark loop. Report `traffic` bytes read and written per iteration as bytes per second and as
+   * a fraction of memcpy bandwidth for arrays of `array_bytes` bytes (`vs_memcpy`).
+   */
+  template <typename F>
+  void run(benchmark::State& state, size_t traffic, size_t array_bytes, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) body();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double                  total   = double(traffic) * double(state.iterations());
+    state.SetBytesProcessed(int64_t(total));
+    state.counters["vs_memcpy"] = total / elapsed.count() / memcpy_bandwidth(array_bytes);
+  }
+
+  template <typename T>
+  void bm_memcpy(benchmark::State& state, const size_class& c) {
+    auto a = make_array<T>(c);
+    auto b = make_array<T>(c);
+    run(state, 2 * bytes_of(a), bytes_of(a), [&]() {
+      std::memcpy(b.data(), a.data(), bytes_of(a));
+      benchmark::ClobberMemory();
+    });
+  }
+
+  template <typename T>
+  void bm_copy(benchmark::State& state, const size_class& c) {
+    auto a = make_array<T>(c);
+    run(state, 2 * bytes_of(a), bytes_of(a), [&]() {
+      auto r = a.copy();
+      benchmark::DoNotOptimize(r.data());
+    });
+  }
+
+  template <typename T>
+  void bm_assign(benchmark::State& state, const size_class& c) {
+    auto a = make_array<T>(c);
+    auto b = make_array<T>(c);
+    run(state, 2 * bytes_of(a), bytes_of(a), [&]() {
+      b << a;
+      benchmark::ClobberMemory();
+    });
+  }
+
+  template <typename T, typename T2>
+  void bm_astype(benchmark::State& state, const size_class& c) {
+    auto a = make_array<T>(c);
+    run(state, a.size() * (sizeof(T) + sizeof(T2)), bytes_of(a), [&]() {
+      auto r = a.template astype<T2>();
+      benchmark::DoNotOptimize(r.data());
+    });
+  }
+
+  template <typename T>
+  void bm_add(benchmark::State& state, const size_class& c) {
+    auto a = make_array<T>(c);
+    auto b = make_array<T>(c);
+    auto r = make_array<T>(c);
+    run(state, 3 * bytes_of(a), bytes_of(a), [&]() {
+      r << a + b;
+      benchmark::ClobberMemory();
+    });
+  }
+
+  template <typename T>
+  void bm_scale(benchmark::State& state, const size_class& c) {
+    auto a = make_array<T>(c);
+    // exact factor of unit magnitude, so that repeated scaling does not drift into denormals
+    T    s;
+    if constexpr (ndarray::is_complex_v<T>) {
+      s = T(0.0, 1.0);
+    } else {
+      s = T(-1.0);
+    }
+    run(state, 2 * bytes_of(a), bytes_of(a), [&]() {
+      a *= s;
+      benchmark::ClobberMemory();
+    });
+  }
+
+  template <typename T>
+  void bm_transpose(benchmark::State& state, const size_class& c, const std::string& pattern) {
+    auto a = make_array<T>(c);
+    run(state, 2 * bytes_of(a), bytes_of(a), [&]() {
+      auto r = ndarray::transpose(a, pattern);
+      benchmark::DoNotOptimize(r.data());
+    });
+  }
+
+  template <typename T>
+  void bm_allocate(benchmark::State& state, const size_class& c) {
+    const auto shape = shape_of<T>(c);
+    run(state, bytes_of<T>(shape), bytes_of<T>(shape), [&]() {
+      ndarray::ndarray<T, 3> r(shape);
+      benchmark::DoNotOptimize(r.data());
+    });
+  }
+
+  template <typename T>
+  void bm_allocate_uninitialized(benchmark::State& state, const size_class& c) {
+    const auto shape = shape_of<T>(c);
+    for (auto _ : state) {
+      ndarray::ndarray<T, 3> r(shape, ndarray::uninitialized);
+      benchmark::DoNotOptimize(r.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  template <typename F>
+  void add(const std::string& op, const std::string& type, const size_class& c, F&& f) {
+    // page faults of large allocations are paid by the kernel, CPU time of the calling thread misses them
+    auto* b = benchmark::RegisterBenchmark((op + "/" + type + "/" + c.name).c_str(), std::forward<F>(f))->UseRealTime();
+    if (c.name == "large") b->Unit(benchmark::kMillisecond);
+  }
+
+  template <typename T>
+  void add_type(const std::string& type) {
+    for (const auto& c : size_classes()) {
+      add("memcpy", type, c, [c](benchmark::State& s) { bm_memcpy<T>(s, c); });
+      add("copy", type, c, [c](benchmark::State& s) { bm_copy<T>(s, c); });
+      add("assign", type, c, [c](benchmark::State& s) { bm_assign<T>(s, c); });
+      add("add", type, c, [c](benchmark::State& s) { bm_add<T>(s, c); });
+      add("scale", type, c, [c](benchmark::State& s) { bm_scale<T>(s, c); });
+      // transposition of every per-k block and full reversal of axes
+      add("transpose_ikj", type, c, [c](benchmark::State& s) { bm_transpose<T>(s, c, "ijk->ikj"); });
+      add("transpose_kji", type, c, [c](benchmark::State& s) { bm_transpose<T>(s, c, "ijk->kji"); });
+      add("allocate", type, c, [c](benchmark::State& s) { bm_allocate<T>(s, c); });
+      add("allocate_uninitialized", type, c, [c](benchmark::State& s) { bm_allocate_uninitialized<T>(s, c); });
+    }
+  }
+}  // namespace
+
+/**
+ * Benchmarks of core operations. Throughput is reported as bytes per second and as a fraction of memcpy bandwidth
+ * (`vs_memcpy`). Use `--benchmark_format=json` or `--benchmark_out=results.json` for machine-readable results.
+ */
+int main(int argc, char** argv) {
+  add_type<double>("double");
+  add_type<complex_t>("complex");
+  for (const auto& c : size_classes()) {
+    add("astype", "double_to_complex", c, [c](benchmark::State& s) { bm_astype<double, complex_t>(s, c); });
+    add("astype", "complex_to_double", c, [c](benchmark::State& s) { bm_astype<complex_t, double>(s, c); });
+    // baselines are measured before any benchmark array is allocated
+    memcpy_bandwidth(bytes_of<double>(shape_of<double>(c)));
+    memcpy_bandwidth(bytes_of<complex_t>(shape_of<complex_t>(c)));
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  const char* simd_levels[] = {"none", "avx2", "avx512"};
+  benchmark::AddCustomContext("ndarray_simd_level", simd_levels[int(ndarray::current_simd_level())]);
+  benchmark::AddCustomContext("ndarray_parallel_threshold", std::to_string(ndarray::parallel_threshold()));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_CHUNKED_H
+#define NDARRAY_CHUNKED_H
+
+#include <algorithm>
+#include <array>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "mapped_storage.h"
+#include "ndarray.h"
+
+namespace green::ndarray {
+
+  namespace detail {
+    /**
+     * Advise the kernel to start reading pages of a memory-mapped array in the background. No-op for other storages.
+     */
+    template <typename T, size_t Dim>
+    void prefetch_mapped(const ndarray<T, Dim>& array) {
+      if (array.size() == 0 || array.storage().release() != mmap_deallocation) return;
+      size_t last = 0;
+      for (size_t k = 0; k < Dim; ++k) last += (array.shape()[k] - 1) * array.strides()[k];
+      const size_t page  = size_t(sysconf(_SC_PAGESIZE));
+      const size_t begin = reinterpret_cast<size_t>(array.data()) / page * page;
+      const size_t end   = reinterpret_cast<size_t>(array.data() + last + 1);
+      madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+    }
+
+    /**
+     * Input iterator over chunks of a chunked range. Range should provide `size()` and `chunk(i)`, the latter also starts
+     * background prefetch of the following chunk.
+     */
+    template <typename Range, typename Chunk>
+    class chunk_iterator {
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type        = Chunk;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const Chunk*;
+      using reference         = const Chunk&;
+
+      chunk_iterator(Range* range, size_t index) : range_(range), index_(index) {
+        if (index_ < range_->size()) chunk_ = range_->chunk(index_);
+      }
+
+      reference       operator*() const { return chunk_; }
+      pointer         operator->() const { return &chunk_; }
+
+      chunk_iterator& operator++() {
+        // release current chunk first, so that its buffer can be reused
+        chunk_ = Chunk();
+        if (++index_ < range_->size()) chunk_ = range_->chunk(index_);
+        return *this;
+      }
+
+      bool operator==(const chunk_iterator& rhs) const { return index_ == rhs.index_; }
+      bool operator!=(const chunk_iterator& rhs) const { return index_ != rhs.index_; }
+
+    private:
+      Range* range_;
+      size_t index_;
+      Chunk  chunk_;
+    };
+  }  // namespace detail
+
+  /**
+   * Blocks of an array along the leading axis. Each block is a view `array(range(i * block, (i + 1) * block))`, the last
+   * block may be shorter. For memory-mapped arrays (see `map_file`) the pages of the next block are prefetched in the
+   * background while the current block is being processed, so that only a few blocks have to be resident at a time:
+   *
+   *     auto a = map_file<const double>("g.bin", std::array<size_t, 4>{nw, nk, n, n});
+   *     for (const auto& block : chunks(a, 8)) process(block);
+   *
+   * @tparam T - type of the elements
+   * @tparam Dim - dimension of the array
+   */
+  template <typename T, size_t Dim>
+  class chunked_view {
+  public:
+    using iterator = detail::chunk_iterator<chunked_view, ndarray<T, Dim>>;
+
+    /**
+     * @param array - array to be split
+     * @param block - number of leading indices in each block
+     */
+    chunked_view(const ndarray<T, Dim>& array, size_t block) : array_(array), block_(block) {
+      if (block_ == 0) throw std::logic_error("Chunk size should be positive.");
+    }
+
+    /**
+     * @return number of blocks
+     */
+    size_t          size() const { return (array_.shape()[0] + block_ - 1) / block_; }
+
+    /**
+     * @return i-th block, pages of the (i+1)-th block are prefetched
+     */
+    ndarray<T, Dim> chunk(size_t i) const {
+      if (i + 1 < size()) detail::prefetch_mapped(block(i + 1));
+      return block(i);
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, size()); }
+
+  private:
+    ndarray<T, Dim> array_;
+    size_t          block_;
+
+    ndarray<T, Dim> block(size_t i) const {
+      return array_(range(i * block_, std::min((i + 1) * block_, array_.shape()[0])));
+    }
+  };
+
+  /**
+   * Split an array into blocks along the leading axis
+   *
+   * @param array - array to be split
+   * @param block - number of leading indices in each block
+   */
+  template <typename T, size_t Dim>
+  chunked_view<T, Dim> chunks(const ndarray<T, Dim>& array, size_t block) {
+    return chunked_view<T, Dim>(array, block);
+  }
+
+  /**
+   * Blocks of a C-ordered array stored in a file, read along the leading axis. While the current block is being
+   * processed, the next one is read by a background thread into a second buffer. Buffers are reused as long as no
+   * reference to a previous block is kept, so memory use is bounded by two blocks:
+   *
+   *     file_chunks<double, 4> g("g.bin", std::array<size_t, 4>{nw, nk, n, n}, 8);
+   *     for (const auto& block : g) process(block);
+   *
+   * Range can be traversed only once at a time, every call of `begin()` restarts reading from the first block.
+   *
+   * @tparam T - type of the elements
+   * @tparam Dim - dimension of the array
+   */
+  template <typename T, size_t Dim>
+  class file_chunks {
+    static_assert(std::is_trivially_copyable_v<T>, "Elements read from a file should be trivially copyable");
+
+  public:
+    using iterator = detail::chunk_iterator<file_chunks, ndarray<T, Dim>>;
+
+    /**
+     * @param path - path to the file
+     * @param shape - shape of the whole array
+     * @param block - number of leading indices in each block
+     * @param offset - position of the first element in the file in bytes
+     */
+    file_chunks(const std::string& path, const std::array<size_t, Dim>& shape, size_t block, size_t offset = 0) :
+        path_(path), file_{open(path.c_str(), O_RDONLY)}, shape_(shape), block_(block), offset_(offset) {
+      if (block_ == 0) throw std::logic_error("Chunk size should be positive.");
+      if (file_.fd < 0) detail::throw_mapping_error("Can not open file", path);
+      struct stat st;
+      if (fstat(file_.fd, &st) != 0) detail::throw_mapping_error("Can not stat file", path);
+      row_size_ = 1;
+      for (size_t k = 1; k < Dim; ++k) row_size_ *= shape_[k];
+      if (size_t(st.st_size) < offset_ + shape_[0] * row_size_ * sizeof(T)) {
+        throw std::runtime_error("File '" + path + "' is smaller than the array.");
+      }
+    }
+
+    ~file_chunks() {
+      if (pending_.valid()) pending_.wait();
+    }
+
+    file_chunks(const file_chunks&)            = delete;
+    file_chunks& operator=(const file_chunks&) = delete;
+
+    /**
+     * @return number of blocks
+     */
+    size_t       size() const { return (shape_[0] + block_ - 1) / block_; }
+
+    /**
+     * Read i-th block and start reading of the next one in background. Blocks are read faster when they are requested
+     * in order.
+     *
+     * @return array with elements of the i-th block
+     */
+    ndarray<T, Dim> chunk(size_t i) {
+      // buffer of the previously returned block, if the caller does not reference it anymore
+      ndarray<T, Dim> spare;
+      if (last_.storage().data().count == 1) spare = std::move(last_);
+      last_ = ndarray<T, Dim>();
+      if (pending_.valid() && pending_index_ == i) {
+        last_ = pending_.get();
+      } else {
+        if (pending_.valid()) pending_.wait();
+        last_ = read(i, std::move(spare));
+      }
+      if (i + 1 < size()) {
+        pending_index_ = i + 1;
+        pending_       = std::async(std::launch::async, [this, i, buffer = std::move(spare)]() { return read(i + 1, buffer); });
+      }
+      return last_;
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, size()); }
+
+  private:
+    std::string                  path_;
+    detail::file_descriptor      file_;
+    std::array<size_t, Dim>      shape_;
+    size_t                       block_;
+    size_t                       offset_;
+    size_t                       row_size_;
+    std::future<ndarray<T, Dim>> pending_;
+    size_t                       pending_index_ = 0;
+    // last returned block, its buffer is reused once the caller releases it
+    ndarray<T, Dim>              last_;
+
+    ndarray<T, Dim> read(size_t i, ndarray<T, Dim> buffer) const {
+      std::array<size_t, Dim> shape = shape_;
+      shape[0]                      = std::min((i + 1) * block_, shape_[0]) - i * block_;
+      if (buffer.shape() != shape || buffer.storage().data().ptr == nullptr) buffer = ndarray<T, Dim>(shape, uninitialized);
+      detail::read_file_range(file_, path_, buffer.data(), buffer.size() * sizeof(T),
+                              offset_ + i * block_ * row_size_ * sizeof(T));
+      return buffer;
+    }
+  };
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_CHUNKED_H
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_DEVICE_STORAGE_H
+#define NDARRAY_DEVICE_STORAGE_H
+
+#ifdef GREEN_NDARRAY_CUDA
+#include <cuda_runtime.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "memory_resource.h"
+#include "ndarray.h"
+#include "storage.h"
+
+namespace green::ndarray {
+
+  /**
+   * Handle of an asynchronous execution queue of a device (e.g. `cudaStream_t`), nullptr selects the default queue
+   */
+  using device_stream = void*;
+
+  /**
+   * Provider of memory resources for pinned host and device memory together with asynchronous transfers between memory
+   * spaces. Backend should outlive every storage allocated from its resources.
+   */
+  class device_backend {
+  public:
+    virtual ~device_backend() = default;
+    /**
+     * @return resource that allocates memory in `space`
+     */
+    virtual memory_resource& resource(memory_space space) = 0;
+    /**
+     * Enqueue copy of `size` bytes into `stream`. Copy is only guaranteed to be completed after `synchronize(stream)`.
+     *
+     * @param dst - destination pointer in `dst_space`
+     * @param src - source pointer in `src_space`
+     * @param size - number of bytes to copy
+     */
+    virtual void             copy_async(void* dst, memory_space dst_space, const void* src, memory_space src_space, size_t size,
+                                        device_stream stream) = 0;
+    /**
+     * Wait for all operations enqueued into `stream`
+     */
+    virtual void             synchronize(device_stream stream) = 0;
+  };
+
+#ifdef GREEN_NDARRAY_CUDA
+  namespace detail {
+    inline void check_cuda(cudaError_t status, const char* what) {
+      if (status == cudaErrorMemoryAllocation) throw std::bad_alloc();
+      if (status != cudaSuccess) throw std::runtime_error(std::string(what) + ": " + cudaGetErrorString(status));
+    }
+
+    /**
+     * Device memory of the current CUDA device
+     */
+    class cuda_device_resource : public memory_resource {
+    public:
+      void* allocate(size_t size, const allocation_policy&) override {
+        void* ptr = nullptr;
+        check_cuda(cudaMalloc(&ptr, std::max(size, size_t(1))), "Can not allocate device memory");
+        return ptr;
+      }
+      void         deallocate(void* ptr, size_t, const allocation_policy&) override { cudaFree(ptr); }
+      memory_space space() const override { return memory_space::device; }
+    };
+
+    /**
+     * Page-locked host memory
+     */
+    class cuda_pinned_resource : public memory_resource {
+    public:
+      void* allocate(size_t size, const allocation_policy&) override {
+        void* ptr = nullptr;
+        check_cuda(cudaMallocHost(&ptr, std::max(size, size_t(1))), "Can not allocate pinned host memory");
+        return ptr;
+      }
+      void         deallocate(void* ptr, size_t, const allocation_policy&) override { cudaFreeHost(ptr); }
+      memory_space space() const override { return memory_space::pinned_host; }
+    };
+  }  // namespace detail
+
+  /**
+   * CUDA runtime backend. Transfers rely on unified virtual addressing, so that the runtime infers their direction.
+   */
+  class cuda_backend : public device_backend {
+  public:
+    memory_resource& resource(memory_space space) override {
+      switch (space) {
+        case memory_space::device:
+          return device_;
+        case memory_space::pinned_host:
+          return pinned_;
+        default:
+          return *system_memory_resource();
+      }
+    }
+
+    void copy_async(void* dst, memory_space, const void* src, memory_space, size_t size, device_stream stream) override {
+      detail::check_cuda(cudaMemcpyAsync(dst, src, size, cudaMemcpyDefault, static_cast<cudaStream_t>(stream)),
+                         "Can not copy memory");
+    }
+
+    void synchronize(device_stream stream) override {
+      detail::check_cuda(cudaStreamSynchronize(static_cast<cudaStream_t>(stream)), "Can not synchronize stream");
+    }
+
+  private:
+    detail::cuda_device_resource device_;
+    detail::cuda_pinned_resource pinned_;
+  };
+#endif
+
+  namespace detail {
+    inline device_backend* default_device_backend() {
+#ifdef GREEN_NDARRAY_CUDA
+      // never destroyed, so that arrays released during static destruction can still free their memory
+      static device_backend* backend = new cuda_backend();
+      return backend;
+#else
+      return nullptr;
+#endif
+    }
+
+    struct device_config {
+      static inline device_backend* backend = nullptr;
+    };
+  }  // namespace detail
+
+  /**
+   * Set backend used for non-host allocations and transfers. Pass nullptr to reset to the default backend, which is
+   * the CUDA runtime if the library is built with `-DUse_CUDA=ON`.
+   *
+   * @param backend - backend to be used, should outlive every array allocated from it
+   */
+  inline void set_device_backend(device_backend* backend) { detail::device_config::backend = backend; }
+
+  /**
+   * @return backend used for non-host allocations and transfers
+   */
+  inline device_backend& current_device_backend() {
+    device_backend* backend = detail::device_config::backend ? detail::device_config::backend : detail::default_device_backend();
+    if (backend == nullptr) {
+      throw std::runtime_error("No device backend is available. Build with -DUse_CUDA=ON or call set_device_backend().");
+    }
+    return *backend;
+  }
+
+  /**
+   * Create C-ordered array in a given memory space. Elements are not initialized. Shape, strides and offset of the array
+   * and of its slices are valid for any memory space, but elements of device arrays can not be accessed on the host;
+   * use `data()` to pass them to device kernels and `copy_to` to move them between memory spaces.
+   *
+   * @tparam T - type of the elements
+   * @param shape - shape of the array
+   * @param space - memory space of the elements
+   * @return array allocated from the current device backend
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> device_ndarray(const std::array<size_t, Dim>& shape, memory_space space = memory_space::device) {
+    static_assert(std::is_trivially_copyable_v<T>, "Elements of device arrays should be trivially copyable");
+    std::array<size_t, Dim> strides;
+    size_t                  size = 1;
+    for (size_t k = Dim; k-- > 0;) {
+      strides[k] = size;
+      size *= shape[k];
+    }
+    memory_resource& resource = current_device_backend().resource(space);
+    return ndarray<T, Dim>(shape, strides, 0, storage_t(sizeof(T) * size, default_allocation_policy(), resource));
+  }
+
+  /**
+   * Enqueue copy of the elements of `src` into `dst`. Arrays may live in different memory spaces and should be
+   * C-contiguous. Both arrays should stay alive until the stream is synchronized. Copies between pageable host arrays
+   * are performed immediately.
+   *
+   * @param src - source array
+   * @param dst - destination array of the same shape
+   * @param stream - device stream
+   */
+  template <typename T, size_t Dim>
+  void copy_to(const ndarray<T, Dim>& src, ndarray<std::remove_const_t<T>, Dim>& dst, device_stream stream = nullptr) {
+    if (src.shape() != dst.shape()) {
+      throw std::runtime_error("Shapes of source and destination arrays should be the same");
+    }
+    if (!src.is_contiguous() || !dst.is_contiguous()) {
+      throw std::logic_error("Operation requires C-contiguous array. Use make_contiguous() to obtain one.");
+    }
+    if (src.size() == 0) return;
+    memory_space src_space = src.storage().space();
+    memory_space dst_space = dst.storage().space();
+    if (src_space == memory_space::host && dst_space == memory_space::host) {
+      std::memcpy(dst.data(), src.data(), src.size() * sizeof(T));
+      return;
+    }
+    current_device_backend().copy_async(dst.data(), dst_space, src.data(), src_space, src.size() * sizeof(T), stream);
+  }
+
+  /**
+   * Enqueue copy of an array into a new array in memory space `space`. Source should stay alive until the stream is
+   * synchronized.
+   *
+   * @param array - C-contiguous source array
+   * @param space - memory space of the new array
+   * @param stream - device stream
+   * @return new C-ordered array in memory space `space`
+   */
+  template <typename T, size_t Dim>
+  ndarray<std::remove_const_t<T>, Dim> copy_to(const ndarray<T, Dim>& array, memory_space space,
+                                               device_stream stream = nullptr) {
+    if (!array.is_contiguous()) {
+      throw std::logic_error("Operation requires C-contiguous array. Use make_contiguous() to obtain one.");
+    }
+    auto result = device_ndarray<std::remove_const_t<T>>(array.shape(), space);
+    copy_to(array, result, stream);
+    return result;
+  }
+
+  /**
+   * Enqueue copy of an array into a new pinned host array, so that the transfer runs asynchronously
+   */
+  template <typename T, size_t Dim>
+  ndarray<std::remove_const_t<T>, Dim> copy_to_host(const ndarray<T, Dim>& array, device_stream stream = nullptr) {
+    return copy_to(array, memory_space::pinned_host, stream);
+  }
+
+  /**
+   * Wait for all transfers enqueued into `stream`
+   */
+  inline void synchronize(device_stream stream = nullptr) { current_device_backend().synchronize(stream); }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_DEVICE_STORAGE_H
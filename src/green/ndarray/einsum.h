@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_EINSUM_H
+#define NDARRAY_EINSUM_H
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <complex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+#include "instrumentation.h"
+#include "ndarray_math.h"
+#include "parallel.h"
+#include "string_utils.h"
+
+#ifdef GREEN_NDARRAY_BLAS
+extern "C" {
+void sgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k, const float* alpha,
+            const float* a, const int* lda, const float* b, const int* ldb, const float* beta, float* c, const int* ldc);
+void dgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k, const double* alpha,
+            const double* a, const int* lda, const double* b, const int* ldb, const double* beta, double* c, const int* ldc);
+void cgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k,
+            const std::complex<float>* alpha, const std::complex<float>* a, const int* lda, const std::complex<float>* b,
+            const int* ldb, const std::complex<float>* beta, std::complex<float>* c, const int* ldc);
+void zgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k,
+            const std::complex<double>* alpha, const std::complex<double>* a, const int* lda, const std::complex<double>* b,
+            const int* ldb, const std::complex<double>* beta, std::complex<double>* c, const int* ldc);
+}
+#endif
+
+namespace green::ndarray {
+
+  namespace detail {
+    /**
+     * Indices of a contraction of two tensors split into groups. Result of the contraction is computed as a batch of
+     * matrix products C[batch][free_a][free_b] = A[batch][free_a][contracted] * B[batch][contracted][free_b].
+     */
+    struct einsum_plan {
+      std::string a;
+      std::string b;
+      std::string c;
+      // indices of all three tensors in the order of the result
+      std::string batch;
+      // indices of the first tensor and of the result in the order of the result
+      std::string free_a;
+      // indices of the second tensor and of the result in the order of the result
+      std::string free_b;
+      // indices of both tensors that are summed over in the order of the first tensor
+      std::string contracted;
+    };
+
+    /**
+     * Parse contraction pattern of the form "ijk,kl->ijl"
+     *
+     * @param pattern - contraction pattern
+     * @param dim_a - dimension of the first tensor
+     * @param dim_b - dimension of the second tensor
+     * @param dim_c - dimension of the result
+     * @return indices of the contraction split into groups
+     */
+    inline einsum_plan parse_einsum_pattern(const std::string& pattern, size_t dim_a, size_t dim_b, size_t dim_c) {
+      size_t arrow = pattern.find("->");
+      size_t comma = pattern.find(',');
+      if (arrow == std::string::npos || comma == std::string::npos || comma > arrow) {
+        throw std::runtime_error("Incorrect einsum pattern.");
+      }
+      einsum_plan plan;
+      plan.a = trim(pattern.substr(0, comma));
+      plan.b = trim(pattern.substr(comma + 1, arrow - comma - 1));
+      plan.c = trim(pattern.substr(arrow + 2));
+      if (!all_latin(plan.a) || !all_latin(plan.b) || !all_latin(plan.c)) {
+        throw std::runtime_error("Einsum indices should be latin letters.");
+      }
+      if (plan.a.length() != dim_a || plan.b.length() != dim_b || plan.c.length() != dim_c) {
+        throw std::runtime_error("Number of einsum indices and arrays dimensions are different.");
+      }
+      for (const std::string* term : {&plan.a, &plan.b, &plan.c}) {
+        for (size_t i = 0; i < term->length(); ++i) {
+          if (term->find((*term)[i], i + 1) != std::string::npos) {
+            throw std::runtime_error("Einsum indices should not be repeated within a single tensor.");
+          }
+        }
+      }
+      for (char x : plan.c) {
+        bool in_a = plan.a.find(x) != std::string::npos;
+        bool in_b = plan.b.find(x) != std::string::npos;
+        if (in_a && in_b) {
+          plan.batch += x;
+        } else if (in_a) {
+          plan.free_a += x;
+        } else if (in_b) {
+          plan.free_b += x;
+        } else {
+          throw std::runtime_error("Einsum result index is not found in any of the tensors.");
+        }
+      }
+      for (char x : plan.a) {
+        if (plan.c.find(x) != std::string::npos) continue;
+        if (plan.b.find(x) == std::string::npos) {
+          throw std::runtime_error("Einsum index that is not in the result should be in both tensors.");
+        }
+        plan.contracted += x;
+      }
+      for (char x : plan.b) {
+        if (plan.c.find(x) == std::string::npos && plan.a.find(x) == std::string::npos) {
+          throw std::runtime_error("Einsum index that is not in the result should be in both tensors.");
+        }
+      }
+      return plan;
+    }
+
+    // maximal number of parsed patterns that are kept per thread
+    inline constexpr size_t einsum_plan_cache_size = 256;
+
+    /**
+     * Parsed contraction plan for a pattern. Plans are memoized per thread, so that repeated contractions with the same
+     * pattern are not parsed again.
+     */
+    inline const einsum_plan& cached_einsum_plan(const std::string& pattern, size_t dim_a, size_t dim_b, size_t dim_c) {
+      thread_local std::unordered_map<std::string, einsum_plan> cache;
+      auto                                                       it = cache.find(pattern);
+      if (it != cache.end()) {
+        const einsum_plan& plan = it->second;
+        if (plan.a.length() != dim_a || plan.b.length() != dim_b || plan.c.length() != dim_c) {
+          throw std::runtime_error("Number of einsum indices and arrays dimensions are different.");
+        }
+        return plan;
+      }
+      einsum_plan plan = parse_einsum_pattern(pattern, dim_a, dim_b, dim_c);
+      if (cache.size() >= einsum_plan_cache_size) cache.clear();
+      return cache.emplace(pattern, std::move(plan)).first->second;
+    }
+
+    /**
+     * Target position of each of the indices of `from` in `to`
+     */
+    template <size_t Dim>
+    std::array<size_t, Dim> index_pattern(const std::string& from, const std::string& to) {
+      std::array<size_t, Dim> pattern;
+      for (size_t i = 0; i < Dim; ++i) pattern[i] = to.find(from[i]);
+      return pattern;
+    }
+
+    /**
+     * Matrix operand of a batched product: `batches` row-major matrices of `rows` x `cols` elements (or `cols` x `rows`
+     * when transposed) stored one after another
+     */
+    template <typename T>
+    struct gemm_operand {
+      ndarray<const T, 1> buffer;
+      const T*            data;
+      bool                transposed;
+    };
+
+    /**
+     * Bring tensor into the matrix form with indices `batch + rows + cols`. Data is only copied when tensor can not be
+     * viewed as a batch of contiguous matrices in either normal or transposed order.
+     */
+    template <typename R, typename T, size_t Dim>
+    gemm_operand<R> as_gemm_operand(const ndarray<T, Dim>& array, const std::string& indices, const std::string& batch,
+                                   const std::string& rows, const std::string& cols) {
+      if constexpr (std::is_same_v<std::remove_const_t<T>, R>) {
+        for (bool transposed : {false, true}) {
+          const std::string order = transposed ? batch + cols + rows : batch + rows + cols;
+          auto view = transpose_view_impl(array, index_pattern<Dim>(indices, order));
+          if (view.is_contiguous()) {
+            ndarray<const R, 1> buffer = view.reshape(std::array<size_t, 1>{view.size()});
+            return {buffer, buffer.data(), transposed};
+          }
+        }
+      }
+      auto          view = transpose_view_impl(array, index_pattern<Dim>(indices, batch + rows + cols));
+      ndarray<R, Dim> copy(view.shape(), uninitialized);
+      copy << view;
+      ndarray<const R, 1> buffer = copy.reshape(std::array<size_t, 1>{copy.size()});
+      return {buffer, buffer.data(), false};
+    }
+
+    /**
+     * Row-major matrix product C = op(A) * op(B) for a batch of matrices, op(A) is M x K and op(B) is K x N
+     */
+    template <typename T>
+    void gemm_fallback(size_t batches, bool ta, bool tb, size_t M, size_t N, size_t K, const T* A, const T* B, T* C) {
+      parallel_for(batches * M, N * K, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+          const size_t b = r / M;
+          const size_t m = r % M;
+          const T*     a = A + b * M * K;
+          const T*     x = B + b * K * N;
+          T*           c = C + r * N;
+          const size_t sa = ta ? M : 1;
+          const T*     a_row = ta ? a + m : a + m * K;
+          if (tb) {
+            for (size_t n = 0; n < N; ++n) {
+              T        sum   = T(0);
+              const T* b_row = x + n * K;
+              for (size_t k = 0; k < K; ++k) sum += a_row[k * sa] * b_row[k];
+              c[n] = sum;
+            }
+          } else {
+            std::fill(c, c + N, T(0));
+            for (size_t k = 0; k < K; ++k) {
+              const T  aik   = a_row[k * sa];
+              const T* b_row = x + k * N;
+              for (size_t n = 0; n < N; ++n) c[n] += aik * b_row[n];
+            }
+          }
+        }
+      });
+    }
+
+#ifdef GREEN_NDARRAY_BLAS
+    template <typename T>
+    constexpr bool is_blas_type_v = std::is_same_v<T, float> || std::is_same_v<T, double> ||
+                                    std::is_same_v<T, std::complex<float>> || std::is_same_v<T, std::complex<double>>;
+
+    template <typename T>
+    void blas_gemm(const char* ta, const char* tb, const int* m, const int* n, const int* k, const T* a, const int* lda,
+                   const T* b, const int* ldb, T* c, const int* ldc) {
+      const T one  = T(1);
+      const T zero = T(0);
+      if constexpr (std::is_same_v<T, float>) {
+        sgemm_(ta, tb, m, n, k, &one, a, lda, b, ldb, &zero, c, ldc);
+      } else if constexpr (std::is_same_v<T, double>) {
+        dgemm_(ta, tb, m, n, k, &one, a, lda, b, ldb, &zero, c, ldc);
+      } else if constexpr (std::is_same_v<T, std::complex<float>>) {
+        cgemm_(ta, tb, m, n, k, &one, a, lda, b, ldb, &zero, c, ldc);
+      } else {
+        zgemm_(ta, tb, m, n, k, &one, a, lda, b, ldb, &zero, c, ldc);
+      }
+    }
+#endif
+
+    /**
+     * Batched row-major matrix product. Dispatched to BLAS `?gemm` when it is enabled with `GREEN_NDARRAY_BLAS` and
+     * value type and sizes are supported.
+     */
+    template <typename T>
+    void gemm(size_t batches, bool ta, bool tb, size_t M, size_t N, size_t K, const T* A, const T* B, T* C) {
+      if (batches * M * N == 0) return;
+      kernel_scope scope(kernel_kind::contraction);
+#ifdef GREEN_NDARRAY_BLAS
+      if constexpr (is_blas_type_v<T>) {
+        if (std::max({M, N, K}) <= size_t(INT_MAX)) {
+          // row-major C = op(A) * op(B) is column-major C^T = op(B)^T * op(A)^T
+          const int  m = int(N), n = int(M), k = int(K);
+          const int  lda = int(std::max(tb ? K : N, size_t(1)));
+          const int  ldb = int(std::max(ta ? M : K, size_t(1)));
+          const int  ldc = int(std::max(N, size_t(1)));
+          const char opa = tb ? 'T' : 'N';
+          const char opb = ta ? 'T' : 'N';
+          for (size_t b = 0; b < batches; ++b) {
+            blas_gemm(&opa, &opb, &m, &n, &k, B + b * K * N, &lda, A + b * M * K, &ldb, C + b * M * N, &ldc);
+          }
+          return;
+        }
+      }
+#endif
+      gemm_fallback(batches, ta, tb, M, N, K, A, B, C);
+    }
+
+    template <size_t Dim>
+    size_t extent_product(const std::array<size_t, Dim>& shape, const std::string& indices, const std::string& group) {
+      size_t product = 1;
+      for (char x : group) product *= shape[indices.find(x)];
+      return product;
+    }
+
+    /**
+     * Shape of the result of the contraction. Throws `std::runtime_error` if extents of shared indices are different.
+     */
+    template <size_t DimC, typename T1, size_t DimA, typename T2, size_t DimB>
+    std::array<size_t, DimC> einsum_shape(const einsum_plan& plan, const ndarray<T1, DimA>& a, const ndarray<T2, DimB>& b) {
+      for (size_t i = 0; i < DimA; ++i) {
+        size_t ib = plan.b.find(plan.a[i]);
+        if (ib != std::string::npos && b.shape()[ib] != a.shape()[i]) {
+          throw std::runtime_error("Einsum index has different extents in the tensors.");
+        }
+      }
+      std::array<size_t, DimC> shape;
+      for (size_t i = 0; i < DimC; ++i) {
+        size_t ia = plan.a.find(plan.c[i]);
+        shape[i]  = ia != std::string::npos ? a.shape()[ia] : b.shape()[plan.b.find(plan.c[i])];
+      }
+      return shape;
+    }
+
+    /**
+     * Contract `a` and `b` into `c` according to the plan. Result is written directly into `c` if its indices are ordered
+     * as `batch + free_a + free_b` (or `batch + free_b + free_a`, where operands are swapped), otherwise into a temporary
+     * that is permuted into `c`.
+     */
+    template <typename R, typename T1, size_t DimA, typename T2, size_t DimB, size_t DimC>
+    void einsum_impl(const einsum_plan& plan, const ndarray<T1, DimA>& a, const ndarray<T2, DimB>& b, ndarray<R, DimC>& c) {
+      const std::array<size_t, DimC> shape = einsum_shape<DimC>(plan, a, b);
+      if (shape != c.shape()) {
+        throw std::runtime_error("Shape of the result does not match einsum pattern.");
+      }
+      const size_t batches = extent_product(a.shape(), plan.a, plan.batch);
+      const size_t M       = extent_product(a.shape(), plan.a, plan.free_a);
+      const size_t N       = extent_product(b.shape(), plan.b, plan.free_b);
+      const size_t K       = extent_product(a.shape(), plan.a, plan.contracted);
+      if (c.size() == 0) return;
+      if (plan.c == plan.batch + plan.free_b + plan.free_a && plan.c != plan.batch + plan.free_a + plan.free_b) {
+        einsum_plan swapped = plan;
+        std::swap(swapped.free_a, swapped.free_b);
+        std::swap(swapped.a, swapped.b);
+        return einsum_impl(swapped, b, a, c);
+      }
+      auto x = as_gemm_operand<R>(a, plan.a, plan.batch, plan.free_a, plan.contracted);
+      auto y = as_gemm_operand<R>(b, plan.b, plan.batch, plan.contracted, plan.free_b);
+      if (plan.c == plan.batch + plan.free_a + plan.free_b && c.is_contiguous()) {
+        gemm(batches, x.transposed, y.transposed, M, N, K, x.data, y.data, c.data());
+        return;
+      }
+      const std::string order = plan.batch + plan.free_a + plan.free_b;
+      std::array<size_t, DimC> tmp_shape;
+      for (size_t i = 0; i < DimC; ++i) tmp_shape[i] = shape[plan.c.find(order[i])];
+      ndarray<R, DimC> tmp(tmp_shape, uninitialized);
+      gemm(batches, x.transposed, y.transposed, M, N, K, x.data, y.data, tmp.data());
+      c << transpose_view_impl(tmp, index_pattern<DimC>(order, plan.c));
+    }
+  }  // namespace detail
+
+  /**
+   * Contract two tensors according to the pattern in Einstein notation, e.g. "ijk,kl->ijl". Indices that are present in
+   * both tensors but not in the result are summed over, indices of both tensors that are present in the result are
+   * batch indices. The contraction is evaluated as a batch of matrix products, operands are only copied if they can not
+   * be viewed as contiguous (possibly transposed) matrices.
+   *
+   * @tparam DimC - dimension of the result
+   * @param pattern - contraction pattern
+   * @param a - first tensor
+   * @param b - second tensor
+   * @return new array with the result of the contraction
+   */
+  template <size_t DimC, typename T1, size_t DimA, typename T2, size_t DimB>
+  auto einsum(const std::string& pattern, const ndarray<T1, DimA>& a, const ndarray<T2, DimB>& b) {
+    using R                  = std::common_type_t<std::remove_const_t<T1>, std::remove_const_t<T2>>;
+    const detail::einsum_plan& plan = detail::cached_einsum_plan(pattern, DimA, DimB, DimC);
+    ndarray<R, DimC>           c(detail::einsum_shape<DimC>(plan, a, b), uninitialized);
+    detail::einsum_impl(plan, a, b, c);
+    return c;
+  }
+
+  /**
+   * Contract two tensors according to the pattern in Einstein notation and write the result into an existing array.
+   * No temporary is allocated for the result when its indices are ordered as batch, free and free indices.
+   *
+   * @param pattern - contraction pattern
+   * @param a - first tensor
+   * @param b - second tensor
+   * @param c - result of the contraction, shape should match the pattern
+   */
+  template <typename T1, size_t DimA, typename T2, size_t DimB, typename T3, size_t DimC>
+  void einsum(const std::string& pattern, const ndarray<T1, DimA>& a, const ndarray<T2, DimB>& b, ndarray<T3, DimC>& c) {
+    detail::einsum_impl(detail::cached_einsum_plan(pattern, DimA, DimB, DimC), a, b, c);
+  }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_EINSUM_H
@@ -0,0 +1,607 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_EXPRESSION_H
+#define NDARRAY_EXPRESSION_H
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
+#include "instrumentation.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+
+namespace green::ndarray {
+
+  template <typename T, size_t Dim>
+  struct ndarray;
+
+  namespace detail {
+    /**
+     * Tag type of arrays that alias the memory of another array (slices and views). In copy-on-write mode views do not
+     * detach, see `ndarray::set_copy_on_write`.
+     */
+    struct view_t {
+      explicit view_t() = default;
+    };
+    inline constexpr view_t view_tag{};
+  }  // namespace detail
+
+  /**
+   * Base class for lazy element-wise expressions built by arithmetic operators from `ndarray_math.h`.
+   * Expression is evaluated in a single pass over memory when it is assigned to an ndarray, streamed into an ndarray with
+   * `operator<<` or used as a right-hand side of an inplace operation.
+   *
+   * @tparam E - type of the expression
+   */
+  template <typename E>
+  struct expression {
+    const E& self() const { return static_cast<const E&>(*this); }
+  };
+
+  template <typename E>
+  constexpr bool is_expression_v = std::is_base_of_v<expression<E>, E>;
+
+  namespace detail {
+    struct plus_op {
+      template <typename A>
+      A operator()(const A& a, const A& b) const {
+        return a + b;
+      }
+    };
+    struct minus_op {
+      template <typename A>
+      A operator()(const A& a, const A& b) const {
+        return a - b;
+      }
+    };
+    struct multiplies_op {
+      template <typename A>
+      A operator()(const A& a, const A& b) const {
+        return a * b;
+      }
+    };
+    struct divides_op {
+      template <typename A>
+      A operator()(const A& a, const A& b) const {
+        return a / b;
+      }
+    };
+    struct negate_op {
+      template <typename A>
+      A operator()(const A& a) const {
+        return -a;
+      }
+    };
+
+    /**
+     * Store value into destination element
+     */
+    struct assign_op {
+      template <typename T, typename V>
+      void operator()(T& dst, const V& value) const {
+        dst = T(value);
+      }
+    };
+
+    /**
+     * Combine value with destination element: dst = Op(dst, T(value))
+     */
+    template <typename Op>
+    struct compound_op {
+      template <typename T, typename V>
+      void operator()(T& dst, const V& value) const {
+        dst = Op{}(dst, T(value));
+      }
+    };
+
+    /**
+     * Shape of the result of an element-wise operation on operands of shapes `a` and `b`. Shapes are broadcast following
+     * NumPy rules: they are aligned at the last axis, missing leading axes are added and extents should either be equal
+     * or one of them should be 1.
+     */
+    template <size_t D1, size_t D2>
+    std::array<size_t, std::max(D1, D2)> broadcast_shape(const std::array<size_t, D1>& a, const std::array<size_t, D2>& b) {
+      constexpr size_t                  D = std::max(D1, D2);
+      std::array<size_t, D>             shape;
+      for (size_t i = 0; i < D; ++i) {
+        size_t ea = i + D1 >= D ? a[i + D1 - D] : 1;
+        size_t eb = i + D2 >= D ? b[i + D2 - D] : 1;
+        if (ea != eb && ea != 1 && eb != 1) throw std::runtime_error("Shapes can not be broadcast together.");
+        shape[i] = ea == 1 ? eb : ea;
+      }
+      return shape;
+    }
+
+    /**
+     * Strides of an array broadcast to a new shape. Broadcast axes get zero stride, so that the same element is read
+     * along them.
+     *
+     * @param shape - shape of the array
+     * @param strides - strides of the array
+     * @param new_shape - shape to broadcast to
+     * @return strides of the broadcast view
+     */
+    template <size_t Dim, size_t NewDim>
+    std::array<size_t, NewDim> broadcast_strides(const std::array<size_t, Dim>& shape, const std::array<size_t, Dim>& strides,
+                                                 const std::array<size_t, NewDim>& new_shape) {
+      static_assert(NewDim >= Dim, "Array can not be broadcast to a smaller dimension.");
+      std::array<size_t, NewDim> new_strides{};
+      for (size_t i = NewDim - Dim; i < NewDim; ++i) {
+        size_t j = i + Dim - NewDim;
+        if (shape[j] == new_shape[i]) {
+          new_strides[i] = strides[j];
+        } else if (shape[j] != 1) {
+          throw std::runtime_error("Shapes can not be broadcast together.");
+        }
+      }
+      return new_strides;
+    }
+
+    /**
+     * Strides with extent-1 axes replaced, so that they merge with their neighbours. Elements along such axes are never
+     * advanced, so addresses do not change. An inner extent-1 axis takes the stride of the innermost longer axis, an
+     * outer one takes the span of the axis below it. Adjacent axes `a` and `a + 1` are then mergeable exactly when
+     * `strides[a] == strides[a + 1] * shape[a + 1]`, as if extent-1 axes were dropped.
+     *
+     * @param shape - shape of the array
+     * @param strides - strides of the array
+     * @return strides suitable for merging of axes
+     */
+    template <size_t Dim>
+    std::array<size_t, Dim> merge_strides(const std::array<size_t, Dim>& shape, std::array<size_t, Dim> strides) {
+      size_t next = 1;
+      for (size_t a = Dim; a-- > 0;) {
+        if (shape[a] != 1) {
+          next = strides[a];
+          break;
+        }
+      }
+      for (size_t a = Dim; a-- > 0;) {
+        if (shape[a] == 1) strides[a] = next;
+        next = strides[a] * shape[a];
+      }
+      return strides;
+    }
+
+    /**
+     * Accessors to a single row of an expression along the innermost axis. `Unit` rows have unit stride, so that the
+     * innermost loop of the evaluation can be vectorized.
+     */
+    template <typename T, bool Unit>
+    struct strided_row {
+      const T* ptr;
+      size_t   stride;
+      T        operator[](size_t j) const {
+        if constexpr (Unit) {
+          return ptr[j];
+        } else {
+          return ptr[j * stride];
+        }
+      }
+    };
+
+    template <typename T>
+    struct scalar_row {
+      T value;
+      T operator[](size_t) const { return value; }
+    };
+
+    template <typename Op, typename V, typename L, typename R>
+    struct binary_row {
+      L l;
+      R r;
+      V operator[](size_t j) const { return Op{}(V(l[j]), V(r[j])); }
+    };
+
+    template <typename Op, typename E>
+    struct unary_row {
+      E e;
+      auto operator[](size_t j) const { return Op{}(e[j]); }
+    };
+  }  // namespace detail
+
+  /**
+   * Leaf of an expression tree that refers to an array. Array is held by value, i.e. expression shares memory with
+   * the array and keeps it alive, so expression can safely outlive temporary slices it was built from. Elements are
+   * only read, so the array is held as a view and copy-on-write arrays are never copied by expressions.
+   */
+  template <typename T, size_t Dim>
+  struct array_expr : expression<array_expr<T, Dim>> {
+    using value_type                  = std::remove_const_t<T>;
+    static constexpr size_t dimension = Dim;
+
+    explicit array_expr(const ndarray<T, Dim>& array) :
+        array_(array.shape(), array.strides(), array.offset(), array.storage(), detail::view_tag), data_(array.data()),
+        strides_(detail::merge_strides(array.shape(), array.strides())) {}
+
+    const std::array<size_t, Dim>& shape() const { return array_.shape(); }
+    size_t                         size() const { return array_.size(); }
+    bool                           is_contiguous() const { return array_.is_contiguous(); }
+    /**
+     * @return true if axes `axis` and `axis + 1` can be walked as a single axis
+     */
+    bool                           mergeable(size_t axis) const {
+      return strides_[axis] == strides_[axis + 1] * array_.shape()[axis + 1];
+    }
+    bool                           unit_inner() const { return strides_[Dim - 1] == 1; }
+
+    /**
+     * @return leaf that refers to a zero-stride view of the array broadcast to `shape`
+     */
+    template <size_t D>
+    array_expr<T, D> broadcast(const std::array<size_t, D>& shape) const {
+      if constexpr (D == Dim) {
+        if (shape == array_.shape()) return *this;
+      }
+      return array_expr<T, D>(
+          ndarray<T, D>(shape, detail::broadcast_strides(array_.shape(), array_.strides(), shape), array_.offset(), array_.storage()));
+    }
+
+    value_type operator[](size_t i) const { return data_[i]; }
+
+    /**
+     * @return pointer to the first element of the array
+     */
+    const T*   data() const { return data_; }
+
+    /**
+     * Row along the innermost axis that starts at multi-index `index`
+     */
+    template <bool Unit>
+    detail::strided_row<value_type, Unit> row(const std::array<size_t, Dim>& index) const {
+      size_t offset = 0;
+      for (size_t i = 0; i < Dim; ++i) offset += index[i] * strides_[i];
+      return {data_ + offset, strides_[Dim - 1]};
+    }
+
+    template <typename... Indices>
+    value_type operator()(Indices... inds) const {
+      return array_(inds...);
+    }
+
+  private:
+    ndarray<T, Dim>         array_;
+    const T*                data_;
+    // strides of the array for merging of axes, see `merge_strides`
+    std::array<size_t, Dim> strides_;
+  };
+
+  /**
+   * Scalar operand of an expression
+   */
+  template <typename T>
+  struct scalar_expr {
+    using value_type                  = T;
+    static constexpr size_t dimension = 0;
+
+    explicit scalar_expr(T value) : value_(value) {}
+
+    bool is_contiguous() const { return true; }
+    bool mergeable(size_t) const { return true; }
+    bool unit_inner() const { return true; }
+    T    operator[](size_t) const { return value_; }
+    T    value() const { return value_; }
+
+    template <size_t D>
+    scalar_expr broadcast(const std::array<size_t, D>&) const {
+      return *this;
+    }
+
+    template <bool Unit, size_t D>
+    detail::scalar_row<T> row(const std::array<size_t, D>&) const {
+      return {value_};
+    }
+
+    template <typename... Indices>
+    T operator()(Indices...) const {
+      return value_;
+    }
+
+  private:
+    T value_;
+  };
+
+  /**
+   * Element-wise binary operation. Operands are converted into the common type before the operation,
+   * following the rules of non-lazy operators.
+   */
+  template <typename Op, typename L, typename R>
+  struct binary_expr : expression<binary_expr<Op, L, R>> {
+    using value_type                  = std::common_type_t<typename L::value_type, typename R::value_type>;
+    static constexpr size_t dimension = std::max(L::dimension, R::dimension);
+    static_assert(L::dimension == R::dimension || L::dimension == 0 || R::dimension == 0,
+                  "Operands of element-wise operation should have the same dimension.");
+
+    binary_expr(const L& l, const R& r) : l_(l), r_(r) {
+#ifndef NDEBUG
+      if constexpr (L::dimension != 0 && R::dimension != 0) {
+        if (!std::equal(l_.shape().begin(), l_.shape().end(), r_.shape().begin())) {
+          throw std::runtime_error("Arrays size is miss matched.");
+        }
+      }
+#endif
+    }
+
+    const std::array<size_t, dimension>& shape() const {
+      if constexpr (L::dimension == 0) {
+        return r_.shape();
+      } else {
+        return l_.shape();
+      }
+    }
+    size_t size() const {
+      if constexpr (L::dimension == 0) {
+        return r_.size();
+      } else {
+        return l_.size();
+      }
+    }
+    bool       is_contiguous() const { return l_.is_contiguous() && r_.is_contiguous(); }
+    bool       mergeable(size_t axis) const { return l_.mergeable(axis) && r_.mergeable(axis); }
+    bool       unit_inner() const { return l_.unit_inner() && r_.unit_inner(); }
+
+    value_type operator[](size_t i) const { return Op{}(value_type(l_[i]), value_type(r_[i])); }
+
+    template <size_t D>
+    auto broadcast(const std::array<size_t, D>& shape) const {
+      auto l = l_.broadcast(shape);
+      auto r = r_.broadcast(shape);
+      return binary_expr<Op, decltype(l), decltype(r)>(l, r);
+    }
+
+    template <bool Unit>
+    auto row(const std::array<size_t, dimension>& index) const {
+      using row_l = decltype(l_.template row<Unit>(index));
+      using row_r = decltype(r_.template row<Unit>(index));
+      return detail::binary_row<Op, value_type, row_l, row_r>{l_.template row<Unit>(index), r_.template row<Unit>(index)};
+    }
+
+    template <typename... Indices>
+    value_type operator()(Indices... inds) const {
+      return Op{}(value_type(l_(inds...)), value_type(r_(inds...)));
+    }
+
+    const L& left() const { return l_; }
+    const R& right() const { return r_; }
+
+  private:
+    L l_;
+    R r_;
+  };
+
+  /**
+   * Element-wise unary operation
+   */
+  template <typename Op, typename E>
+  struct unary_expr : expression<unary_expr<Op, E>> {
+    using value_type                  = typename E::value_type;
+    static constexpr size_t dimension = E::dimension;
+
+    explicit unary_expr(const E& e) : e_(e) {}
+
+    const std::array<size_t, dimension>& shape() const { return e_.shape(); }
+    size_t                               size() const { return e_.size(); }
+    bool                                 is_contiguous() const { return e_.is_contiguous(); }
+    bool                                 mergeable(size_t axis) const { return e_.mergeable(axis); }
+    bool                                 unit_inner() const { return e_.unit_inner(); }
+
+    value_type                           operator[](size_t i) const { return Op{}(e_[i]); }
+
+    template <size_t D>
+    auto broadcast(const std::array<size_t, D>& shape) const {
+      auto e = e_.broadcast(shape);
+      return unary_expr<Op, decltype(e)>(e);
+    }
+
+    template <bool Unit>
+    auto row(const std::array<size_t, dimension>& index) const {
+      using row_e = decltype(e_.template row<Unit>(index));
+      return detail::unary_row<Op, row_e>{e_.template row<Unit>(index)};
+    }
+
+    template <typename... Indices>
+    value_type operator()(Indices... inds) const {
+      return Op{}(e_(inds...));
+    }
+
+  private:
+    E e_;
+  };
+
+  namespace detail {
+    template <typename E>
+    struct scaling_leaf {
+      static constexpr bool complex_array = false;
+      static constexpr bool real_array    = false;
+      static constexpr bool scalar        = false;
+      static constexpr bool complex       = false;
+    };
+
+    template <typename T, size_t Dim>
+    struct scaling_leaf<array_expr<T, Dim>> {
+      static constexpr bool complex_array = std::is_same_v<std::remove_const_t<T>, complex_d>;
+      static constexpr bool real_array    = std::is_same_v<std::remove_const_t<T>, double>;
+      static constexpr bool scalar        = false;
+      static constexpr bool complex       = false;
+    };
+
+    template <typename T>
+    struct scaling_leaf<scalar_expr<T>> {
+      static constexpr bool complex_array = false;
+      static constexpr bool real_array    = false;
+      static constexpr bool scalar        = std::is_same_v<T, complex_d> || std::is_arithmetic_v<T>;
+      static constexpr bool complex       = std::is_same_v<T, complex_d>;
+    };
+
+    /**
+     * out[i] = in[i] * s or out[i] = in[i] / s. Real factor scales real and imaginary parts separately instead of
+     * being promoted to complex. Division by a complex factor is replaced by multiplication by its reciprocal, so the
+     * result may differ from `std::complex` division in the last bits.
+     */
+    template <typename S>
+    void scale_kernel(complex_d* out, const complex_d* in, size_t n, S s, bool divide) {
+      if constexpr (std::is_same_v<S, complex_d>) {
+        scale_complex(out, in, n, divide ? complex_d(1.0) / s : s);
+      } else if (divide) {
+        divide_real(reinterpret_cast<double*>(out), reinterpret_cast<const double*>(in), 2 * n, double(s));
+      } else {
+        scale_real(reinterpret_cast<double*>(out), reinterpret_cast<const double*>(in), 2 * n, double(s));
+      }
+    }
+
+    /**
+     * SIMD kernel for scaling of contiguous `std::complex<double>` arrays, `value` is true if expression `E` evaluated
+     * with operation `Op` has one. `run(out, expr, begin, n)` evaluates elements `[begin, begin + n)` into `out`.
+     */
+    template <typename E, typename Op>
+    struct scaling_kernel : std::false_type {};
+
+    // x *= s, x /= s
+    template <typename S, typename Op>
+    struct scaling_kernel<scalar_expr<S>, compound_op<Op>>
+        : std::bool_constant<scaling_leaf<scalar_expr<S>>::scalar &&
+                             (std::is_same_v<Op, multiplies_op> || std::is_same_v<Op, divides_op>)> {
+      static void run(complex_d* out, const scalar_expr<S>& expr, size_t, size_t n) {
+        scale_kernel(out, out, n, expr.value(), std::is_same_v<Op, divides_op>);
+      }
+    };
+
+    // x = a * s, x = s * a, x = a / s
+    template <typename Op, typename L, typename R>
+    struct scaling_kernel<binary_expr<Op, L, R>, assign_op> {
+      template <typename A, typename S>
+      static constexpr bool product_v =
+          scaling_leaf<S>::scalar && (scaling_leaf<A>::complex_array || (scaling_leaf<A>::real_array && scaling_leaf<S>::complex));
+      static constexpr bool value = (std::is_same_v<Op, multiplies_op> && (product_v<L, R> || product_v<R, L>)) ||
+                                    (std::is_same_v<Op, divides_op> && scaling_leaf<L>::complex_array && scaling_leaf<R>::scalar);
+
+      static void           run(complex_d* out, const binary_expr<Op, L, R>& expr, size_t begin, size_t n) {
+        if constexpr (scaling_leaf<R>::scalar) {
+          apply(out, expr.left(), expr.right().value(), begin, n);
+        } else {
+          apply(out, expr.right(), expr.left().value(), begin, n);
+        }
+      }
+
+    private:
+      template <typename A, typename S>
+      static void apply(complex_d* out, const A& array, S s, size_t begin, size_t n) {
+        if constexpr (scaling_leaf<A>::real_array) {
+          real_to_complex(out, array.data() + begin, n, s);
+        } else {
+          scale_kernel(out, array.data() + begin, n, s, std::is_same_v<Op, divides_op>);
+        }
+      }
+    };
+
+    /**
+     * Evaluate expression into an array with arbitrary strides. Axes that can be merged for the destination and for every
+     * operand are walked as a single axis, the innermost merged axis is evaluated in a tight loop over rows, and rows
+     * are distributed between threads.
+     */
+    template <bool Unit, typename T, size_t Dim, typename E, typename Op>
+    void evaluate_strided(ndarray<T, Dim>& dst, const E& expr, Op op) {
+      using value_t             = std::remove_const_t<T>;
+      const auto&        shape         = dst.shape();
+      const auto         strides       = merge_strides(shape, dst.strides());
+      auto               dst_mergeable = [&](size_t a) { return strides[a] == strides[a + 1] * shape[a + 1]; };
+      // innermost merged axis
+      size_t             a     = Dim - 1;
+      size_t             inner = shape[a];
+      while (a > 0 && dst_mergeable(a - 1) && expr.mergeable(a - 1)) inner *= shape[--a];
+      // outer merged axes, innermost first; each merged axis is addressed through its innermost original axis
+      std::array<size_t, Dim> axis{};
+      std::array<size_t, Dim> extent{};
+      size_t                  n_outer = 0;
+      size_t                  rows    = 1;
+      while (a > 0) {
+        size_t rep  = --a;
+        size_t ext  = shape[a];
+        while (a > 0 && dst_mergeable(a - 1) && expr.mergeable(a - 1)) ext *= shape[--a];
+        axis[n_outer]     = rep;
+        extent[n_outer++] = ext;
+        rows *= ext;
+      }
+      value_t*     base = const_cast<value_t*>(dst.data());
+      const size_t ds   = strides[Dim - 1];
+      parallel_for(rows, inner, [&](size_t begin, size_t end) {
+        std::array<size_t, Dim> index{};
+        for (size_t k = 0, r = begin; k < n_outer; ++k) {
+          index[axis[k]] = r % extent[k];
+          r /= extent[k];
+        }
+        for (size_t row = begin; row < end; ++row) {
+          size_t offset = 0;
+          for (size_t i = 0; i < Dim; ++i) offset += index[i] * strides[i];
+          value_t* out = base + offset;
+          auto     in  = expr.template row<Unit>(index);
+          if constexpr (Unit) {
+            for (size_t j = 0; j < inner; ++j) op(out[j], in[j]);
+          } else {
+            for (size_t j = 0; j < inner; ++j) op(out[j * ds], in[j]);
+          }
+          for (size_t k = 0; k < n_outer; ++k) {
+            if (++index[axis[k]] < extent[k]) break;
+            index[axis[k]] = 0;
+          }
+        }
+      });
+    }
+
+    /**
+     * Evaluate expression into an existing array in a single pass: op(dst[i], expr[i]) for every element.
+     * Arrays with arbitrary strides are supported, contiguous operands are evaluated with a flat loop. Scaling of
+     * contiguous `std::complex<double>` arrays uses SIMD kernels (see `simd_kernels.h`). Expression of a smaller shape
+     * is broadcast to the shape of the destination.
+     *
+     * @param dst - destination array
+     * @param expr - expression or scalar operand
+     * @param op - operation that combines destination element with the value of expression
+     */
+    template <typename T, size_t Dim, typename E, typename Op>
+    void evaluate(ndarray<T, Dim>& dst, const E& expr, Op op) {
+      dst.detach_if_shared();
+      static_assert(E::dimension <= Dim, "Expression can not be broadcast to an array of smaller dimension.");
+      if constexpr (E::dimension != 0 && E::dimension < Dim) {
+        evaluate(dst, expr.broadcast(dst.shape()), op);
+      } else {
+        if constexpr (E::dimension != 0) {
+          if (!std::equal(dst.shape().begin(), dst.shape().end(), expr.shape().begin())) {
+            // unit extents of the expression are broadcast, destination shape is never changed
+            evaluate(dst, expr.broadcast(dst.shape()), op);
+            return;
+          }
+        }
+        if (dst.size() == 0) return;
+        kernel_scope scope(kernel_kind::elementwise);
+        using value_t = std::remove_const_t<T>;
+        if (dst.is_contiguous() && expr.is_contiguous()) {
+          value_t* out = const_cast<value_t*>(dst.data());
+          if constexpr (std::is_same_v<value_t, complex_d> && scaling_kernel<E, Op>::value) {
+            parallel_for(dst.size(), 1, [&](size_t begin, size_t end) {
+              scaling_kernel<E, Op>::run(out + begin, expr, begin, end - begin);
+            });
+          } else {
+            parallel_for(dst.size(), 1, [&](size_t begin, size_t end) {
+              for (size_t i = begin; i < end; ++i) {
+                op(out[i], expr[i]);
+              }
+            });
+          }
+        } else if (merge_strides(dst.shape(), dst.strides())[Dim - 1] == 1 && expr.unit_inner()) {
+          evaluate_strided<true>(dst, expr, op);
+        } else {
+          evaluate_strided<false>(dst, expr, op);
+        }
+      }
+    }
+  }  // namespace detail
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_EXPRESSION_H
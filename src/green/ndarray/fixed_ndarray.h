@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_FIXED_NDARRAY_H
+#define NDARRAY_FIXED_NDARRAY_H
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "ndarray.h"
+
+namespace green::ndarray {
+
+  /**
+   * Array with extents known at compile time. Elements are stored inline (on the stack for local variables) in C-order,
+   * strides are compile-time constants, so indexing folds into constant offsets and element-wise loops are fully
+   * unrolled for small blocks. Interoperates with `ndarray` through `view()` and `operator<<`.
+   *
+   * @tparam T - type of the elements
+   * @tparam Extents - extents of the axes
+   */
+  template <typename T, size_t... Extents>
+  struct fixed_ndarray {
+    static_assert(sizeof...(Extents) > 0, "Fixed array should have at least one axis");
+    static_assert(!std::is_const_v<T>, "Fixed array owns its elements and can not have constant type");
+
+    using value_type                     = T;
+    static constexpr size_t dimension    = sizeof...(Extents);
+    static constexpr size_t element_size = (Extents * ...);
+
+    /**
+     * Create array with all elements set to zero
+     */
+    constexpr fixed_ndarray() : data_{} {}
+
+    /**
+     * Create array with all elements set to `value`
+     */
+    constexpr explicit fixed_ndarray(const T& value) : data_{} { fill(value); }
+
+    /**
+     * Create array from elements in C-order
+     */
+    constexpr explicit fixed_ndarray(const std::array<T, element_size>& data) : data_(data) {}
+
+    /**
+     * @return extents of the axes
+     */
+    static constexpr std::array<size_t, dimension> shape() { return {Extents...}; }
+
+    /**
+     * @return C-order strides of the axes
+     */
+    static constexpr std::array<size_t, dimension> strides() {
+      std::array<size_t, dimension> strides{};
+      constexpr std::array<size_t, dimension> extents{Extents...};
+      size_t                                  stride = 1;
+      for (size_t k = dimension; k-- > 0;) {
+        strides[k] = stride;
+        stride *= extents[k];
+      }
+      return strides;
+    }
+
+    /**
+     * @return total number of elements
+     */
+    static constexpr size_t size() { return element_size; }
+
+    /**
+     * @return dimension of the array
+     */
+    static constexpr size_t dim() { return dimension; }
+
+    /**
+     * Element access. Offset is computed with compile-time strides.
+     *
+     * @param inds - indices of an element, one per axis
+     * @return reference to an element at (inds...)
+     */
+    template <typename... Indices, typename = std::enable_if_t<sizeof...(Indices) == dimension>>
+    constexpr T& operator()(Indices... inds) {
+      return data_[index(size_t(inds)...)];
+    }
+
+    template <typename... Indices, typename = std::enable_if_t<sizeof...(Indices) == dimension>>
+    constexpr const T& operator()(Indices... inds) const {
+      return data_[index(size_t(inds)...)];
+    }
+
+    constexpr T*       data() { return data_.data(); }
+    constexpr const T* data() const { return data_.data(); }
+
+    constexpr T*       begin() { return data_.data(); }
+    constexpr T*       end() { return data_.data() + element_size; }
+    constexpr const T* begin() const { return data_.data(); }
+    constexpr const T* end() const { return data_.data() + element_size; }
+
+    /**
+     * Set all elements to `value`
+     */
+    constexpr void     fill(const T& value) {
+      for (size_t i = 0; i < element_size; ++i) data_[i] = value;
+    }
+
+    /**
+     * Dynamic array that references elements of the current array. View is only valid during the lifetime of the
+     * current array.
+     */
+    ndarray<T, dimension>       view() { return ndarray<T, dimension>(data(), shape()); }
+    ndarray<const T, dimension> view() const {
+      // external storage is never written through a constant view
+      return ndarray<T, dimension>(const_cast<T*>(data()), shape());
+    }
+
+    /**
+     * @return new dynamic array with a copy of elements
+     */
+    ndarray<T, dimension>       copy() const { return view().copy(); }
+
+    /**
+     * Copy elements of a dynamic array with the same shape, arbitrary strides are supported
+     */
+    template <typename T2>
+    fixed_ndarray& operator<<(const ndarray<T2, dimension>& rhs) {
+      if (rhs.shape() != shape()) {
+        throw std::runtime_error("Shapes of source and destination arrays should be the same");
+      }
+      view() << rhs;
+      return *this;
+    }
+
+    // Element-wise arithmetic, loops have compile-time trip counts
+
+    constexpr fixed_ndarray& operator+=(const fixed_ndarray& rhs) {
+      for (size_t i = 0; i < element_size; ++i) data_[i] += rhs.data_[i];
+      return *this;
+    }
+
+    constexpr fixed_ndarray& operator-=(const fixed_ndarray& rhs) {
+      for (size_t i = 0; i < element_size; ++i) data_[i] -= rhs.data_[i];
+      return *this;
+    }
+
+    template <typename S, typename = std::enable_if_t<is_scalar_v<S>>>
+    constexpr fixed_ndarray& operator*=(const S& value) {
+      for (size_t i = 0; i < element_size; ++i) data_[i] *= value;
+      return *this;
+    }
+
+    template <typename S, typename = std::enable_if_t<is_scalar_v<S>>>
+    constexpr fixed_ndarray& operator/=(const S& value) {
+      for (size_t i = 0; i < element_size; ++i) data_[i] /= value;
+      return *this;
+    }
+
+    friend constexpr fixed_ndarray operator+(fixed_ndarray lhs, const fixed_ndarray& rhs) { return lhs += rhs; }
+    friend constexpr fixed_ndarray operator-(fixed_ndarray lhs, const fixed_ndarray& rhs) { return lhs -= rhs; }
+
+    template <typename S, typename = std::enable_if_t<is_scalar_v<S>>>
+    friend constexpr fixed_ndarray operator*(fixed_ndarray lhs, const S& value) {
+      return lhs *= value;
+    }
+
+    template <typename S, typename = std::enable_if_t<is_scalar_v<S>>>
+    friend constexpr fixed_ndarray operator*(const S& value, fixed_ndarray rhs) {
+      return rhs *= value;
+    }
+
+    friend constexpr bool operator==(const fixed_ndarray& lhs, const fixed_ndarray& rhs) {
+      for (size_t i = 0; i < element_size; ++i) {
+        if (!(lhs.data_[i] == rhs.data_[i])) return false;
+      }
+      return true;
+    }
+
+    friend constexpr bool operator!=(const fixed_ndarray& lhs, const fixed_ndarray& rhs) { return !(lhs == rhs); }
+
+  private:
+    std::array<T, element_size> data_;
+
+    template <typename... Indices>
+    static constexpr size_t index(Indices... inds) {
+      [[maybe_unused]] constexpr std::array<size_t, dimension> extents = shape();
+      constexpr std::array<size_t, dimension>                  str     = strides();
+      const std::array<size_t, dimension>                      ind{{inds...}};
+      size_t                                                   pos = 0;
+      for (size_t i = 0; i < dimension; ++i) {
+#ifndef NDEBUG
+        if (ind[i] >= extents[i]) throw std::logic_error(std::to_string(i) + "-th index is larger than its dimension.");
+#endif
+        pos += ind[i] * str[i];
+      }
+      return pos;
+    }
+  };
+
+  /**
+   * Copy elements of a fixed-shape array into a dynamic array of the same shape
+   */
+  template <typename T, typename T2, size_t... Extents>
+  ndarray<T, sizeof...(Extents)>& operator<<(ndarray<T, sizeof...(Extents)>& lhs, const fixed_ndarray<T2, Extents...>& rhs) {
+    if (lhs.shape() != rhs.shape()) {
+      throw std::runtime_error("Shapes of source and destination arrays should be the same");
+    }
+    lhs << rhs.view();
+    return lhs;
+  }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_FIXED_NDARRAY_H
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_INSTRUMENTATION_H
+#define NDARRAY_INSTRUMENTATION_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace green::ndarray {
+
+  /**
+   * Groups of kernels that can be timed by the instrumentation layer
+   */
+  enum class kernel_kind : size_t {
+    // evaluation of element-wise expressions and inplace operations
+    elementwise,
+    // copies and transpositions with the transpose engine
+    copy,
+    // full and axis reductions, comparisons
+    reduction,
+    // matrix products of tensor contractions
+    contraction,
+    count
+  };
+
+  /**
+   * Accumulated time of a group of kernels
+   */
+  struct kernel_timing {
+    size_t calls   = 0;
+    double seconds = 0.0;
+  };
+
+  /**
+   * Values of the instrumentation counters. Allocations are counted for self-managed memory only (memory resources,
+   * see `storage_t`), wrapped external memory is not allocated by the library. Deep copies are counted in `copy()`
+   * (including `make_contiguous()` and `transpose()`) and `astype()`.
+   */
+  struct instrumentation_counters {
+    size_t                                                allocations     = 0;
+    size_t                                                deallocations   = 0;
+    size_t                                                allocated_bytes = 0;
+    size_t                                                live_bytes      = 0;
+    size_t                                                peak_live_bytes = 0;
+    size_t                                                deep_copies     = 0;
+    size_t                                                copied_bytes    = 0;
+    std::array<kernel_timing, size_t(kernel_kind::count)> kernels{};
+
+    const kernel_timing& kernel(kernel_kind kind) const { return kernels[size_t(kind)]; }
+  };
+
+  /**
+   * True if the library is built with instrumentation (`-DUse_Instrumentation=ON` or `GREEN_NDARRAY_INSTRUMENT`).
+   * Otherwise all counters stay zero and instrumentation has no run-time cost.
+   */
+#ifdef GREEN_NDARRAY_INSTRUMENT
+  inline constexpr bool instrumentation_enabled = true;
+#else
+  inline constexpr bool instrumentation_enabled = false;
+#endif
+
+  namespace detail {
+    struct instrumentation_state {
+      std::atomic<size_t>                                                allocations{0};
+      std::atomic<size_t>                                                deallocations{0};
+      std::atomic<size_t>                                                allocated_bytes{0};
+      std::atomic<size_t>                                                live_bytes{0};
+      std::atomic<size_t>                                                peak_live_bytes{0};
+      std::atomic<size_t>                                                deep_copies{0};
+      std::atomic<size_t>                                                copied_bytes{0};
+      std::array<std::atomic<size_t>, size_t(kernel_kind::count)>        kernel_calls{};
+      std::array<std::atomic<std::int64_t>, size_t(kernel_kind::count)> kernel_ns{};
+      std::atomic<bool>                                                  timing{false};
+    };
+
+    inline instrumentation_state& instrumentation() {
+      static instrumentation_state state;
+      return state;
+    }
+
+    inline void count_allocation([[maybe_unused]] size_t bytes) {
+#ifdef GREEN_NDARRAY_INSTRUMENT
+      instrumentation_state& s = instrumentation();
+      s.allocations.fetch_add(1, std::memory_order_relaxed);
+      s.allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+      size_t live = s.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+      size_t peak = s.peak_live_bytes.load(std::memory_order_relaxed);
+      while (live > peak && !s.peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+      }
+#endif
+    }
+
+    inline void count_deallocation([[maybe_unused]] size_t bytes) {
+#ifdef GREEN_NDARRAY_INSTRUMENT
+      instrumentation_state& s = instrumentation();
+      s.deallocations.fetch_add(1, std::memory_order_relaxed);
+      s.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+#endif
+    }
+
+    inline void count_deep_copy([[maybe_unused]] size_t bytes) {
+#ifdef GREEN_NDARRAY_INSTRUMENT
+      instrumentation_state& s = instrumentation();
+      s.deep_copies.fetch_add(1, std::memory_order_relaxed);
+      s.copied_bytes.fetch_add(bytes, std::memory_order_relaxed);
+#endif
+    }
+
+    /**
+     * Add time spent in the enclosing scope to the timing of a group of kernels, if timing is enabled at run time
+     */
+    class kernel_scope {
+    public:
+#ifdef GREEN_NDARRAY_INSTRUMENT
+      explicit kernel_scope(kernel_kind kind) : kind_(kind), active_(instrumentation().timing.load(std::memory_order_relaxed)) {
+        if (active_) start_ = std::chrono::steady_clock::now();
+      }
+      ~kernel_scope() {
+        if (!active_) return;
+        auto                ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+        instrumentation_state& s = instrumentation();
+        s.kernel_calls[size_t(kind_)].fetch_add(1, std::memory_order_relaxed);
+        s.kernel_ns[size_t(kind_)].fetch_add(ns.count(), std::memory_order_relaxed);
+      }
+#else
+      explicit kernel_scope(kernel_kind) {}
+#endif
+      kernel_scope(const kernel_scope&)            = delete;
+      kernel_scope& operator=(const kernel_scope&) = delete;
+
+#ifdef GREEN_NDARRAY_INSTRUMENT
+    private:
+      kernel_kind                           kind_;
+      bool                                  active_;
+      std::chrono::steady_clock::time_point start_;
+#endif
+    };
+  }  // namespace detail
+
+  /**
+   * Enable or disable timing of kernels. Timing is disabled by default, since reading the clock is not free for small
+   * arrays. Has no effect without instrumentation.
+   */
+  inline void set_kernel_timing([[maybe_unused]] bool enable) {
+#ifdef GREEN_NDARRAY_INSTRUMENT
+    detail::instrumentation().timing.store(enable, std::memory_order_relaxed);
+#endif
+  }
+
+  /**
+   * @return current values of the instrumentation counters. Counters are updated by different threads independently,
+   * so a snapshot taken while other threads allocate may be slightly inconsistent.
+   */
+  inline instrumentation_counters instrumentation_snapshot() {
+    instrumentation_counters      c;
+    detail::instrumentation_state& s = detail::instrumentation();
+    c.allocations                   = s.allocations.load(std::memory_order_relaxed);
+    c.deallocations                 = s.deallocations.load(std::memory_order_relaxed);
+    c.allocated_bytes               = s.allocated_bytes.load(std::memory_order_relaxed);
+    c.live_bytes                    = s.live_bytes.load(std::memory_order_relaxed);
+    c.peak_live_bytes               = s.peak_live_bytes.load(std::memory_order_relaxed);
+    c.deep_copies                   = s.deep_copies.load(std::memory_order_relaxed);
+    c.copied_bytes                  = s.copied_bytes.load(std::memory_order_relaxed);
+    for (size_t k = 0; k < c.kernels.size(); ++k) {
+      c.kernels[k].calls   = s.kernel_calls[k].load(std::memory_order_relaxed);
+      c.kernels[k].seconds = double(s.kernel_ns[k].load(std::memory_order_relaxed)) * 1e-9;
+    }
+    return c;
+  }
+
+  /**
+   * Reset the counters. Memory that is still alive stays accounted in `live_bytes`, peak is reset to the live bytes.
+   */
+  inline void reset_instrumentation() {
+    detail::instrumentation_state& s = detail::instrumentation();
+    s.allocations.store(0, std::memory_order_relaxed);
+    s.deallocations.store(0, std::memory_order_relaxed);
+    s.allocated_bytes.store(0, std::memory_order_relaxed);
+    s.peak_live_bytes.store(s.live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.deep_copies.store(0, std::memory_order_relaxed);
+    s.copied_bytes.store(0, std::memory_order_relaxed);
+    for (size_t k = 0; k < s.kernel_calls.size(); ++k) {
+      s.kernel_calls[k].store(0, std::memory_order_relaxed);
+      s.kernel_ns[k].store(0, std::memory_order_relaxed);
+    }
+  }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_INSTRUMENTATION_H
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_MAPPED_STORAGE_H
+#define NDARRAY_MAPPED_STORAGE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "ndarray.h"
+#include "storage.h"
+
+namespace green::ndarray {
+
+  /**
+   * Access mode of a file mapping
+   */
+  enum class map_mode {
+    // pages are shared with other processes, writing is not allowed
+    read_only,
+    // changes are written back to the file and are visible to other processes
+    read_write,
+    // changes are private to the mapping and are never written back
+    copy_on_write,
+    // as read_write, file is created or extended if it is too small
+    create
+  };
+
+  /**
+   * Expected access pattern of a file mapping, passed to `madvise`
+   */
+  enum class map_advice { normal, sequential, random, will_need };
+
+  /**
+   * Options of a file mapping
+   */
+  struct map_options {
+    map_mode   mode     = map_mode::read_only;
+    // read the whole mapped range into the page cache before returning (Linux only)
+    bool       populate = false;
+    map_advice advice   = map_advice::normal;
+  };
+
+  /**
+   * Unmap file mapping when the last reference is released. Control block holds page-aligned start and length of the
+   * mapping.
+   */
+  inline void mmap_deallocation(shared_mem_blk& blk) {
+    assert(blk.count > 0);
+    if (detail::remove_ref(blk) == 0) {
+      munmap(blk.ptr, blk.size);
+      delete &blk;
+    }
+  }
+
+  namespace detail {
+    [[noreturn]] inline void throw_mapping_error(const std::string& what, const std::string& path) {
+      throw std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+    }
+
+    /**
+     * Closes file descriptor at the end of the scope
+     */
+    struct file_descriptor {
+      int fd;
+      ~file_descriptor() {
+        if (fd >= 0) close(fd);
+      }
+    };
+
+    /**
+     * Read `bytes` bytes of a file starting at byte `offset`, short reads and interrupts are retried
+     */
+    inline void read_file_range(const file_descriptor& file, const std::string& path, void* buffer, size_t bytes,
+                                size_t offset) {
+      char* ptr = static_cast<char*>(buffer);
+      while (bytes > 0) {
+        ssize_t n = pread(file.fd, ptr, bytes, off_t(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw_mapping_error("Can not read file", path);
+        ptr += n;
+        offset += size_t(n);
+        bytes -= size_t(n);
+      }
+    }
+
+    /**
+     * Write `bytes` bytes at the current position of a file, short writes and interrupts are retried
+     */
+    inline void write_file_range(const file_descriptor& file, const std::string& path, const void* buffer, size_t bytes) {
+      const char* ptr = static_cast<const char*>(buffer);
+      while (bytes > 0) {
+        ssize_t n = write(file.fd, ptr, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw_mapping_error("Can not write file", path);
+        ptr += n;
+        bytes -= size_t(n);
+      }
+    }
+
+    /**
+     * Map `size` bytes of a file starting at byte `offset` into memory
+     *
+     * @return storage that owns the mapping and position of the requested range from the beginning of the storage
+     */
+    inline std::pair<storage_t, size_t> map_file_range(const std::string& path, size_t offset, size_t size,
+                                                       const map_options& options) {
+      const bool      writable = options.mode == map_mode::read_write || options.mode == map_mode::create;
+      const int       flags    = options.mode == map_mode::create ? O_RDWR | O_CREAT : (writable ? O_RDWR : O_RDONLY);
+      file_descriptor file{open(path.c_str(), flags, 0644)};
+      if (file.fd < 0) throw_mapping_error("Can not open file", path);
+      struct stat st;
+      if (fstat(file.fd, &st) != 0) throw_mapping_error("Can not stat file", path);
+      if (size_t(st.st_size) < offset + size) {
+        if (options.mode != map_mode::create) {
+          throw std::runtime_error("File '" + path + "' is smaller than the mapped range.");
+        }
+        if (ftruncate(file.fd, off_t(offset + size)) != 0) throw_mapping_error("Can not resize file", path);
+      }
+      // mapping starts at page boundary and covers whole pages
+      const size_t page   = size_t(sysconf(_SC_PAGESIZE));
+      const size_t start  = offset / page * page;
+      const size_t length = (offset + size - start + page - 1) / page * page;
+      const int    prot   = options.mode == map_mode::read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+      int          mflags = options.mode == map_mode::copy_on_write ? MAP_PRIVATE : MAP_SHARED;
+#if defined(MAP_POPULATE)
+      if (options.populate) mflags |= MAP_POPULATE;
+#endif
+      void* ptr = mmap(nullptr, length, prot, mflags, file.fd, off_t(start));
+      if (ptr == MAP_FAILED) throw_mapping_error("Can not map file", path);
+      int advice = MADV_NORMAL;
+      switch (options.advice) {
+        case map_advice::sequential:
+          advice = MADV_SEQUENTIAL;
+          break;
+        case map_advice::random:
+          advice = MADV_RANDOM;
+          break;
+        case map_advice::will_need:
+          advice = MADV_WILLNEED;
+          break;
+        default:
+          break;
+      }
+      if (advice != MADV_NORMAL) madvise(ptr, length, advice);
+      storage_t storage;
+      storage.reset(ptr, mmap_deallocation, length);
+      return {storage, offset - start};
+    }
+  }  // namespace detail
+
+  /**
+   * Create an array over a memory-mapped file. Elements are stored in C-order starting at byte `offset` of the file,
+   * pages are loaded on first access and are shared with every other process that maps the same file. The file is
+   * unmapped when the last array referencing the mapping is released. Read-only mappings require a constant element type.
+   *
+   * @tparam T - type of the elements
+   * @param path - path to the file
+   * @param shape - shape of the array
+   * @param offset - position of the first element in the file in bytes, should be a multiple of the element size
+   * @param options - access mode and paging hints
+   * @return array that references the mapped memory
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> map_file(const std::string& path, const std::array<size_t, Dim>& shape, size_t offset = 0,
+                           const map_options& options = {}) {
+    if (options.mode == map_mode::read_only && !std::is_const_v<T>) {
+      throw std::logic_error("Read-only file mapping requires constant element type.");
+    }
+    if (offset % sizeof(T) != 0) {
+      throw std::logic_error("Offset in a mapped file should be a multiple of the element size.");
+    }
+    std::array<size_t, Dim> strides;
+    size_t                  size = 1;
+    for (size_t k = Dim; k-- > 0;) {
+      strides[k] = size;
+      size *= shape[k];
+    }
+    if (size == 0) return ndarray<T, Dim>(shape, strides, 0, storage_t());
+    auto [storage, position] = detail::map_file_range(path, offset, size * sizeof(T), options);
+    if (position % sizeof(T) != 0 || storage.data().size % sizeof(T) != 0) {
+      throw std::logic_error("Page size should be a multiple of the element size.");
+    }
+    return ndarray<T, Dim>(shape, strides, position / sizeof(T), storage);
+  }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_MAPPED_STORAGE_H
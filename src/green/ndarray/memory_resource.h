@@ -0,0 +1,493 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_MEMORY_RESOURCE_H
+#define NDARRAY_MEMORY_RESOURCE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace green::ndarray {
+
+  /**
+   * Parameters of memory allocation for self-managed storage
+   */
+  struct allocation_policy {
+    // alignment of allocated memory in bytes, should be a power of two
+    size_t alignment           = 64;
+    // allocations of at least this number of bytes are aligned to huge page boundary and advised to use transparent
+    // huge pages (Linux only), 0 disables huge pages
+    size_t huge_page_threshold = 0;
+  };
+
+  /**
+   * @return policy used for all allocations that do not specify their own policy
+   */
+  inline allocation_policy& default_allocation_policy() {
+    static allocation_policy policy;
+    return policy;
+  }
+
+  // size of a transparent huge page
+  inline constexpr size_t huge_page_size = 2ul << 20;
+
+  /**
+   * Allocate memory according to allocation policy. Memory should be released with `std::free`.
+   *
+   * @param size - number of bytes to allocate
+   * @param policy - allocation policy
+   * @return pointer to allocated memory
+   */
+  inline void* aligned_allocate(size_t size, const allocation_policy& policy) {
+    size_t alignment = std::max(policy.alignment, alignof(std::max_align_t));
+    bool   huge      = policy.huge_page_threshold != 0 && size >= policy.huge_page_threshold;
+    if (huge) alignment = std::max(alignment, huge_page_size);
+    if ((alignment & (alignment - 1)) != 0) throw std::invalid_argument("alignment should be a power of two");
+    size_t alloc_size = (std::max(size, size_t(1)) + alignment - 1) / alignment * alignment;
+    void*  ptr        = std::aligned_alloc(alignment, alloc_size);
+    if (ptr == nullptr) throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (huge) madvise(ptr, alloc_size, MADV_HUGEPAGE);
+#endif
+    return ptr;
+  }
+
+  /**
+   * Memory space of the blocks provided by a memory resource
+   */
+  enum class memory_space {
+    // pageable host memory
+    host,
+    // page-locked host memory, accessible by the host and used for asynchronous transfers to and from devices
+    pinned_host,
+    // device memory, not accessible by the host
+    device
+  };
+
+  /**
+   * Interface of a memory resource used by self-managed storage. Memory is always released with the same
+   * size and policy it was allocated with.
+   */
+  class memory_resource {
+  public:
+    virtual ~memory_resource()                                                        = default;
+    virtual void* allocate(size_t size, const allocation_policy& policy)              = 0;
+    virtual void  deallocate(void* ptr, size_t size, const allocation_policy& policy) = 0;
+    /**
+     * @return memory space of the provided blocks. Storage keeps its control block inside of host blocks and allocates
+     * it separately for other memory spaces.
+     */
+    virtual memory_space space() const { return memory_space::host; }
+  };
+
+  /**
+   * Resource that directly allocates aligned memory from the system
+   */
+  class aligned_resource : public memory_resource {
+  public:
+    void* allocate(size_t size, const allocation_policy& policy) override { return aligned_allocate(size, policy); }
+    void  deallocate(void* ptr, size_t, const allocation_policy&) override { std::free(ptr); }
+  };
+
+  /**
+   * @return resource that directly allocates memory from the system
+   */
+  inline memory_resource* system_memory_resource() {
+    static aligned_resource resource;
+    return &resource;
+  }
+
+  /**
+   * Thread-safe resource for small blocks. Blocks of up to `max_block_size` bytes are carved from 64 KiB slabs and
+   * grouped into classes of 64 byte multiples; released blocks are kept in per-class free lists and reused. Small arrays
+   * therefore cost neither a system allocation nor a separate cache line, and arrays created together stay close in
+   * memory. Slabs are only returned to the upstream resource when the resource is destroyed. Larger blocks, blocks
+   * with alignment above 64 bytes or with huge pages, and all blocks of an upstream in device memory are forwarded to
+   * the upstream resource.
+   *
+   * Every thread carves blocks from its own slab and keeps released blocks in its own free lists, so threads that
+   * allocate small arrays concurrently (e.g. `parallel_for` workers) do not contend. Free lists that grow beyond a
+   * batch of blocks are moved to lists shared by all threads under a mutex, where threads with empty lists take them
+   * from. Free lists of a thread are moved to the shared lists when the thread exits.
+   */
+  class small_block_resource : public memory_resource {
+  public:
+    // size and alignment granularity of small blocks
+    static constexpr size_t granularity = 64;
+    // size of a slab requested from the upstream resource
+    static constexpr size_t slab_size   = 64ul << 10;
+
+    /**
+     * @param max_block_size - largest block in bytes that is served from slabs
+     * @param upstream - resource used for slabs and for blocks that are not small
+     */
+    explicit small_block_resource(size_t max_block_size = 1024, memory_resource* upstream = system_memory_resource()) :
+        state_(std::make_shared<shared_state>(std::min(max_block_size, slab_size), upstream)), id_(next_id()) {}
+    small_block_resource(const small_block_resource&)            = delete;
+    small_block_resource& operator=(const small_block_resource&) = delete;
+
+    void*                 allocate(size_t size, const allocation_policy& policy) override {
+      if (!is_small(size, policy)) return state_->upstream->allocate(size, policy);
+      const size_t  cls   = block_class(size);
+      thread_cache& cache = local_cache();
+      if (cache.lists[cls].head == nullptr && state_->shared_blocks[cls].load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        move_batch(state_->lists[cls], cache.lists[cls], batch(cls));
+        state_->shared_blocks[cls].store(state_->lists[cls].count, std::memory_order_relaxed);
+      }
+      if (free_block* block = cache.lists[cls].pop()) return block;
+      const size_t bytes = (cls + 1) * granularity;
+      if (cache.slab_left < bytes) {
+        cache.slab_ptr  = state_->new_slab();
+        cache.slab_left = slab_size;
+      }
+      void* ptr = cache.slab_ptr;
+      cache.slab_ptr += bytes;
+      cache.slab_left -= bytes;
+      return ptr;
+    }
+
+    void deallocate(void* ptr, size_t size, const allocation_policy& policy) override {
+      if (!is_small(size, policy)) return state_->upstream->deallocate(ptr, size, policy);
+      const size_t  cls   = block_class(size);
+      thread_cache& cache = local_cache();
+      cache.lists[cls].push(ptr);
+      if (cache.lists[cls].count > 2 * batch(cls)) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        move_batch(cache.lists[cls], state_->lists[cls], batch(cls));
+        state_->shared_blocks[cls].store(state_->lists[cls].count, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @return number of slabs allocated from the upstream resource
+     */
+    size_t slabs() const {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      return state_->slabs.size();
+    }
+
+    /**
+     * @return largest block in bytes that is served from slabs
+     */
+    size_t       max_block_size() const { return state_->max_block_size; }
+
+    memory_space space() const override { return state_->upstream->space(); }
+
+  private:
+    struct free_block {
+      free_block* next;
+    };
+
+    struct free_list {
+      free_block* head  = nullptr;
+      size_t      count = 0;
+
+      void        push(void* ptr) {
+        head = new (ptr) free_block{head};
+        ++count;
+      }
+
+      free_block* pop() {
+        free_block* block = head;
+        if (block) {
+          head = block->next;
+          --count;
+        }
+        return block;
+      }
+    };
+
+    /**
+     * Slabs and free lists shared by all threads. Thread caches keep a weak reference, so that a thread that exits after
+     * the resource is destroyed does not touch released slabs.
+     */
+    struct shared_state {
+      size_t                           max_block_size;
+      memory_resource*                 upstream;
+      bool                             host_accessible;
+      std::vector<free_list>           lists;
+      // number of blocks in the shared lists, read without the mutex to skip empty lists
+      std::vector<std::atomic<size_t>> shared_blocks;
+      std::vector<void*>               slabs;
+      mutable std::mutex               mutex;
+
+      shared_state(size_t max_block, memory_resource* up) :
+          max_block_size(max_block), upstream(up), host_accessible(up->space() != memory_space::device),
+          lists((max_block + granularity - 1) / granularity), shared_blocks(lists.size()) {}
+      ~shared_state() {
+        for (void* slab : slabs) upstream->deallocate(slab, slab_size, slab_policy());
+      }
+
+      char* new_slab() {
+        std::lock_guard<std::mutex> lock(mutex);
+        slabs.reserve(slabs.size() + 1);
+        char* slab = static_cast<char*>(upstream->allocate(slab_size, slab_policy()));
+        slabs.push_back(slab);
+        return slab;
+      }
+    };
+
+    /**
+     * Free lists and current slab of one thread
+     */
+    struct thread_cache {
+      std::uint64_t               id;
+      std::weak_ptr<shared_state> state;
+      std::vector<free_list>      lists;
+      char*                       slab_ptr  = nullptr;
+      size_t                      slab_left = 0;
+
+      thread_cache(std::uint64_t i, const std::shared_ptr<shared_state>& s) : id(i), state(s), lists(s->lists.size()) {}
+      ~thread_cache() {
+        if (std::shared_ptr<shared_state> shared = state.lock()) {
+          std::lock_guard<std::mutex> lock(shared->mutex);
+          for (size_t cls = 0; cls < lists.size(); ++cls) {
+            move_batch(lists[cls], shared->lists[cls], lists[cls].count);
+            shared->shared_blocks[cls].store(shared->lists[cls].count, std::memory_order_relaxed);
+          }
+        }
+      }
+    };
+
+    std::shared_ptr<shared_state> state_;
+    // caches of destroyed resources are never matched, even if a new resource is created at the same address
+    std::uint64_t                 id_;
+
+    static std::uint64_t          next_id() {
+      static std::atomic<std::uint64_t> id{0};
+      return id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @return cache of the calling thread for this resource, the most recently used cache is checked first
+     */
+    thread_cache& local_cache() {
+      thread_local std::vector<std::unique_ptr<thread_cache>> caches;
+      if (!caches.empty() && caches.front()->id == id_) return *caches.front();
+      auto it = std::find_if(caches.begin(), caches.end(), [this](const auto& cache) { return cache->id == id_; });
+      if (it == caches.end()) {
+        // caches of destroyed resources are dropped
+        caches.erase(std::remove_if(caches.begin(), caches.end(), [](const auto& cache) { return cache->state.expired(); }),
+                     caches.end());
+        caches.push_back(std::make_unique<thread_cache>(id_, state_));
+        it = caches.end() - 1;
+      }
+      std::rotate(caches.begin(), it, it + 1);
+      return *caches.front();
+    }
+
+    /**
+     * Move up to `n` blocks from the front of one free list to another
+     */
+    static void move_batch(free_list& from, free_list& to, size_t n) {
+      for (size_t i = 0; i < n && from.head; ++i) to.push(from.pop());
+    }
+
+    bool is_small(size_t size, const allocation_policy& policy) const {
+      bool huge    = policy.huge_page_threshold != 0 && size >= policy.huge_page_threshold;
+      bool aligned = policy.alignment <= granularity && (policy.alignment & (policy.alignment - 1)) == 0;
+      // free lists are stored inside of released blocks
+      return size <= state_->max_block_size && aligned && !huge && state_->host_accessible;
+    }
+
+    // blocks moved between the lists of a thread and the shared lists at once, about 4 KiB
+    static size_t            batch(size_t cls) { return std::max(size_t(4096) / ((cls + 1) * granularity), size_t(4)); }
+    static size_t            block_class(size_t size) { return (std::max(size, size_t(1)) + granularity - 1) / granularity - 1; }
+    static allocation_policy slab_policy() { return allocation_policy{granularity, 0}; }
+  };
+
+  /**
+   * @return resource used when no other resource is selected. Small blocks are served from slabs of a process-wide
+   * `small_block_resource`, other blocks are allocated from the system.
+   */
+  inline memory_resource* default_memory_resource() {
+    // never destroyed, so that arrays with static storage duration can be released at any point of program exit
+    static small_block_resource* resource = new small_block_resource();
+    return resource;
+  }
+
+  namespace detail {
+    inline memory_resource*& thread_memory_resource() {
+      thread_local memory_resource* resource = nullptr;
+      return resource;
+    }
+  }  // namespace detail
+
+  /**
+   * @return resource used by the calling thread for new self-managed storages
+   */
+  inline memory_resource* current_memory_resource() {
+    memory_resource* resource = detail::thread_memory_resource();
+    return resource ? resource : default_memory_resource();
+  }
+
+  /**
+   * Select memory resource for all self-managed storages allocated by the calling thread until the end of the scope.
+   * Storages allocated within the scope are returned to the same resource whenever they are released.
+   */
+  class scoped_memory_resource {
+  public:
+    explicit scoped_memory_resource(memory_resource& resource) : previous_(detail::thread_memory_resource()) {
+      detail::thread_memory_resource() = &resource;
+    }
+    ~scoped_memory_resource() { detail::thread_memory_resource() = previous_; }
+    scoped_memory_resource(const scoped_memory_resource&)            = delete;
+    scoped_memory_resource& operator=(const scoped_memory_resource&) = delete;
+
+  private:
+    memory_resource* previous_;
+  };
+
+  /**
+   * Statistics of a pool resource
+   */
+  struct pool_statistics {
+    // number of allocations served from cached blocks
+    size_t hits        = 0;
+    // number of allocations forwarded to the upstream resource
+    size_t misses      = 0;
+    // number of cached blocks and their total size in bytes
+    size_t blocks_held = 0;
+    size_t bytes_held  = 0;
+  };
+
+  /**
+   * Thread-safe pool of memory blocks grouped by size classes. Released blocks are cached and reused by allocations of the
+   * same size class, alignment and huge page advice. Blocks are returned to the upstream resource with the policy they
+   * were allocated with. Blocks are never touched by the pool, so it can cache device memory as well. Pool should
+   * outlive every storage allocated from it.
+   */
+  class pool_resource : public memory_resource {
+  public:
+    /**
+     * @param max_bytes_held - maximal total size of the cached blocks, blocks above the limit are returned upstream
+     * @param upstream - resource used to allocate new blocks
+     */
+    explicit pool_resource(size_t max_bytes_held = std::numeric_limits<size_t>::max(),
+                           memory_resource* upstream = default_memory_resource()) :
+        max_bytes_held_(max_bytes_held), upstream_(upstream) {}
+    ~pool_resource() override { release(); }
+    pool_resource(const pool_resource&)            = delete;
+    pool_resource& operator=(const pool_resource&) = delete;
+
+    void*          allocate(size_t size, const allocation_policy& policy) override {
+      size_t                      cls = size_class(size);
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto                        it = free_blocks_.find(block_key(cls, policy));
+      if (it != free_blocks_.end() && !it->second.empty()) {
+        void* ptr = it->second.back();
+        it->second.pop_back();
+        ++stats_.hits;
+        --stats_.blocks_held;
+        stats_.bytes_held -= cls;
+        return ptr;
+      }
+      ++stats_.misses;
+      void* ptr = upstream_->allocate(cls, policy);
+      try {
+        policies_.emplace(ptr, policy);
+      } catch (...) {
+        upstream_->deallocate(ptr, cls, policy);
+        throw;
+      }
+      return ptr;
+    }
+
+    void deallocate(void* ptr, size_t size, const allocation_policy& policy) override {
+      size_t                      cls = size_class(size);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stats_.bytes_held + cls > max_bytes_held_) {
+        release_block(ptr, cls);
+        return;
+      }
+      free_blocks_[block_key(cls, policy)].push_back(ptr);
+      ++stats_.blocks_held;
+      stats_.bytes_held += cls;
+    }
+
+    /**
+     * Return all cached blocks to the upstream resource
+     */
+    void release() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& [key, blocks] : free_blocks_) {
+        for (void* ptr : blocks) release_block(ptr, std::get<0>(key));
+      }
+      free_blocks_.clear();
+      stats_.blocks_held = 0;
+      stats_.bytes_held  = 0;
+    }
+
+    pool_statistics statistics() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return stats_;
+    }
+
+    memory_space space() const override { return upstream_->space(); }
+
+    void reset_statistics() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.hits   = 0;
+      stats_.misses = 0;
+    }
+
+    /**
+     * Size classes are powers of two up to a page and multiples of a page above it
+     */
+    static size_t size_class(size_t size) {
+      constexpr size_t page = 4096;
+      if (size > page) return (size + page - 1) / page * page;
+      size_t cls = 64;
+      while (cls < size) cls <<= 1;
+      return cls;
+    }
+
+  private:
+    // size class, alignment and huge page advice of interchangeable blocks
+    using block_key_t = std::tuple<size_t, size_t, bool>;
+
+    size_t                                       max_bytes_held_;
+    memory_resource*                             upstream_;
+    std::map<block_key_t, std::vector<void*>>    free_blocks_;
+    // policies of all blocks allocated from the upstream resource that have not been returned to it
+    std::unordered_map<void*, allocation_policy> policies_;
+    pool_statistics                              stats_;
+    mutable std::mutex                           mutex_;
+
+    static block_key_t block_key(size_t cls, const allocation_policy& policy) {
+      return {cls, policy.alignment, policy.huge_page_threshold != 0 && cls >= policy.huge_page_threshold};
+    }
+
+    /**
+     * Return block to the upstream resource with the policy it was allocated with, mutex should be held
+     */
+    void release_block(void* ptr, size_t cls) {
+      auto it = policies_.find(ptr);
+      upstream_->deallocate(ptr, cls, it->second);
+      policies_.erase(it);
+    }
+  };
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_MEMORY_RESOURCE_H
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_MPI_STORAGE_H
+#define NDARRAY_MPI_STORAGE_H
+
+#include <mpi.h>
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "ndarray.h"
+#include "storage.h"
+
+namespace green::ndarray {
+
+  /**
+   * Control block of a node-shared MPI window. Every rank of the node holds its own control block that references the
+   * same window memory.
+   */
+  struct mpi_shared_mem_blk : shared_mem_blk {
+    MPI_Win  win;
+    // node-local communicator the window was allocated on
+    MPI_Comm comm;
+
+    mpi_shared_mem_blk(void* p, size_t s, MPI_Win w, MPI_Comm c) : shared_mem_blk(p, s, 1), win(w), comm(c) {}
+  };
+
+  /**
+   * Free node-shared window when the last local reference is released. `MPI_Win_free` is collective over the node
+   * communicator, so every rank of the node has to release its last reference to the window at the same point of
+   * execution, and before `MPI_Finalize`.
+   */
+  inline void mpi_window_deallocation(shared_mem_blk& blk) {
+    assert(blk.count > 0);
+    if (detail::remove_ref(blk) == 0) {
+      auto& mpi_blk = static_cast<mpi_shared_mem_blk&>(blk);
+      MPI_Win_unlock_all(mpi_blk.win);
+      MPI_Win_free(&mpi_blk.win);
+      MPI_Comm_free(&mpi_blk.comm);
+      delete &mpi_blk;
+    }
+  }
+
+  namespace detail {
+    inline void check_mpi(int status, const std::string& what) {
+      if (status != MPI_SUCCESS) {
+        char message[MPI_MAX_ERROR_STRING];
+        int  length = 0;
+        MPI_Error_string(status, message, &length);
+        throw std::runtime_error(what + ": " + std::string(message, length));
+      }
+    }
+
+    inline const mpi_shared_mem_blk& mpi_window_blk(const storage_t& storage) {
+      if (storage.release() != mpi_window_deallocation) {
+        throw std::logic_error("Array is not allocated in a shared MPI window.");
+      }
+      return static_cast<const mpi_shared_mem_blk&>(storage.data());
+    }
+
+    /**
+     * Allocate `size` bytes in a window shared by all ranks of `comm` that run on the same node. Memory is allocated on
+     * the node-local rank 0, other ranks map the same memory.
+     */
+    inline storage_t allocate_shared_window(size_t size, MPI_Comm comm) {
+      MPI_Comm node_comm;
+      check_mpi(MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm),
+                "Can not create node communicator");
+      int rank;
+      MPI_Comm_rank(node_comm, &rank);
+      void*   base;
+      MPI_Win win;
+      int     status = MPI_Win_allocate_shared(MPI_Aint(rank == 0 ? size : 0), 1, MPI_INFO_NULL, node_comm, &base, &win);
+      if (status != MPI_SUCCESS) {
+        MPI_Comm_free(&node_comm);
+        check_mpi(status, "Can not allocate shared window");
+      }
+      MPI_Aint query_size;
+      int      disp_unit;
+      MPI_Win_shared_query(win, 0, &query_size, &disp_unit, &base);
+      // passive target epoch stays open for the lifetime of the window, so that `shared_window_fence` can use MPI_Win_sync
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+      storage_t storage;
+      storage.adopt(new mpi_shared_mem_blk(base, size, win, node_comm), mpi_window_deallocation);
+      return storage;
+    }
+  }  // namespace detail
+
+  /**
+   * Create array in a memory window shared by all ranks of `comm` that run on the same node. Call is collective over
+   * `comm`. Only one copy of the data is kept per node and every rank gets a view of it, elements are not initialized.
+   * Window is freed collectively when the last reference on each rank is released (see `mpi_window_deallocation`).
+   *
+   *     auto h = shared_window_ndarray<double>(std::array<size_t, 2>{n, n});
+   *     if (shared_window_rank(h) == 0) read_hamiltonian(h);
+   *     shared_window_fence(h);
+   *
+   * @tparam T - type of the elements
+   * @param shape - shape of the array
+   * @param comm - communicator, split into node-local communicators
+   * @return C-ordered array backed by the shared window
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> shared_window_ndarray(const std::array<size_t, Dim>& shape, MPI_Comm comm = MPI_COMM_WORLD) {
+    static_assert(std::is_trivially_copyable_v<std::remove_const_t<T>>, "Shared window elements should be trivially copyable");
+    std::array<size_t, Dim> strides;
+    size_t                  size = 1;
+    for (size_t k = Dim; k-- > 0;) {
+      strides[k] = size;
+      size *= shape[k];
+    }
+    return ndarray<T, Dim>(shape, strides, 0, detail::allocate_shared_window(size * sizeof(T), comm));
+  }
+
+  /**
+   * @return node-local communicator of the window that backs `array`
+   */
+  template <typename T, size_t Dim>
+  MPI_Comm shared_window_comm(const ndarray<T, Dim>& array) {
+    return detail::mpi_window_blk(array.storage()).comm;
+  }
+
+  /**
+   * @return rank of the calling process in the node-local communicator of the window that backs `array`
+   */
+  template <typename T, size_t Dim>
+  int shared_window_rank(const ndarray<T, Dim>& array) {
+    int rank;
+    MPI_Comm_rank(shared_window_comm(array), &rank);
+    return rank;
+  }
+
+  /**
+   * Synchronize node-local ranks after writing into a shared window. Call is collective over the node communicator,
+   * writes of every rank before the fence are visible to all ranks after it.
+   */
+  template <typename T, size_t Dim>
+  void shared_window_fence(const ndarray<T, Dim>& array) {
+    const mpi_shared_mem_blk& blk = detail::mpi_window_blk(array.storage());
+    MPI_Win_sync(blk.win);
+    MPI_Barrier(blk.comm);
+    MPI_Win_sync(blk.win);
+  }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_MPI_STORAGE_H
@@ -9,14 +9,17 @@
 #include <algorithm>
 #include <array>
 #include <complex>
-#include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <numeric>
 #include <string>
 #include <vector>
 
+#include "expression.h"
 #include "storage.h"
+#include "strided_iterator.h"
+#include "transpose_engine.h"
 
 namespace green::ndarray {
 
@@ -39,6 +42,82 @@ namespace green::ndarray {
   template <typename T>
   constexpr bool is_scalar_v = is_scalar<T>::value;
 
+  /**
+   * Tag type to construct an array without initialization of its elements
+   */
+  struct uninitialized_t {
+    explicit uninitialized_t() = default;
+  };
+  inline constexpr uninitialized_t uninitialized{};
+
+  /**
+   * Tag type to set all elements of an array to zero when it is constructed over an external memory
+   */
+  struct zero_fill_t {
+    explicit zero_fill_t() = default;
+  };
+  inline constexpr zero_fill_t zero_fill{};
+
+  /**
+   * Range of indices [start, stop) with a positive step along a single axis of an array. Stop is clamped to the extent
+   * of the axis, so `range(start)` selects everything from `start` to the end of the axis.
+   */
+  struct range {
+    size_t start = 0;
+    size_t stop  = std::numeric_limits<size_t>::max();
+    size_t step  = 1;
+
+    constexpr range() = default;
+    constexpr explicit range(size_t start_, size_t stop_ = std::numeric_limits<size_t>::max(), size_t step_ = 1) :
+        start(start_), stop(stop_), step(step_) {}
+  };
+
+  /**
+   * Tag type to select all indices along an axis
+   */
+  struct all_t {
+    explicit all_t() = default;
+  };
+  inline constexpr all_t all{};
+
+  namespace detail {
+    /**
+     * Relation of an array to its memory in copy-on-write mode
+     */
+    enum class alias_kind : unsigned char {
+      // array is one of the holders of the memory
+      none,
+      // view created while the memory had at most one holder, its parent
+      view,
+      // view created while the memory was shared by several holders, its parent is unknown
+      shared_view
+    };
+
+    /**
+     * Store value into destination element with conversion between scalar types. Imaginary part is discarded when
+     * complex value is converted into a real one.
+     */
+    struct convert_op {
+      template <typename T, typename V>
+      void operator()(T& dst, const V& value) const {
+        if constexpr (is_complex_v<V> && !is_complex_v<T>) {
+          dst = T(value.real());
+        } else {
+          dst = T(value);
+        }
+      }
+    };
+
+    template <typename I>
+    constexpr bool is_range_index_v = std::is_same_v<std::decay_t<I>, range> || std::is_same_v<std::decay_t<I>, all_t>;
+
+    template <typename... Indices>
+    constexpr bool has_range_index_v = (is_range_index_v<Indices> || ...);
+
+    template <typename... Indices>
+    constexpr size_t fixed_indices_count_v = (size_t(!is_range_index_v<Indices>) + ... + 0);
+  }  // namespace detail
+
   template <typename T, size_t Dim>
   struct ndarray {
     static_assert(is_scalar<T>::value, "ndarray element type should be of a scalar type");
@@ -57,6 +136,14 @@ namespace green::ndarray {
             const storage_t& storage) :
         shape_(shape), strides_(strides), size_(size_for_shape(shape)), offset_(offset), storage_(storage) {}
 
+    /**
+     * Constructor of a view that aliases the memory of another array
+     */
+    ndarray(const std::array<size_t, Dim>& shape, const std::array<size_t, Dim> strides, size_t offset,
+            const storage_t& storage, detail::view_t) : ndarray(shape, strides, offset, storage) {
+      mark_view();
+    }
+
     /**
      * Constructor for initialization from dimensions (allocates memory for attribute storage_).
      *
@@ -72,24 +159,50 @@ namespace green::ndarray {
 
     /**
      * Constructor for initialization from array of dimensions (allocates memory for attribute storage_).
+     * All elements are set to zero.
      *
      * @param[in] shape is array while D is its dimension.
      */
-    explicit ndarray(const std::array<size_t, Dim>& shape) :
-        shape_(get_shape(shape)), strides_(strides_for_shape(shape)), size_(size_for_shape(shape)), offset_(0),
-        storage_(sizeof(T) * size_) {
-      set_value(0.0);
-    }
-    explicit ndarray(const std::vector<size_t>& shape) :
-        shape_(get_shape(shape)), strides_(strides_for_shape(shape)), size_(size_for_shape(shape)), offset_(0),
-        storage_(sizeof(T) * size_) {
+    explicit ndarray(const std::array<size_t, Dim>& shape) : ndarray(shape, uninitialized) { set_value(0.0); }
+    explicit ndarray(const std::vector<size_t>& shape) : ndarray(shape, uninitialized) { set_value(0.0); }
+
+    /**
+     * Constructor for initialization from array of dimensions (allocates memory for attribute storage_).
+     * Elements are left uninitialized, use it when all elements are going to be overwritten anyway.
+     *
+     * @param[in] shape is array while D is its dimension.
+     */
+    ndarray(const std::array<size_t, Dim>& shape, uninitialized_t) : ndarray(shape, default_allocation_policy(), uninitialized) {}
+    ndarray(const std::vector<size_t>& shape, uninitialized_t) : ndarray(shape, default_allocation_policy(), uninitialized) {}
+
+    /**
+     * Constructor for initialization from array of dimensions with custom allocation policy. All elements are set to zero.
+     *
+     * @param[in] shape is array while D is its dimension.
+     * @param[in] policy is alignment and huge page policy for the allocated memory.
+     */
+    template <typename shape_type>
+    ndarray(const shape_type& shape, const allocation_policy& policy) : ndarray(shape, policy, uninitialized) {
       set_value(0.0);
     }
 
     /**
-     * Constructor for initialization from array of dimensions (allocates memory for attribute storage_).
+     * Constructor for initialization from array of dimensions with custom allocation policy. Elements are left uninitialized.
      *
      * @param[in] shape is array while D is its dimension.
+     * @param[in] policy is alignment and huge page policy for the allocated memory.
+     */
+    template <typename shape_type>
+    ndarray(const shape_type& shape, const allocation_policy& policy, uninitialized_t) :
+        shape_(get_shape(shape)), strides_(strides_for_shape(shape)), size_(size_for_shape(shape)), offset_(0),
+        storage_(sizeof(T) * size_, policy) {}
+
+    /**
+     * Constructor for an array over external memory. Memory is not modified and its lifetime is managed outside.
+     *
+     * @param[in] data is pointer to the external memory.
+     * @param[in] dim1 is first dimension.
+     * @param[in] inds are after first dimensions.
      */
     template <typename... Indices>
     explicit ndarray(T* data, size_t dim1, Indices... inds) :
@@ -98,14 +211,24 @@ namespace green::ndarray {
     }) {}
 
     /**
-     * Constructor for initialization from array of dimensions (allocates memory for attribute storage_).
+     * Constructor for an array over external memory. Memory is not modified and its lifetime is managed outside.
      *
+     * @param[in] data is pointer to the external memory.
      * @param[in] shape is array while D is its dimension.
      */
     template <typename shape_type>
     explicit ndarray(T* data, const shape_type& shape) :
         shape_(get_shape(shape)), strides_(strides_for_shape(shape)), size_(size_for_shape(shape)), offset_(0),
-        storage_(data, size_) {
+        storage_(data, size_ * sizeof(T)) {}
+
+    /**
+     * Constructor for an array over external memory. All elements of the external memory are set to zero.
+     *
+     * @param[in] data is pointer to the external memory.
+     * @param[in] shape is array while D is its dimension.
+     */
+    template <typename shape_type>
+    ndarray(T* data, const shape_type& shape, zero_fill_t) : ndarray(data, shape) {
       if (data) set_value(0.0);
     }
 
@@ -130,15 +253,19 @@ namespace green::ndarray {
      */
     template <typename T2 = std::remove_const_t<T>, size_t Dim2, size_t D>
     ndarray(const ndarray<T2, Dim2>& ref, std::array<size_t, D>&& inds) :
-        shape_(get_shape(ref.shape(), inds)), strides_(strides_for_shape(shape_)), size_(size_for_shape(shape_)),
-        offset_(ref.offset() + compute_offset(ref.strides(), inds)), storage_(ref.storage()) {}
+        shape_(get_shape(ref.shape(), inds)), strides_(get_strides<D>(ref.strides())), size_(size_for_shape(shape_)),
+        offset_(ref.offset() + compute_offset(ref.strides(), inds)), storage_(ref.storage()) {
+      mark_view();
+    }
 
     /**
      * Copy constructors
      */
 
     ndarray(const ndarray<T, Dim>& rhs) :
-        shape_(rhs.shape()), strides_(rhs.strides()), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {}
+        shape_(rhs.shape()), strides_(rhs.strides()), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {
+      share_with(rhs);
+    }
 
     /**
      *
@@ -147,15 +274,32 @@ namespace green::ndarray {
      */
     template <typename T2 = std::remove_const_t<T>>
     ndarray(const ndarray<std::enable_if_t<!std::is_same_v<T, T2>, T2>, Dim>& rhs) :
-        shape_(rhs.shape()), strides_(rhs.strides()), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {}
+        shape_(rhs.shape()), strides_(rhs.strides()), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {
+      share_with(rhs);
+    }
 
     template <typename T2 = std::remove_const_t<T>>
     ndarray(const ndarray<const std::enable_if_t<std::is_same_v<T, T2>, T2>, Dim>& rhs) :
-        shape_(rhs.shape()), strides_(rhs.strides()), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {}
+        shape_(rhs.shape()), strides_(rhs.strides()), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {
+      share_with(rhs);
+    }
 
     template <size_t Dim2, typename = std::enable_if<Dim != Dim2>, typename T2 = std::remove_const_t<T>>
     explicit ndarray(const ndarray<T2, Dim2>& rhs) :
-        shape_(), strides_(), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {}
+        shape_(), strides_(), size_(rhs.size()), offset_(rhs.offset()), storage_(rhs.storage()) {
+      set_alias(rhs.alias());
+    }
+
+    /**
+     * Constructor from a lazy expression. New array is allocated and expression is evaluated into it in a single pass.
+     *
+     * @tparam E - type of the expression
+     * @param expr - expression to be evaluated
+     */
+    template <typename E, typename = std::enable_if_t<E::dimension == Dim && std::is_convertible_v<typename E::value_type, T>>>
+    ndarray(const expression<E>& expr) : ndarray(expr.self().shape(), uninitialized) {
+      detail::evaluate(*this, expr.self(), detail::assign_op{});
+    }
 
     /*
      * Move constructor
@@ -164,6 +308,7 @@ namespace green::ndarray {
     ndarray(ndarray<T, Dim>&& rhs) :
         shape_(std::move(rhs.shape_)), strides_(std::move(rhs.strides_)), size_(rhs.size_), offset_(rhs.offset_),
         storage_(std::move(rhs.storage_)) {
+      take_alias(rhs);
       // rhs.storage_ = storage_t();
     }
 
@@ -172,20 +317,26 @@ namespace green::ndarray {
      */
 
     ndarray<T, Dim>& operator=(const ndarray<T, Dim>& rhs) {
+      if (this == &rhs) return *this;
+      set_alias(detail::alias_kind::none);
       shape_   = rhs.shape_;
       strides_ = rhs.strides_;
       size_    = rhs.size_;
       offset_  = rhs.offset_;
       storage_ = rhs.storage_;
+      share_with(rhs);
       return *this;
     }
 
     ndarray<T, Dim>& operator=(ndarray<T, Dim>&& rhs) noexcept {
+      if (this == &rhs) return *this;
+      set_alias(detail::alias_kind::none);
       shape_   = std::move(rhs.shape_);
       strides_ = std::move(rhs.strides_);
       size_    = rhs.size_;
       offset_  = rhs.offset_;
       storage_ = std::move(rhs.storage_);
+      take_alias(rhs);
       return *this;
     }
 
@@ -198,22 +349,40 @@ namespace green::ndarray {
      */
     template <typename Scalar, typename = typename std::enable_if<is_scalar<Scalar>::value>::type>
     ndarray<T, Dim>& operator=(const Scalar rhs) {
-      std::fill(begin(), end(), T(rhs));
+      set_value(rhs);
       return *this;
     };
 
     /**
-     * Deep copy of array
+     * Deep copy of array. Result is always C-contiguous, non-contiguous views are gathered with the transpose engine.
      *
      * @return new array that is a full copy of current array
      */
     ndarray<std::remove_const_t<T>, Dim> copy() const {
-      ndarray<std::remove_const_t<T>, Dim> ret(shape_);
-      std::copy(begin(), end(), ret.begin());
+      ndarray<std::remove_const_t<T>, Dim> ret(shape_, uninitialized);
+      detail::count_deep_copy(size_ * sizeof(T));
+      if (size_ == 0) return ret;
+      detail::permute_copy(data(), ret.data(), detail::merge_axes(shape_, strides_, ret.strides()));
       return ret;
     } // LCOV_EXCL_LINE
 
+    /**
+     * Get C-contiguous representation of the array. If array is already contiguous no data is copied and result shares
+     * memory with current array, otherwise deep copy is returned. Constness of the elements is preserved, so that
+     * read-only memory is never aliased by a mutable array; use `copy()` to obtain a mutable array.
+     *
+     * @return C-contiguous array with the same elements
+     */
+    ndarray<T, Dim> make_contiguous() const {
+      if (is_contiguous()) return *this;
+      return copy();
+    } // LCOV_EXCL_LINE
+
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+    ~ndarray() { set_alias(detail::alias_kind::none); }
+#else
     ~ndarray() = default;
+#endif
 
     /**
      * Returns constant pointer to an element for specific indidces
@@ -244,6 +413,7 @@ namespace green::ndarray {
       size_t num_of_inds = sizeof...(Indices);
       check_dimensions(shape_, num_of_inds);
 #endif
+      detach_if_shared();
       return &storage_.get<T>()[offset_ + get_index(inds...)];
     }
 
@@ -255,11 +425,14 @@ namespace green::ndarray {
      * @return sub-ndarray at `inds` indices
      */
     template <typename... Indices>
-    std::enable_if_t<sizeof...(Indices) < Dim, ndarray<T, Dim - sizeof...(Indices)>> operator()(Indices... inds) {
+    std::enable_if_t<(sizeof...(Indices) < Dim) && !detail::has_range_index_v<Indices...>, ndarray<T, Dim - sizeof...(Indices)>>
+    operator()(Indices... inds) {
 #ifndef NDEBUG
       size_t num_of_inds = sizeof...(Indices);
       check_dimensions(shape_, num_of_inds);
 #endif
+      // sub-array writes into the memory of this array, so it has to be detached first
+      detach_if_shared();
       return ndarray<T, Dim - sizeof...(Indices)>(*this, inds...);
     };
 
@@ -271,8 +444,9 @@ namespace green::ndarray {
      * @return const sub-ndarray at `inds` coordinates
      */
     template <typename... Indices>
-    std::enable_if_t<sizeof...(Indices) < Dim, ndarray<const std::remove_const_t<T>, Dim - sizeof...(Indices)>> operator()(
-        Indices... inds) const {
+    std::enable_if_t<(sizeof...(Indices) < Dim) && !detail::has_range_index_v<Indices...>,
+                     ndarray<const std::remove_const_t<T>, Dim - sizeof...(Indices)>>
+    operator()(Indices... inds) const {
 #ifndef NDEBUG
       size_t num_of_inds = sizeof...(Indices);
       check_dimensions(shape_, num_of_inds);
@@ -290,8 +464,9 @@ namespace green::ndarray {
      * @return value at `inds` indices
      */
     template <typename... Indices>
-    std::enable_if_t<sizeof...(Indices) == Dim, std::conditional_t<std::is_arithmetic_v<T>, T, const T&>> operator()(
-        Indices... inds) const {
+    std::enable_if_t<sizeof...(Indices) == Dim && !detail::has_range_index_v<Indices...>,
+                     std::conditional_t<std::is_arithmetic_v<T>, T, const T&>>
+    operator()(Indices... inds) const {
       return storage_.get<T>()[offset_ + get_index(inds...)];
     }
 
@@ -303,10 +478,37 @@ namespace green::ndarray {
      * @return value at `inds` coordinates
      */
     template <typename... Indices>
-    std::enable_if_t<sizeof...(Indices) == Dim, T>& operator()(Indices... inds) {
+    std::enable_if_t<sizeof...(Indices) == Dim && !detail::has_range_index_v<Indices...>, T>& operator()(Indices... inds) {
+      detach_if_shared();
       return storage_.get<T>()[offset_ + get_index(inds...)];
     }
 
+    /**
+     * Extract a strided view. Every index is either an integer that fixes the axis, a `range` or `all`. Axes without
+     * indices are taken entirely. View shares memory with the current array, e.g. `a(all, 3, range(2, 10, 2))`.
+     *
+     * @tparam Indices - types of indices (integers, `range` or `all_t`)
+     * @param inds - indices of the view
+     * @return view with one dimension per range index and per omitted trailing axis
+     */
+    template <typename... Indices, typename = std::enable_if_t<detail::has_range_index_v<Indices...>>>
+    auto operator()(Indices... inds) {
+      detach_if_shared();
+      return slice<T>(inds...);
+    }
+
+    /**
+     * Extract a constant strided view, see non-const version.
+     *
+     * @tparam Indices - types of indices (integers, `range` or `all_t`)
+     * @param inds - indices of the view
+     * @return constant view with one dimension per range index and per omitted trailing axis
+     */
+    template <typename... Indices, typename = std::enable_if_t<detail::has_range_index_v<Indices...>>>
+    auto operator()(Indices... inds) const {
+      return slice<const std::remove_const_t<T>>(inds...);
+    }
+
     /**
      * Set all elements of an ndarray to be `value`
      *
@@ -315,7 +517,7 @@ namespace green::ndarray {
      */
     template <typename T2>
     typename std::enable_if<is_scalar<T2>::value && std::is_convertible<T2, T>::value>::type set_value(T2 value) {
-      std::fill(begin(), end(), T(value));
+      detail::evaluate(*this, scalar_expr<T>(T(value)), detail::assign_op{});
     }
 
     /**
@@ -336,41 +538,43 @@ namespace green::ndarray {
       std::array<size_t, sizeof...(Indices) + 1> new_shape{
           {ind1, size_t(shape_inds)...}
       };
+      check_contiguous();
 #ifndef NDEBUG
       if (size_for_shape(new_shape) != size_) throw std::logic_error("new shape is not consistent with old one");
 #endif
       ndarray<T, sizeof...(Indices) + 1> result(*this);
-      return result.inplace_reshape(new_shape);
+      return result.set_shape(new_shape);
     }
 
     template <size_t NewDim>
     auto reshape(const std::array<size_t, NewDim>& new_shape) const {
+      check_contiguous();
 #ifndef NDEBUG
       if (size_for_shape(new_shape) != size_) throw std::logic_error("new shape is not consistent with old one");
 #endif
       ndarray<T, NewDim> result(*this);
-      return result.inplace_reshape(new_shape);
+      return result.set_shape(new_shape);
     }
 
     auto reshape(const std::vector<size_t>& new_shape_v) const {
       std::array<size_t, Dim> new_shape;
       std::copy(new_shape_v.begin(), new_shape_v.end(), new_shape.begin());
+      check_contiguous();
 #ifndef NDEBUG
       if (new_shape_v.size() != Dim || size_for_shape(new_shape) != size_)
         throw std::logic_error("new shape is not consistent with old one");
 #endif
       ndarray<T, Dim> result(*this);
-      return result.inplace_reshape(new_shape);
+      return result.set_shape(new_shape);
     }
 
     ndarray<T, Dim>& inplace_reshape(const std::array<size_t, Dim>& shape) {
+      check_contiguous();
 #ifndef NDEBUG
       if (size_for_shape(shape) != size_)
         throw std::logic_error("new shape is not consistent with old one");
 #endif
-      shape_   = shape;
-      strides_ = strides_for_shape(shape);
-      return *this;
+      return set_shape(shape);
     }
 
     template <typename... Indices, typename = std::enable_if_t<sizeof...(Indices) + 1 == Dim>>
@@ -381,6 +585,13 @@ namespace green::ndarray {
       return resize(new_shape);
     }
 
+    /**
+     * Change shape of the array. Elements are left unspecified. Memory is reused when the array is the only owner of
+     * self-managed memory and the new size fits into its capacity, otherwise new memory is allocated.
+     *
+     * @param new_shape - new shape of the array
+     * @param ref_check - throw if memory is shared with another array
+     */
     void resize(const std::array<size_t, Dim>& new_shape, bool ref_check = true) {
       if (ref_check && storage_.data().count && storage_.data().count > 1) {
         throw std::logic_error("can not resize array that is a reference to another array.");
@@ -391,7 +602,37 @@ namespace green::ndarray {
       if(size_for_shape(shape_) == size_)
         return;
       size_    = size_for_shape(shape_);
-      storage_ = storage_t(sizeof(T) * size_);
+      if (owns_memory() && size_ <= capacity()) return;
+      // new memory belongs to the array alone
+      set_alias(detail::alias_kind::none);
+      storage_ = allocate_like(size_);
+    }
+
+    /**
+     * @return number of elements that fit into the memory of the array without reallocation
+     */
+    size_t capacity() const { return owns_memory() ? storage_.data().size / sizeof(T) : size_; }
+
+    /**
+     * Make sure that the array can be resized to `n` elements without reallocation. Elements are preserved, the array
+     * becomes C-contiguous if new memory is allocated.
+     *
+     * @param n - number of elements
+     */
+    void reserve(size_t n) {
+      if (n <= capacity() && owns_memory()) return;
+      if (storage_.data().count > 1) {
+        throw std::logic_error("can not reserve memory for array that is a reference to another array.");
+      }
+      reallocate(std::max(n, size_));
+    }
+
+    /**
+     * Release memory that is not used by the elements of the array
+     */
+    void shrink_to_fit() {
+      if (!owns_memory() || capacity() == size_) return;
+      reallocate(size_);
     }
 
     void resize(const std::vector<size_t>& new_shape_v) {
@@ -406,23 +647,53 @@ namespace green::ndarray {
     // Type change
 
     /**
-     * View array memory in different type. One of the possible use cases is viewing floating point array as a complex array
+     * View array memory in different type. One of the possible use cases is viewing floating point array as a complex array.
+     * Arbitrary strides are supported as long as the last axis has unit stride whenever its extent changes. When
+     * changing to a larger type, strides of the other axes and the offset of the array should be multiples of the size
+     * ratio. See also `real`, `imag` and `view_as_real` for views with non-unit innermost strides.
      *
      * @tparam T2 new type
      * @return new multidimensional array that reinterpret memory into type T2
      */
     template <typename T2>
     ndarray<T2, Dim> view() {
-      if (sizeof(T) < sizeof(T2) and (shape_[Dim - 1] % (sizeof(T2) / sizeof(T))) != 0) {
-        throw std::runtime_error(
-            "When changing to a larger type, its size must be a divisor of the total size in bytes of the last axis of the "
-            "array.");
-      }
+      static_assert(sizeof(T) % sizeof(T2) == 0 || sizeof(T2) % sizeof(T) == 0,
+                    "Size of one type should be a multiple of the size of the other");
+      detach_if_shared();
       std::array<size_t, Dim> new_shape(shape_);
-      new_shape[Dim - 1]          = (shape_[Dim - 1] * sizeof(T)) / sizeof(T2);
-      size_t           new_offset = (offset_ * sizeof(T)) / sizeof(T2);
-      ndarray<T2, Dim> result(new_shape, strides_for_shape(new_shape), new_offset, storage_);
-      return result;
+      std::array<size_t, Dim> new_strides(strides_);
+      size_t                  new_offset = offset_;
+      if constexpr (sizeof(T) > sizeof(T2)) {
+        constexpr size_t ratio = sizeof(T) / sizeof(T2);
+        if (strides_[Dim - 1] != 1 && shape_[Dim - 1] > 1) {
+          throw std::logic_error("Last axis should have unit stride to be viewed in a smaller type.");
+        }
+        for (size_t& stride : new_strides) stride *= ratio;
+        new_strides[Dim - 1] = 1;
+        new_shape[Dim - 1] *= ratio;
+        new_offset *= ratio;
+      } else if constexpr (sizeof(T) < sizeof(T2)) {
+        constexpr size_t ratio = sizeof(T2) / sizeof(T);
+        if ((shape_[Dim - 1] % ratio) != 0) {
+          throw std::runtime_error(
+              "When changing to a larger type, its size must be a divisor of the total size in bytes of the last axis of the "
+              "array.");
+        }
+        if (strides_[Dim - 1] != 1 && shape_[Dim - 1] > 0) {
+          throw std::logic_error("Last axis should have unit stride to be viewed in a larger type.");
+        }
+        for (size_t k = 0; k + 1 < Dim; ++k) {
+          if (strides_[k] % ratio != 0 && shape_[k] > 1) {
+            throw std::runtime_error("Strides of the array are not aligned to the size of the new type.");
+          }
+          new_strides[k] /= ratio;
+        }
+        if (offset_ % ratio != 0) throw std::runtime_error("Offset of the array is not aligned to the size of the new type.");
+        new_strides[Dim - 1] = 1;
+        new_shape[Dim - 1] /= ratio;
+        new_offset /= ratio;
+      }
+      return ndarray<T2, Dim>(new_shape, new_strides, new_offset, storage_, detail::view_tag);
     }
 
     /**
@@ -433,18 +704,9 @@ namespace green::ndarray {
      */
     template <typename T2>
     ndarray<T2, Dim> astype() {
-      std::array<size_t, Dim> new_shape(shape_);
-      ndarray<T2, Dim>        result(new_shape);
-      std::transform(begin(), end(), result.begin(), [](const T& a) {
-        if constexpr (is_complex_v<T> && !is_complex_v<T2>) {
-#ifndef NDEBUG
-          std::cerr << "Imaginary part will be discarded when converting from complex into real";
-#endif
-          return T2(a.real());
-        } else {
-          return T2(a);
-        }
-      });
+      ndarray<T2, Dim> result(shape_, uninitialized);
+      detail::count_deep_copy(size_ * sizeof(T2));
+      detail::evaluate(result, array_expr<T, Dim>(*this), detail::convert_op{});
       return result;
     } // LCOV_EXCL_LINE
 
@@ -462,17 +724,26 @@ namespace green::ndarray {
         throw std::runtime_error("Shapes of source and destination arrays should be the same");
       }
 #endif
-      std::transform(rhs.begin(), rhs.end(), begin(), [](const T& a) {
-        if constexpr (is_complex_v<T2> && !is_complex_v<T>) {
-#ifndef NDEBUG
-          std::cerr << "Imaginary part will be discarded when converting from complex into real";
-#endif
-          return T(a.real());
-        } else {
-          return T(a);
-        }
-      });
-      return *this;
+      if (size_ == 0) return *this;
+      if constexpr (std::is_same_v<std::remove_const_t<T2>, T>) {
+        detail::permute_copy(rhs.data(), data(), detail::merge_axes(shape_, rhs.strides(), strides_));
+      } else {
+        detail::evaluate(*this, array_expr<T2, Dim>(rhs), detail::convert_op{});
+      }
+      return alias_of_this();
+    }
+
+    /**
+     * Evaluate expression directly into the current array
+     *
+     * @tparam E - type of the expression
+     * @param expr - expression to be evaluated
+     * @return current array with values of the expression
+     */
+    template <typename E, typename = std::enable_if_t<E::dimension == Dim>>
+    ndarray<T, Dim> operator<<(const expression<E>& expr) {
+      detail::evaluate(*this, expr.self(), detail::assign_op{});
+      return alias_of_this();
     }
 
     // Data accessors
@@ -482,7 +753,10 @@ namespace green::ndarray {
      *
      * @param new_data pointer to a new data
      */
-    void                           set_ref(T* new_data) { storage_.reset(new_data); }
+    void                           set_ref(T* new_data) {
+      set_alias(detail::alias_kind::none);
+      storage_.reset(new_data);
+    }
 
     /**
      * @return constant pointer to the first element of the array
@@ -491,29 +765,72 @@ namespace green::ndarray {
     /**
      * @return pointer to the first element of the array
      */
-    T*                             data() { return storage_.get<T>() + offset_; }
+    T*                             data() {
+      detach_if_shared();
+      return storage_.get<T>() + offset_;
+    }
 
     /**
-     * Access to the first element for range-based loops
+     * Access to the first element for range-based loops. Elements are visited in C-order for any strides.
      * @return
      */
-    const T*                       begin() const { return storage_.get<T>() + offset_; }
+    strided_iterator<const T, Dim> begin() const { return {data(), shape_, strides_, 0}; }
     /**
-     * Access to the first element for range-based loops
+     * Access to the first element for range-based loops. Elements are visited in C-order for any strides.
      * @return
      */
-    T*                             begin() { return storage_.get<T>() + offset_; }
+    strided_iterator<T, Dim>       begin() { return {data(), shape_, strides_, 0}; }
 
     /**
      * Access to the last+1 element for range-based loops
      * @return
      */
-    const T*                       end() const { return storage_.get<T>() + offset_ + size_; }
+    strided_iterator<const T, Dim> end() const { return {data(), shape_, strides_, size_}; }
     /**
      * Access to the last+1 element for range-based loops
      * @return
      */
-    T*                             end() { return storage_.get<T>() + offset_ + size_; }
+    strided_iterator<T, Dim>       end() { return {data(), shape_, strides_, size_}; }
+
+    /**
+     * Enable or disable copy-on-write mode. In this mode arrays that share memory, including views, copy the elements
+     * into new memory on the first mutable access (`data()`, element `operator()`, `ref()`, `begin()`, assignments and
+     * compound operators) while the memory is referenced by another array. Sharing therefore never allocates, and
+     * writers never affect other holders. Slices and views (`a(i)`, `a(all, range(0, 2))`, `transpose_view`, `real`, ...)
+     * alias their parent and are written in place. Non-const `operator()` and `view<T2>()` detach the parent before the
+     * view is created, and a copy of a parent that has views gets its own elements right away. Mutable access through a
+     * view throws `std::logic_error` only if its memory is shared with arrays other than its parent, e.g. for views
+     * created by free functions from a shared array; call `detach_if_shared()` on the array before creating such views.
+     * Mode is a property of the memory and applies to every array sharing it.
+     *
+     * Checks in mutable accessors prevent vectorization of element-wise loops, so they are only compiled in when
+     * `GREEN_NDARRAY_COPY_ON_WRITE` is defined (`-DUse_CopyOnWrite=ON`).
+     *
+     * @param enable - true to enable copy-on-write
+     */
+    void                           set_copy_on_write(bool enable = true) {
+#ifndef GREEN_NDARRAY_COPY_ON_WRITE
+      if (enable) throw std::logic_error("Copy-on-write mode requires GREEN_NDARRAY_COPY_ON_WRITE to be defined.");
+#endif
+      storage_.set_copy_on_write(enable);
+    }
+
+    /**
+     * @return true if the array is in copy-on-write mode
+     */
+    bool                           is_copy_on_write() const { return storage_.data().copy_on_write; }
+
+    /**
+     * Copy elements into new memory if the array is in copy-on-write mode and its memory is referenced by another array.
+     * Called by every mutable accessor.
+     */
+    void                           detach_if_shared() {
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+      if constexpr (!std::is_const_v<T>) {
+        if (__builtin_expect(storage_.data().copy_on_write, 0)) detach();
+      }
+#endif
+    }
 
     /**
      * @return shared_ptr object used to store underlying data
@@ -547,12 +864,155 @@ namespace green::ndarray {
      */
     size_t                         dim() const { return shape_.size(); }
 
+    /**
+     * @return true if elements of the array are stored in C-order without gaps
+     */
+    bool                           is_contiguous() const {
+      size_t expected = 1;
+      for (size_t i = Dim; i-- > 0;) {
+        if (shape_[i] != 1 && strides_[i] != expected) return false;
+        expected *= shape_[i];
+      }
+      return true;
+    }
+
   private:
+    /**
+     * @return true if the array is the only owner of self-managed memory
+     */
+    bool owns_memory() const {
+      return (storage_.release() == standard_deallocation || storage_.release() == resource_deallocation) &&
+             detail::use_count(storage_.data()) == 1;
+    }
+
+    /**
+     * Allocate memory for `n` elements with the same policy, memory resource and copy-on-write mode as the current memory
+     */
+    storage_t allocate_like(size_t n) const {
+      storage_t storage;
+      if (storage_.release() == resource_deallocation) {
+        // memory outside of the host space is reallocated in the same space from the same resource
+        storage = storage_t(sizeof(T) * n, storage_.data().policy, *storage_.data().resource);
+      } else {
+        storage = storage_t(sizeof(T) * n, storage_.release() == standard_deallocation ? storage_.data().policy
+                                                                                      : default_allocation_policy());
+      }
+      storage.set_copy_on_write(storage_.data().copy_on_write);
+      return storage;
+    }
+
+    /**
+     * Move elements into new C-contiguous memory of `n` elements
+     */
+    void reallocate(size_t n) {
+      ndarray<T, Dim> moved(shape_, strides_for_shape(shape_), 0, allocate_like(n));
+      if (size_ != 0) moved << *this;
+      *this = std::move(moved);
+    }
+
+    /**
+     * @return number of references to the memory that are not views
+     */
+    int holders() const { return detail::use_count(storage_.data()) - detail::view_count(storage_.data()); }
+
+    /**
+     * Views are registered in the control block of their memory only in copy-on-write builds, where writers have to
+     * tell views of the memory apart from holders that expect their own copy
+     */
+    void set_alias([[maybe_unused]] detail::alias_kind kind) {
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+      if (kind == view_) return;
+      if (view_ == detail::alias_kind::none) storage_.add_view();
+      if (kind == detail::alias_kind::none) storage_.remove_view();
+      view_ = kind;
+#endif
+    }
+
+    detail::alias_kind alias() const {
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+      return view_;
+#else
+      return detail::alias_kind::none;
+#endif
+    }
+
+    /**
+     * Mark a new view of the memory. The view is still counted as a holder, so its parent is known if there is no other
+     * holder.
+     */
+    void mark_view() {
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+      set_alias(holders() <= 2 ? detail::alias_kind::view : detail::alias_kind::shared_view);
+#endif
+    }
+
+    /**
+     * Complete a copy of `rhs`. Copies of views are views of the same parent. A new holder of memory that has views is
+     * detached right away, otherwise a later write of the parent would have to leave its views behind.
+     */
+    template <typename T2, size_t Dim2>
+    void share_with(const ndarray<T2, Dim2>& rhs) {
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+      if (rhs.alias() != detail::alias_kind::none) {
+        set_alias(rhs.alias());
+      } else if (__builtin_expect(storage_.data().copy_on_write, 0) && detail::view_count(storage_.data()) > 0) {
+        ndarray<T, Dim> unique = copy();
+        unique.storage_.set_copy_on_write(true);
+        *this = std::move(unique);
+      }
+#endif
+    }
+
+    /**
+     * @return array that refers to the same elements, in copy-on-write mode it is a view rather than a new holder
+     */
+    ndarray<T, Dim> alias_of_this() const { return ndarray<T, Dim>(shape_, strides_, offset_, storage_, detail::view_tag); }
+
+    /**
+     * Take over the registration of a moved-from array
+     */
+    void take_alias([[maybe_unused]] ndarray<T, Dim>& rhs) {
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+      view_     = rhs.view_;
+      rhs.view_ = detail::alias_kind::none;
+#endif
+    }
+
+    // kept out of line, so that mutable accessors stay cheap
+    [[gnu::noinline]] void detach() {
+      const int others = holders() - (alias() == detail::alias_kind::none);
+      if (others == 0) return;
+      switch (alias()) {
+        case detail::alias_kind::none: {
+          ndarray<T, Dim> unique = copy();
+          unique.storage_.set_copy_on_write(true);
+          *this = std::move(unique);
+          return;
+        }
+        case detail::alias_kind::view:
+          // the only holder is the parent of the view
+          if (others == 1) return;
+          [[fallthrough]];
+        case detail::alias_kind::shared_view:
+          throw std::logic_error(
+              "Can not write through a view of copy-on-write memory that is shared with arrays other than the parent of "
+              "the view. Call detach_if_shared() on the parent before creating the view, or write into copy() of the "
+              "view.");
+      }
+    }
+
+    template <typename, size_t>
+    friend struct ndarray;
+
     std::array<size_t, Dim> shape_;
     std::array<size_t, Dim> strides_;
     size_t                  size_{};
     size_t                  offset_{};
     storage_t               storage_;
+#ifdef GREEN_NDARRAY_COPY_ON_WRITE
+    // array is a slice or a view of memory of another array
+    detail::alias_kind      view_ = detail::alias_kind::none;
+#endif
 
     template <typename... Indices>
     size_t get_index(Indices... inds) const {
@@ -567,7 +1027,7 @@ namespace green::ndarray {
       // size_t ind = std::accumulate(ind_arr.begin(), ind_arr.end(), size_t(0), std::plus<size_t>());
       // return ind;
       auto   ind = std::forward_as_tuple(inds...);
-      size_t pos = std::get<sizeof...(Indices) - 1>(ind);
+      size_t pos = std::get<sizeof...(Indices) - 1>(ind) * strides_[sizeof...(Indices) - 1];
       internal::static_for(std::make_index_sequence<sizeof...(Indices) - 1>{}, [&](auto index) {
         constexpr size_t i = index.value;
         pos += std::get<i>(ind) * strides_[i];
@@ -575,6 +1035,72 @@ namespace green::ndarray {
       return pos;
     }
 
+    /**
+     * Extract strides of a sub-ndarray of a given ndarray with `old_strides` strides
+     *
+     * @tparam D - number of fixed leading indices
+     * @param old_strides - strides of an existing ndarray
+     * @return strides of a sub-ndarray
+     */
+    template <size_t D, typename Container>
+    std::array<size_t, Dim> get_strides(const Container& old_strides) const {
+      std::array<size_t, Dim> strides;
+      internal::static_for(std::make_index_sequence<Dim>{}, [&](auto index) {
+        constexpr size_t i = index.value;
+        strides[i]         = old_strides[i + D];
+      });
+      return strides;
+    }
+
+    /**
+     * Build a strided view for a mixed list of integer and range indices
+     */
+    template <typename T2, typename... Indices>
+    auto slice(Indices... inds) const {
+      static_assert(sizeof...(Indices) <= Dim, "Number of indices is larger than array's dimension");
+      constexpr size_t           NewDim = Dim - detail::fixed_indices_count_v<Indices...>;
+      std::array<size_t, NewDim> shape;
+      std::array<size_t, NewDim> strides;
+      size_t                     offset = offset_;
+      size_t                     k      = 0;
+      auto                       ind    = std::forward_as_tuple(inds...);
+      internal::static_for(std::make_index_sequence<sizeof...(Indices)>{}, [&](auto index) {
+        constexpr size_t i  = index.value;
+        const auto&      in = std::get<i>(ind);
+        using I             = std::decay_t<decltype(in)>;
+        if constexpr (std::is_same_v<I, all_t>) {
+          shape[k]     = shape_[i];
+          strides[k++] = strides_[i];
+        } else if constexpr (std::is_same_v<I, range>) {
+          if (in.step == 0) throw std::logic_error("Step of a range should be positive.");
+          size_t stop = std::min(in.stop, shape_[i]);
+          size_t n    = stop > in.start ? (stop - in.start + in.step - 1) / in.step : 0;
+          if (n != 0) offset += in.start * strides_[i];
+          shape[k]     = n;
+          strides[k++] = strides_[i] * in.step;
+        } else {
+#ifndef NDEBUG
+          if (size_t(in) >= shape_[i]) throw std::logic_error(std::to_string(i) + "-th index is larger than its dimension.");
+#endif
+          offset += size_t(in) * strides_[i];
+        }
+      });
+      for (size_t i = sizeof...(Indices); i < Dim; ++i, ++k) {
+        shape[k]   = shape_[i];
+        strides[k] = strides_[i];
+      }
+      return ndarray<T2, NewDim>(shape, strides, offset, storage_, detail::view_tag);
+    }
+
+    /**
+     * Set new shape and C-order strides without any checks
+     */
+    ndarray<T, Dim>& set_shape(const std::array<size_t, Dim>& shape) {
+      shape_   = shape;
+      strides_ = strides_for_shape(shape);
+      return *this;
+    }
+
     template <typename Container, typename Container2>
     size_t compute_offset(Container&& strides, Container2&& inds) const {
       return std::inner_product(inds.begin(), inds.end(), strides.begin(), 0ul);
@@ -626,13 +1152,22 @@ namespace green::ndarray {
      */
     template <typename Container>
     std::array<size_t, Dim> strides_for_shape(Container&& shape) const {
-      std::array<size_t, Dim> str;
+      std::array<size_t, Dim> str{};
       if (shape.size() == 0) return str;
       str[Dim - 1] = 1;
       for (int k = int(shape.size()) - 2; k >= 0; --k) str[k] = str[k + 1] * shape.data()[k + 1];
       return str;
     }
 
+    /**
+     * Check that array is C-contiguous. Throw an exception if it's not.
+     */
+    void check_contiguous() const {
+      if (!is_contiguous()) {
+        throw std::logic_error("Operation requires C-contiguous array. Use make_contiguous() to obtain one.");
+      }
+    }
+
     /**
      * Check that array is zero-dimension. Throw an exception if it's not.
      */
@@ -7,224 +7,310 @@
 #define ALPS_NDARRAY_MATH_H
 
 #include "ndarray.h"
+#include "reductions.h"
 #include "string_utils.h"
+#include "transpose_engine.h"
+#include "transpose_plan.h"
 
 namespace green::ndarray {
 
   namespace detail {
+    /**
+     * Create a view of an array with permuted axes. No data is copied.
+     *
+     * @param array - source array
+     * @param pattern - target position for each of the source axes
+     * @return array that shares memory with `array` and has permuted shape and strides
+     */
     template <typename T, size_t Dim>
-    ndarray<T, Dim> transpose_impl(const ndarray<T, Dim>& array, const std::vector<size_t>& pattern) {
-      std::vector<size_t> shape(array.shape().size());
-      for (size_t i(0); i < array.shape().size(); ++i) {
-        shape[pattern[i]] = array.shape()[i];
+    ndarray<T, Dim> transpose_view_impl(const ndarray<T, Dim>& array, const std::array<size_t, Dim>& pattern) {
+      std::array<size_t, Dim> shape;
+      std::array<size_t, Dim> strides;
+      for (size_t i(0); i < Dim; ++i) {
+        shape[pattern[i]]   = array.shape()[i];
+        strides[pattern[i]] = array.strides()[i];
       }
-      ndarray<T, Dim>     result(shape);
-      std::vector<size_t> indices(array.dim(), 0);
-      for (size_t i(0); i < array.size(); ++i) {
-        size_t res = i;
-        for (size_t ind(0); ind < array.dim(); ++ind) {
-          indices[pattern[array.dim() - ind - 1]] = res % array.shape()[array.dim() - ind - 1];
-          res /= array.shape()[array.dim() - ind - 1];
-        }
-        std::transform(indices.begin(), indices.end(), result.strides().begin(), indices.begin(), std::multiplies<size_t>());
-        size_t ind                              = std::accumulate(indices.begin(), indices.end(), size_t(0), std::plus<size_t>());
-        result.storage().template get<T>()[ind] = array.storage().template get<T>()[array.offset() + i];
-      }
-      return result;
+      return ndarray<T, Dim>(shape, strides, array.offset(), array.storage(), detail::view_tag);
+    }
+
+    /**
+     * Permute array into a new C-ordered array
+     *
+     * @param array - source array
+     * @param pattern - target position for each of the source axes
+     * @return new array with permuted axes
+     */
+    template <typename T, size_t Dim>
+    ndarray<T, Dim> transpose_impl(const ndarray<T, Dim>& array, const std::array<size_t, Dim>& pattern) {
+      return transpose_view_impl(array, pattern).copy();
     }
   }  // namespace detail
 
-  // Arithmetic operations on tensors
+  namespace detail {
+    template <typename T>
+    struct is_ndarray : std::false_type {};
+    template <typename T, size_t Dim>
+    struct is_ndarray<ndarray<T, Dim>> : std::true_type {};
 
-  // inplace operators
+    /**
+     * Arrays and expressions can be used as operands of element-wise operations
+     */
+    template <typename T>
+    constexpr bool is_operand_v = is_ndarray<T>::value || is_expression_v<T>;
 
-  template <typename T1, typename T2, size_t Dim>
-  std::enable_if_t<std::is_convertible<T2, T1>::value, ndarray<T1, Dim>>& operator+=(ndarray<T1, Dim>&       first,
-                                                                                     const ndarray<T2, Dim>& second) {
-#ifndef NDEBUG
-    if (!std::equal(first.shape().begin(), first.shape().end(), second.shape().begin())) {
-      throw std::runtime_error("Arrays size is miss matched.");
+    template <typename L, typename R>
+    constexpr bool is_additive_operands_v = (is_operand_v<L> && (is_operand_v<R> || is_scalar_v<R>)) ||
+                                            (is_scalar_v<L> && is_operand_v<R>);
+
+    template <typename L, typename R>
+    constexpr bool is_scaling_operands_v = (is_operand_v<L> && is_scalar_v<R>) || (is_scalar_v<L> && is_operand_v<R>);
+
+    template <typename T, size_t Dim>
+    array_expr<T, Dim> as_expr(const ndarray<T, Dim>& array) {
+      return array_expr<T, Dim>(array);
     }
-#endif
-    std::transform(first.begin(), first.end(), second.begin(), first.begin(),
-                   [&](const T1 f, const T2 s) { return T1(f) + T1(s); });
-    return first;
-  }
 
-  template <typename T1, typename T2, size_t Dim>
-  std::enable_if_t<std::is_convertible<T2, T1>::value, ndarray<T1, Dim>>&& operator+=(ndarray<T1, Dim>&&      first,
-                                                                                      const ndarray<T2, Dim>& second) {
-#ifndef NDEBUG
-    if (!std::equal(first.shape().begin(), first.shape().end(), second.shape().begin())) {
-      throw std::runtime_error("Arrays size is miss matched.");
+    template <typename E>
+    std::enable_if_t<is_expression_v<E>, const E&> as_expr(const E& expr) {
+      return expr;
     }
-#endif
-    std::transform(first.begin(), first.end(), second.begin(), first.begin(),
-                   [&](const T1 f, const T2 s) { return T1(f) + T1(s); });
-    return std::move(first);
-  }
 
-  template <typename T1, typename T2, size_t Dim>
-  std::enable_if_t<std::is_convertible<T2, T1>::value, ndarray<T1, Dim>>& operator-=(ndarray<T1, Dim>&       first,
-                                                                                     const ndarray<T2, Dim>& second) {
-#ifndef NDEBUG
-    if (!std::equal(first.shape().begin(), first.shape().end(), second.shape().begin())) {
-      throw std::runtime_error("Arrays size is miss matched.");
+    template <typename T>
+    std::enable_if_t<is_scalar_v<T>, scalar_expr<T>> as_expr(T value) {
+      return scalar_expr<T>(value);
     }
-#endif
-    std::transform(first.begin(), first.end(), second.begin(), first.begin(),
-                   [&](const T1 f, const T2 s) { return T1(f) - T1(s); });
-    return first;
-  }
 
-  template <typename T1, typename T2, size_t Dim>
-  std::enable_if_t<std::is_convertible<T2, T1>::value, ndarray<T1, Dim>>&& operator-=(ndarray<T1, Dim>&&      first,
-                                                                                      const ndarray<T2, Dim>& second) {
-#ifndef NDEBUG
-    if (!std::equal(first.shape().begin(), first.shape().end(), second.shape().begin())) {
-      throw std::runtime_error("Arrays size is miss matched.");
+    template <typename T>
+    using expr_t = std::decay_t<decltype(as_expr(std::declval<const T&>()))>;
+
+    /**
+     * Build binary expression node. Operands of different shapes are broadcast to the common shape.
+     */
+    template <typename Op, typename L, typename R>
+    auto make_binary(const L& l, const R& r) {
+      using LE = expr_t<L>;
+      using RE = expr_t<R>;
+      if constexpr (LE::dimension == 0 || RE::dimension == 0) {
+        return binary_expr<Op, LE, RE>(as_expr(l), as_expr(r));
+      } else {
+        const auto& le    = as_expr(l);
+        const auto& re    = as_expr(r);
+        auto        shape = broadcast_shape(le.shape(), re.shape());
+        auto        lb    = le.broadcast(shape);
+        auto        rb    = re.broadcast(shape);
+        return binary_expr<Op, decltype(lb), decltype(rb)>(lb, rb);
+      }
     }
-#endif
-    std::transform(first.begin(), first.end(), second.begin(), first.begin(),
-                   [&](const T1 f, const T2 s) { return T1(f) - T1(s); });
-    return std::move(first);
+  }  // namespace detail
+
+  // Arithmetic operations on tensors
+
+  // inplace operators
+
+#define INPLACE_MATH_OP(IO, OP)                                                                                          \
+  template <typename T1, size_t Dim, typename E>                                                                         \
+  std::enable_if_t<detail::is_operand_v<E> && std::is_convertible_v<typename E::value_type, T1>, ndarray<T1, Dim>>&      \
+  operator IO(ndarray<T1, Dim>& first, const E& second) {                                                                \
+    detail::evaluate(first, detail::as_expr(second), detail::compound_op<detail::OP>{});                                 \
+    return first;                                                                                                        \
+  }                                                                                                                      \
+                                                                                                                         \
+  template <typename T1, size_t Dim, typename E>                                                                         \
+  std::enable_if_t<detail::is_operand_v<E> && std::is_convertible_v<typename E::value_type, T1>, ndarray<T1, Dim>>&&     \
+  operator IO(ndarray<T1, Dim>&& first, const E& second) {                                                               \
+    detail::evaluate(first, detail::as_expr(second), detail::compound_op<detail::OP>{});                                 \
+    return std::move(first);                                                                                             \
   }
 
+  INPLACE_MATH_OP(+=, plus_op)
+  INPLACE_MATH_OP(-=, minus_op)
+
   // Inplace operations with scalars
 
 #define INPLACE_MATH_OP_WITH_SCALAR(IO, OP)                                                                                  \
   template <typename T1, typename T2, size_t Dim>                                                                            \
   std::enable_if_t<is_scalar_v<T2> && std::is_convertible_v<T2, T1>, ndarray<T1, Dim>>& operator IO(ndarray<T1, Dim>& first, \
                                                                                                     T2                second) {             \
-    std::transform(first.begin(), first.end(), first.begin(), [&](const T1 f) { return T1(f) OP T1(second); });              \
+    detail::evaluate(first, scalar_expr<T2>(second), detail::compound_op<detail::OP>{});                                     \
     return first;                                                                                                            \
   }
 
-  INPLACE_MATH_OP_WITH_SCALAR(+=, +)
-  INPLACE_MATH_OP_WITH_SCALAR(-=, -)
-  INPLACE_MATH_OP_WITH_SCALAR(*=, *)
-  INPLACE_MATH_OP_WITH_SCALAR(/=, /)
+  INPLACE_MATH_OP_WITH_SCALAR(+=, plus_op)
+  INPLACE_MATH_OP_WITH_SCALAR(-=, minus_op)
+  INPLACE_MATH_OP_WITH_SCALAR(*=, multiplies_op)
+  INPLACE_MATH_OP_WITH_SCALAR(/=, divides_op)
 
-  // Binary operations with tensors
-  template <typename T1, typename T2, size_t Dim>
-  ndarray<std::common_type_t<T1, T2>, Dim> operator+(const ndarray<T1, Dim>& first, const ndarray<T2, Dim>& second) {
-    using result_t = std::common_type_t<T1, T2>;
-#ifndef NDEBUG
-    if (!std::equal(first.shape().begin(), first.shape().end(), second.shape().begin())) {
-      throw std::runtime_error("Arrays size is miss matched.");
-    }
-#endif
-    ndarray<result_t, Dim> result(first.shape());
-    std::transform(first.begin(), first.end(), second.begin(), result.begin(),
-                   [&](const T1 f, const T2 s) { return result_t(f) + result_t(s); });
-    return result;
-  } // LCOV_EXCL_LINE
+  // Lazy binary operations with tensors, expressions and scalars.
+  // Result is an expression that is evaluated when it is assigned to an ndarray.
 
-  template <typename T1, typename T2, size_t Dim>
-  ndarray<std::common_type_t<T1, T2>, Dim> operator-(const ndarray<T1, Dim>& first, const ndarray<T2, Dim>& second) {
-    using result_t = std::common_type_t<T1, T2>;
-#ifndef NDEBUG
-    if (!std::equal(first.shape().begin(), first.shape().end(), second.shape().begin())) {
-      throw std::runtime_error("Arrays size is miss matched.");
-    }
-#endif
-    ndarray<result_t, Dim> result(first.shape());
-    std::transform(first.begin(), first.end(), second.begin(), result.begin(),
-                   [&](const T1 f, const T2 s) { return result_t(f) - result_t(s); });
-    return result;
-  } // LCOV_EXCL_LINE
-
-  // Binary operations with scalars
-#define MATH_OP_WITH_SCALAR(OP)                                                                                               \
-  template <typename T1, typename T2, size_t Dim>                                                                             \
-  std::enable_if_t<is_scalar_v<T2>, ndarray<std::common_type_t<T1, T2>, Dim>> operator OP(const ndarray<T1, Dim>& first,      \
-                                                                                          T2                      second) {   \
-    using result_t = std::common_type_t<T1, T2>;                                                                              \
-    ndarray<result_t, Dim> result(first.shape());                                                                             \
-    std::transform(first.begin(), first.end(), result.begin(), [&](const T1 f) { return result_t(f) OP result_t(second); });  \
-    return result;                                                                                                            \
-  }                                                                                                                          \
-                                                                                                                              \
-  template <typename T1, typename T2, size_t Dim>                                                                             \
-  std::enable_if_t<is_scalar_v<T1>, ndarray<std::common_type_t<T1, T2>, Dim>> operator OP(T1                      first,      \
-                                                                                          const ndarray<T2, Dim>& second) {   \
-    using result_t = std::common_type_t<T1, T2>;                                                                              \
-    ndarray<result_t, Dim> result(second.shape());                                                                            \
-    std::transform(second.begin(), second.end(), result.begin(), [&](const T2 s) { return result_t(first) OP result_t(s); }); \
-    return result;                                                                                                            \
+#define MATH_OP(OP, FUN, OPERANDS)                                                                      \
+  template <typename L, typename R, typename = std::enable_if_t<detail::OPERANDS<L, R>>>                \
+  auto operator OP(const L& first, const R& second) {                                                   \
+    return detail::make_binary<detail::FUN>(first, second);                                             \
   }
 
-  MATH_OP_WITH_SCALAR(+)
-  MATH_OP_WITH_SCALAR(-)
-  MATH_OP_WITH_SCALAR(*)
-  MATH_OP_WITH_SCALAR(/)
+  MATH_OP(+, plus_op, is_additive_operands_v)
+  MATH_OP(-, minus_op, is_additive_operands_v)
+  MATH_OP(*, multiplies_op, is_scaling_operands_v)
+  MATH_OP(/, divides_op, is_scaling_operands_v)
 
   // Unary operations
 
-  template <typename T1, size_t Dim>
-  ndarray<T1, Dim> operator-(const ndarray<T1, Dim>& first) {
-    ndarray<T1, Dim> result(first.shape());
-    std::transform(first.begin(), first.end(), result.begin(), [&](const T1 f) { return -f; });
-    return result;
-  } // LCOV_EXCL_LINE
+  template <typename E, typename = std::enable_if_t<detail::is_operand_v<E>>>
+  auto operator-(const E& first) {
+    return unary_expr<detail::negate_op, detail::expr_t<E>>(detail::as_expr(first));
+  }
 
   // Comparisons
 
   template <typename T1, typename T2, size_t Dim>
   bool operator==(const ndarray<T1, Dim>& lhs, const ndarray<T2, Dim>& rhs) {
-    using result_t = std::common_type_t<T1, T2>;
-#ifndef NDEBUG
-    if (!std::equal(lhs.shape().begin(), lhs.shape().end(), rhs.shape().begin())) {
-      throw std::runtime_error("Arrays size is miss matched.");
+    using M = detail::magnitude_t<std::common_type_t<std::remove_const_t<T1>, std::remove_const_t<T2>>>;
+    // |lhs - rhs| < 1e-12 for each element
+    return detail::all_close_impl(
+        lhs, rhs, [](M d2, M) { return d2 < M(1e-24); }, [](const auto&, const auto&) { return false; });
+  }
+
+  /**
+   * Create a view of an array broadcast to a new shape following NumPy rules. Broadcast axes have zero stride, so no
+   * data is copied and all elements along such axes refer to the same memory.
+   *
+   * @param array - source array
+   * @param shape - target shape, trailing axes should be equal to the axes of `array` or `array` should have extent 1
+   * @return broadcast view of `array`
+   */
+  template <typename T, size_t Dim, size_t NewDim>
+  ndarray<T, NewDim> broadcast_to(const ndarray<T, Dim>& array, const std::array<size_t, NewDim>& shape) {
+    return ndarray<T, NewDim>(shape, detail::broadcast_strides(array.shape(), array.strides(), shape), array.offset(),
+                              array.storage(), detail::view_tag);
+  }
+
+  namespace detail {
+    /**
+     * Type of real and imaginary parts of complex type `T`, constness is preserved
+     */
+    template <typename T>
+    using component_t = std::conditional_t<std::is_const_v<T>, const typename std::remove_const_t<T>::value_type,
+                                           typename std::remove_const_t<T>::value_type>;
+
+    template <typename T, size_t Dim>
+    ndarray<component_t<T>, Dim> component_view(const ndarray<T, Dim>& array, size_t part) {
+      static_assert(is_complex_v<std::remove_const_t<T>>, "Array should be complex");
+      std::array<size_t, Dim> strides;
+      for (size_t i = 0; i < Dim; ++i) strides[i] = 2 * array.strides()[i];
+      return ndarray<component_t<T>, Dim>(array.shape(), strides, 2 * array.offset() + part, array.storage(), view_tag);
     }
-#endif
-    return std::equal(lhs.begin(), lhs.end(), rhs.begin(),
-                      [](T1 l, T2 r) { return std::abs(result_t(l) - result_t(r)) < 1e-12; });
+  }  // namespace detail
+
+  /**
+   * Real part of a complex array as a view with doubled strides, writes through the view modify `array`. No data is copied.
+   * Arbitrary strides are supported.
+   *
+   * @param array - complex array
+   * @return real view that shares memory with `array`
+   */
+  template <typename T, size_t Dim>
+  ndarray<detail::component_t<T>, Dim> real(const ndarray<T, Dim>& array) {
+    return detail::component_view(array, 0);
   }
 
+  /**
+   * Imaginary part of a complex array as a view, see `real`
+   */
   template <typename T, size_t Dim>
-  ndarray<T, Dim> transpose(const ndarray<T, Dim>& array, const std::string& string_pattern) {
-    size_t find = string_pattern.find("->");
-    if (find == std::string::npos) {
-      throw std::runtime_error("Incorrect transpose_impl pattern.");
-    }
-    std::string from = trim(string_pattern.substr(0, find));
-    std::string to   = trim(string_pattern.substr(find + 2, string_pattern.size() - 1));
+  ndarray<detail::component_t<T>, Dim> imag(const ndarray<T, Dim>& array) {
+    return detail::component_view(array, 1);
+  }
 
-    if (from.length() != to.length()) {
-      throw std::runtime_error("Transpose source and target indices have different size.");
-    }
-    if (from.length() != array.dim()) {
-      throw std::runtime_error("Number of transpose_impl indices and array dimension are different size.");
-    }
-    if ((!all_latin(from)) || (!all_latin(to))) {
-      throw std::runtime_error("Transpose indices should be latin letters.");
+  /**
+   * View a complex array as a real array with a trailing axis of extent 2 that holds real and imaginary parts (same as
+   * `numpy.view_as_real`). Arbitrary strides are supported.
+   *
+   * @param array - complex array
+   * @return real view of dimension `Dim + 1` that shares memory with `array`
+   */
+  template <typename T, size_t Dim>
+  ndarray<detail::component_t<T>, Dim + 1> view_as_real(const ndarray<T, Dim>& array) {
+    static_assert(is_complex_v<std::remove_const_t<T>>, "Array should be complex");
+    std::array<size_t, Dim + 1> shape;
+    std::array<size_t, Dim + 1> strides;
+    for (size_t i = 0; i < Dim; ++i) {
+      shape[i]   = array.shape()[i];
+      strides[i] = 2 * array.strides()[i];
     }
+    shape[Dim]   = 2;
+    strides[Dim] = 1;
+    return ndarray<detail::component_t<T>, Dim + 1>(shape, strides, 2 * array.offset(), array.storage(),
+                                                    detail::view_tag);
+  }
 
-#ifndef NDEBUG
-    for (const auto& s1 : from) {
-      bool in = false;
-      for (const auto& s2 : to) {
-        if (s1 == s2) {
-          in = true;
-          break;
-        }
-      }
-      if (!in) {
-        throw std::runtime_error("Some LHS transpose indices are not found in RHS transpose_impl indices.");
+  /**
+   * View a real array with a trailing axis of extent 2 and unit stride as a complex array, inverse of `view_as_real`.
+   * Remaining strides and the offset of the array should be even.
+   *
+   * @param array - real array
+   * @return complex view of dimension `Dim - 1` that shares memory with `array`
+   */
+  template <typename T, size_t Dim>
+  auto view_as_complex(const ndarray<T, Dim>& array) {
+    static_assert(std::is_floating_point_v<std::remove_const_t<T>>, "Array should be real");
+    static_assert(Dim > 1, "Array should have at least two dimensions");
+    using C = std::conditional_t<std::is_const_v<T>, const std::complex<std::remove_const_t<T>>, std::complex<T>>;
+    if (array.shape()[Dim - 1] != 2 || array.strides()[Dim - 1] != 1) {
+      throw std::runtime_error("Last axis should have extent 2 and unit stride to be viewed as complex.");
+    }
+    std::array<size_t, Dim - 1> shape;
+    std::array<size_t, Dim - 1> strides;
+    for (size_t i = 0; i < Dim - 1; ++i) {
+      if (array.strides()[i] % 2 != 0 && array.shape()[i] > 1) {
+        throw std::runtime_error("Strides of the array are not aligned to the size of the new type.");
       }
+      shape[i]   = array.shape()[i];
+      strides[i] = array.strides()[i] / 2;
     }
-#endif
+    if (array.offset() % 2 != 0) throw std::runtime_error("Offset of the array is not aligned to the size of the new type.");
+    return ndarray<C, Dim - 1>(shape, strides, array.offset() / 2, array.storage(), detail::view_tag);
+  }
 
-    std::map<char, size_t> index_map;
-    for (size_t i = 0; i < to.length(); ++i) {
-      index_map[to[i]] = i;
-    }
-    std::vector<size_t> pattern(to.length());
-    for (size_t j = 0; j < from.length(); ++j) {
-      pattern[j] = index_map[from[j]];
-    }
-    return detail::transpose_impl(array, pattern);
+  /**
+   * Permute axes of an array according to the pattern, e.g. "ijk->kji". Result is a new C-contiguous array.
+   *
+   * @param array - source array
+   * @param string_pattern - transpose pattern
+   * @return new array with permuted axes
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> transpose(const ndarray<T, Dim>& array, const std::string& string_pattern) {
+    return detail::transpose_impl(array, detail::parse_transpose_pattern<Dim>(string_pattern));
+  }
+
+  /**
+   * Lazy version of `transpose`. Result shares memory with the source array and has permuted strides, data is only copied
+   * when contiguous buffer is requested with `copy()` or `make_contiguous()`.
+   *
+   * @param array - source array
+   * @param string_pattern - transpose pattern
+   * @return non-contiguous view of `array` with permuted axes
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> transpose_view(const ndarray<T, Dim>& array, const std::string& string_pattern) {
+    return detail::transpose_view_impl(array, detail::parse_transpose_pattern<Dim>(string_pattern));
+  }
+
+  /**
+   * Permute axes of an array according to a precompiled plan. Result is a new C-contiguous array.
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> transpose(const ndarray<T, Dim>& array, const transpose_plan<Dim>& plan) {
+    return detail::transpose_impl(array, plan.permutation());
+  }
+
+  /**
+   * Lazy version of `transpose` with a precompiled plan
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> transpose_view(const ndarray<T, Dim>& array, const transpose_plan<Dim>& plan) {
+    return detail::transpose_view_impl(array, plan.permutation());
   }
 
 }  // namespace green::ndarray
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_PARALLEL_H
+#define NDARRAY_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#if defined(GREEN_NDARRAY_OPENMP) && defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace green::ndarray {
+
+  /**
+   * Function that executes `n_tasks` independent tasks, each task is identified by its index. Can be used to plug in
+   * an external thread pool. Executor should return only when all tasks are completed.
+   */
+  using parallel_executor = std::function<void(size_t n_tasks, const std::function<void(size_t)>& task)>;
+
+  namespace detail {
+    struct parallel_config {
+      // minimal number of elements for an operation to be executed in parallel
+      static inline size_t            threshold = 1ul << 20;
+      // number of elements processed by a single task
+      static inline size_t            grain     = 1ul << 16;
+      static inline parallel_executor executor;
+    };
+  }  // namespace detail
+
+  /**
+   * Set minimal number of elements for an element-wise operation to be executed in parallel.
+   *
+   * @param elements - number of elements
+   */
+  inline void   set_parallel_threshold(size_t elements) { detail::parallel_config::threshold = elements; }
+  inline size_t parallel_threshold() { return detail::parallel_config::threshold; }
+
+  /**
+   * Set number of elements processed by a single parallel task. Work is always split at multiples of the grain size,
+   * so that partitioning does not depend on the number of threads and results are reproducible.
+   *
+   * @param elements - number of elements
+   */
+  inline void   set_parallel_grain(size_t elements) { detail::parallel_config::grain = std::max(elements, size_t(1)); }
+  inline size_t parallel_grain() { return detail::parallel_config::grain; }
+
+  /**
+   * Set external executor for parallel tasks. Executor takes precedence over OpenMP. Pass empty executor to reset.
+   *
+   * @param executor - executor to be used for parallel operations
+   */
+  inline void   set_parallel_executor(parallel_executor executor) { detail::parallel_config::executor = std::move(executor); }
+
+  namespace detail {
+    /**
+     * Execute `n_tasks` independent tasks with external executor if it is set, with OpenMP if the library is built with
+     * `Use_OpenMP` option, or in the calling thread otherwise.
+     */
+    template <typename F>
+    void run_tasks(size_t n_tasks, F&& task) {
+      if (parallel_config::executor) {
+        parallel_config::executor(n_tasks, task);
+        return;
+      }
+#if defined(GREEN_NDARRAY_OPENMP) && defined(_OPENMP)
+      if (!omp_in_parallel()) {
+#pragma omp parallel for schedule(static)
+        for (long t = 0; t < long(n_tasks); ++t) {
+          task(size_t(t));
+        }
+        return;
+      }
+#endif
+      for (size_t t = 0; t < n_tasks; ++t) {
+        task(t);
+      }
+    }
+
+    /**
+     * Split [0, n) range into chunks of deterministic size and execute `f(begin, end)` for each chunk. Work is executed
+     * in the calling thread if total number of elements is below the parallel threshold. Otherwise external executor
+     * is used if it is set, or OpenMP if the library is built with `Use_OpenMP` option.
+     *
+     * @param n - number of items
+     * @param item_size - number of elements in a single item
+     * @param f - function to be called for each chunk of items
+     */
+    template <typename F>
+    void parallel_for(size_t n, size_t item_size, F&& f) {
+      item_size = std::max(item_size, size_t(1));
+      if (n < 2 || n * item_size < parallel_config::threshold) {
+        f(size_t(0), n);
+        return;
+      }
+      const size_t chunk   = std::max(parallel_config::grain / item_size, size_t(1));
+      const size_t n_tasks = (n + chunk - 1) / chunk;
+      if (n_tasks < 2) {
+        f(size_t(0), n);
+        return;
+      }
+      run_tasks(n_tasks, [&](size_t t) { f(t * chunk, std::min(n, (t + 1) * chunk)); });
+    }
+
+    /**
+     * Reduce [0, n) range: `f(begin, end)` computes partial result of a chunk and partial results are combined in a fixed
+     * pairwise order. Chunks are the same as in `parallel_for`, so the result does not depend on the number of threads.
+     *
+     * @param n - number of items
+     * @param item_size - number of elements in a single item
+     * @param f - function that reduces a chunk of items
+     * @param combine - function that combines two partial results
+     * @return reduced value
+     */
+    template <typename R, typename F, typename C>
+    R parallel_reduce(size_t n, size_t item_size, F&& f, C&& combine) {
+      item_size = std::max(item_size, size_t(1));
+      if (n < 2 || n * item_size < parallel_config::threshold) {
+        return f(size_t(0), n);
+      }
+      const size_t chunk   = std::max(parallel_config::grain / item_size, size_t(1));
+      const size_t n_tasks = (n + chunk - 1) / chunk;
+      if (n_tasks < 2) {
+        return f(size_t(0), n);
+      }
+      std::vector<R> partial(n_tasks);
+      run_tasks(n_tasks, [&](size_t t) { partial[t] = f(t * chunk, std::min(n, (t + 1) * chunk)); });
+      for (size_t width = 1; width < n_tasks; width *= 2) {
+        for (size_t i = 0; i + width < n_tasks; i += 2 * width) {
+          partial[i] = combine(partial[i], partial[i + width]);
+        }
+      }
+      return partial[0];
+    }
+  }  // namespace detail
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_PARALLEL_H
@@ -0,0 +1,661 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_REDUCTIONS_H
+#define NDARRAY_REDUCTIONS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "instrumentation.h"
+#include "ndarray.h"
+#include "parallel.h"
+#include "transpose_engine.h"
+
+namespace green::ndarray {
+
+  /**
+   * Summation algorithm used by reductions.
+   *  - naive: a single running sum, error grows linearly with the number of elements;
+   *  - pairwise: blocks of elements are summed with independent accumulators (vectorized) and blocks are combined in a
+   *    binary tree, error grows logarithmically;
+   *  - kahan: compensated summation, error does not depend on the number of elements, about 4x slower.
+   * Work is split into chunks of fixed size independent of the number of threads, so results are reproducible.
+   */
+  enum class summation { naive, pairwise, kahan };
+
+  namespace detail {
+    template <typename T>
+    struct real_type {
+      using type = T;
+    };
+    template <typename T>
+    struct real_type<std::complex<T>> {
+      using type = T;
+    };
+    template <typename T>
+    using real_t = typename real_type<std::remove_const_t<T>>::type;
+
+    // number of independent accumulators in vectorized kernels
+    inline constexpr size_t reduction_lanes = 8;
+    // size of a block that is summed directly by the pairwise algorithm
+    inline constexpr size_t pairwise_block  = 128;
+
+    template <typename R, typename F>
+    R naive_sum(size_t begin, size_t end, const F& f) {
+      R sum = R(0);
+      for (size_t i = begin; i < end; ++i) sum += f(i);
+      return sum;
+    }
+
+    template <typename R, typename F>
+    R pairwise_sum(size_t begin, size_t end, const F& f) {
+      const size_t n = end - begin;
+      if (n < reduction_lanes) return naive_sum<R>(begin, end, f);
+      if (n <= pairwise_block) {
+        std::array<R, reduction_lanes> acc;
+        for (size_t k = 0; k < reduction_lanes; ++k) acc[k] = f(begin + k);
+        size_t i = begin + reduction_lanes;
+        for (; i + reduction_lanes <= end; i += reduction_lanes) {
+          for (size_t k = 0; k < reduction_lanes; ++k) acc[k] += f(i + k);
+        }
+        R sum = ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+        for (; i < end; ++i) sum += f(i);
+        return sum;
+      }
+      size_t half = n / 2;
+      half -= half % reduction_lanes;
+      return pairwise_sum<R>(begin, begin + half, f) + pairwise_sum<R>(begin + half, end, f);
+    }
+
+    template <typename R, typename F>
+    R kahan_sum(size_t begin, size_t end, const F& f) {
+      R sum = R(0);
+      R c   = R(0);
+      for (size_t i = begin; i < end; ++i) {
+        R y = f(i) - c;
+        R t = sum + y;
+        c   = (t - sum) - y;
+        sum = t;
+      }
+      return sum;
+    }
+
+    template <typename R, typename F>
+    R sum_range(size_t begin, size_t end, const F& f, summation mode) {
+      switch (mode) {
+        case summation::naive:
+          return naive_sum<R>(begin, end, f);
+        case summation::kahan:
+          return kahan_sum<R>(begin, end, f);
+        default:
+          return pairwise_sum<R>(begin, end, f);
+      }
+    }
+
+    /**
+     * Reduce [begin, end) range with an associative and commutative binary operation using independent accumulators
+     */
+    template <typename R, typename F, typename Op>
+    R fold_range(size_t begin, size_t end, const F& f, const Op& op) {
+      R value = f(begin);
+      if (end - begin >= 2 * reduction_lanes) {
+        std::array<R, reduction_lanes> acc;
+        for (size_t k = 0; k < reduction_lanes; ++k) acc[k] = f(begin + k);
+        size_t i = begin + reduction_lanes;
+        for (; i + reduction_lanes <= end; i += reduction_lanes) {
+          for (size_t k = 0; k < reduction_lanes; ++k) acc[k] = op(acc[k], f(i + k));
+        }
+        value = acc[0];
+        for (size_t k = 1; k < reduction_lanes; ++k) value = op(value, acc[k]);
+        begin = i;
+      }
+      for (size_t i = begin; i < end; ++i) value = op(value, f(i));
+      return value;
+    }
+
+    /**
+     * Call `kernel(f)` with element accessor `f(i)` for a row of `n` elements with stride `s` starting at `p`.
+     * Unit stride is dispatched separately, so that the kernel can be vectorized.
+     */
+    template <typename T, typename Map, typename K>
+    auto with_row(const T* p, size_t s, const Map& map, const K& kernel) {
+      if (s == 1) return kernel([p, &map](size_t i) { return map(p[i]); });
+      return kernel([p, s, &map](size_t i) { return map(p[i * s]); });
+    }
+
+    template <typename T1, typename T2, typename Map, typename K>
+    auto with_row(const T1* p, size_t sp, const T2* q, size_t sq, const Map& map, const K& kernel) {
+      if (sp == 1 && sq == 1) return kernel([p, q, &map](size_t i) { return map(p[i], q[i]); });
+      return kernel([p, sp, q, sq, &map](size_t i) { return map(p[i * sp], q[i * sq]); });
+    }
+
+    /**
+     * Full reduction over the loop structure of one or two arrays. `row(src_offset, dst_offset, n, src_stride, dst_stride)`
+     * reduces a segment of the innermost merged axis, segments are combined with `combine`. A single merged axis is split
+     * into chunks of elements, otherwise chunks of rows are reduced in parallel.
+     */
+    template <typename R, size_t Dim, typename Row, typename C>
+    R reduce_loops(const copy_loops<Dim>& loops, const Row& row, const C& combine) {
+      kernel_scope scope(kernel_kind::reduction);
+      const size_t inner = loops.rank - 1;
+      const size_t n     = loops.extent[inner];
+      const size_t ss    = loops.src[inner];
+      const size_t ds    = loops.dst[inner];
+      if (loops.rank == 1) {
+        return parallel_reduce<R>(
+            n, 1, [&](size_t begin, size_t end) { return row(begin * ss, begin * ds, end - begin, ss, ds); }, combine);
+      }
+      size_t rows = 1;
+      for (size_t i = 0; i < inner; ++i) rows *= loops.extent[i];
+      return parallel_reduce<R>(
+          rows, n,
+          [&](size_t begin, size_t end) {
+            std::array<size_t, Dim> index{};
+            for (size_t k = inner, r = begin; k-- > 0;) {
+              index[k] = r % loops.extent[k];
+              r /= loops.extent[k];
+            }
+            R value{};
+            for (size_t r = begin; r < end; ++r) {
+              size_t so = 0;
+              size_t dof = 0;
+              for (size_t k = 0; k < inner; ++k) {
+                so += index[k] * loops.src[k];
+                dof += index[k] * loops.dst[k];
+              }
+              value = r == begin ? row(so, dof, n, ss, ds) : combine(value, row(so, dof, n, ss, ds));
+              for (size_t k = inner; k-- > 0;) {
+                if (++index[k] < loops.extent[k]) break;
+                index[k] = 0;
+              }
+            }
+            return value;
+          },
+          combine);
+    }
+
+    /**
+     * Reduction along axes of an array. Every element of the result of shape `shape` is obtained by `row(offset)`,
+     * where `offset` is computed from `strides` of the source array.
+     */
+    template <typename R, size_t D, typename Row>
+    ndarray<R, D> reduce_outputs(const std::array<size_t, D>& shape, const std::array<size_t, D>& strides, size_t n,
+                                 const Row& row) {
+      kernel_scope  scope(kernel_kind::reduction);
+      ndarray<R, D> result(shape, uninitialized);
+      R*            out = result.data();
+      parallel_for(result.size(), n, [&](size_t begin, size_t end) {
+        std::array<size_t, D> index{};
+        for (size_t k = D, r = begin; k-- > 0;) {
+          index[k] = r % shape[k];
+          r /= shape[k];
+        }
+        for (size_t i = begin; i < end; ++i) {
+          size_t offset = 0;
+          for (size_t k = 0; k < D; ++k) offset += index[k] * strides[k];
+          out[i] = row(offset);
+          for (size_t k = D; k-- > 0;) {
+            if (++index[k] < shape[k]) break;
+            index[k] = 0;
+          }
+        }
+      });
+      return result;
+    }
+
+    /**
+     * Shape and strides of an array with one axis removed
+     */
+    template <size_t Dim>
+    std::pair<std::array<size_t, Dim - 1>, std::array<size_t, Dim - 1>> remove_axis(const std::array<size_t, Dim>& shape,
+                                                                                   const std::array<size_t, Dim>& strides,
+                                                                                   size_t                         axis) {
+      if (axis >= Dim) throw std::logic_error("Reduction axis is larger than array's dimension.");
+      std::array<size_t, Dim - 1> new_shape;
+      std::array<size_t, Dim - 1> new_strides;
+      for (size_t i = 0, k = 0; i < Dim; ++i) {
+        if (i == axis) continue;
+        new_shape[k]     = shape[i];
+        new_strides[k++] = strides[i];
+      }
+      return {new_shape, new_strides};
+    }
+
+    template <typename T, size_t Dim>
+    void check_not_empty(const ndarray<T, Dim>& array) {
+      if (array.size() == 0) throw std::runtime_error("Reduction of an empty array has no identity.");
+    }
+
+    template <typename T, size_t Dim, typename Map>
+    auto sum_impl(const ndarray<T, Dim>& array, summation mode, const Map& map) {
+      using R   = std::decay_t<decltype(map(std::declval<T>()))>;
+      const T* p = array.data();
+      return reduce_loops<R>(
+          merge_axes(array.shape(), array.strides(), array.strides()),
+          [&](size_t o, size_t, size_t n, size_t s, size_t) {
+            return with_row(p + o, s, map, [&](const auto& f) { return sum_range<R>(0, n, f, mode); });
+          },
+          [](const R& a, const R& b) { return a + b; });
+    }
+
+    template <typename T, size_t Dim, typename Map>
+    auto sum_axis_impl(const ndarray<T, Dim>& array, size_t axis, summation mode, const Map& map) {
+      using R               = std::decay_t<decltype(map(std::declval<T>()))>;
+      auto [shape, strides] = remove_axis(array.shape(), array.strides(), axis);
+      const T*     p        = array.data();
+      const size_t n        = array.shape()[axis];
+      const size_t s        = array.strides()[axis];
+      return reduce_outputs<R>(shape, strides, n, [&](size_t o) {
+        return with_row(p + o, s, map, [&](const auto& f) { return sum_range<R>(0, n, f, mode); });
+      });
+    }
+
+    template <typename T, size_t Dim, typename Op>
+    std::remove_const_t<T> fold_impl(const ndarray<T, Dim>& array, const Op& op) {
+      using R = std::remove_const_t<T>;
+      check_not_empty(array);
+      const T* p   = array.data();
+      auto     map = [](const R& x) { return x; };
+      return reduce_loops<R>(
+          merge_axes(array.shape(), array.strides(), array.strides()),
+          [&](size_t o, size_t, size_t n, size_t s, size_t) {
+            return with_row(p + o, s, map, [&](const auto& f) { return fold_range<R>(0, n, f, op); });
+          },
+          op);
+    }
+
+    template <typename T, size_t Dim, typename Op>
+    ndarray<std::remove_const_t<T>, Dim - 1> fold_axis_impl(const ndarray<T, Dim>& array, size_t axis, const Op& op) {
+      using R               = std::remove_const_t<T>;
+      auto [shape, strides] = remove_axis(array.shape(), array.strides(), axis);
+      if (array.shape()[axis] == 0) throw std::runtime_error("Reduction of an empty array has no identity.");
+      const T*     p   = array.data();
+      const size_t n   = array.shape()[axis];
+      const size_t s   = array.strides()[axis];
+      auto         map = [](const R& x) { return x; };
+      return reduce_outputs<R>(shape, strides, n, [&](size_t o) {
+        return with_row(p + o, s, map, [&](const auto& f) { return fold_range<R>(0, n, f, op); });
+      });
+    }
+
+    struct max_op {
+      template <typename T>
+      T operator()(const T& a, const T& b) const {
+        return a < b ? b : a;
+      }
+    };
+
+    struct min_op {
+      template <typename T>
+      T operator()(const T& a, const T& b) const {
+        return b < a ? b : a;
+      }
+    };
+
+    struct identity_map {
+      template <typename T>
+      std::remove_const_t<T> operator()(const T& x) const {
+        return x;
+      }
+    };
+
+    struct squared_abs_map {
+      template <typename T>
+      real_t<T> operator()(const T& x) const {
+        if constexpr (is_complex_v<std::remove_const_t<T>>) {
+          return x.real() * x.real() + x.imag() * x.imag();
+        } else {
+          return x * x;
+        }
+      }
+    };
+
+    /**
+     * Floating point type used for tolerances and differences of values of type T
+     */
+    template <typename T>
+    using magnitude_t = std::conditional_t<std::is_floating_point_v<real_t<T>>, real_t<T>, double>;
+
+    template <typename M, typename V>
+    M squared_abs(const V& x) {
+      if constexpr (is_complex_v<V>) {
+        return M(x.real()) * M(x.real()) + M(x.imag()) * M(x.imag());
+      } else {
+        return M(x) * M(x);
+      }
+    }
+
+    /**
+     * Magnitude without overflow of intermediate squares
+     */
+    template <typename M, typename V>
+    M magnitude(const V& x) {
+      if constexpr (is_complex_v<V>) {
+        return std::hypot(M(x.real()), M(x.imag()));
+      } else {
+        return std::abs(M(x));
+      }
+    }
+
+    // number of elements that are compared before an early exit is checked
+    inline constexpr size_t comparison_block = 256;
+
+    /**
+     * Check predicate for elements [0, n) of a row. Elements are checked in blocks without branches, so that the check
+     * can be vectorized; `refine(i)` is called for elements of a failed block that need a more precise check.
+     */
+    template <typename F, typename G>
+    bool all_of_row(size_t n, const F& fast, const G& refine) {
+      for (size_t begin = 0; begin < n; begin += comparison_block) {
+        const size_t end = std::min(begin + comparison_block, n);
+        bool         ok  = true;
+        for (size_t i = begin; i < end; ++i) ok &= fast(i);
+        if (ok) continue;
+        for (size_t i = begin; i < end; ++i) {
+          if (!fast(i) && !refine(i)) return false;
+        }
+      }
+      return true;
+    }
+
+    /**
+     * Check that `row(offset_1, offset_2, n, stride_1, stride_2)` holds for all rows of the loop structure of two arrays.
+     * Rows are checked in parallel and all tasks stop as soon as any row fails.
+     */
+    template <size_t Dim, typename Row>
+    bool all_of_loops(const copy_loops<Dim>& loops, const Row& row) {
+      kernel_scope      scope(kernel_kind::reduction);
+      const size_t      inner = loops.rank - 1;
+      const size_t      n     = loops.extent[inner];
+      const size_t      s1    = loops.src[inner];
+      const size_t      s2    = loops.dst[inner];
+      std::atomic<bool> result{true};
+      if (loops.rank == 1) {
+        parallel_for(n, 1, [&](size_t begin, size_t end) {
+          if (!result.load(std::memory_order_relaxed)) return;
+          if (!row(begin * s1, begin * s2, end - begin, s1, s2)) result.store(false, std::memory_order_relaxed);
+        });
+        return result.load();
+      }
+      size_t rows = 1;
+      for (size_t i = 0; i < inner; ++i) rows *= loops.extent[i];
+      parallel_for(rows, n, [&](size_t begin, size_t end) {
+        std::array<size_t, Dim> index{};
+        for (size_t k = inner, r = begin; k-- > 0;) {
+          index[k] = r % loops.extent[k];
+          r /= loops.extent[k];
+        }
+        for (size_t r = begin; r < end; ++r) {
+          if (!result.load(std::memory_order_relaxed)) return;
+          size_t o1 = 0;
+          size_t o2 = 0;
+          for (size_t k = 0; k < inner; ++k) {
+            o1 += index[k] * loops.src[k];
+            o2 += index[k] * loops.dst[k];
+          }
+          if (!row(o1, o2, n, s1, s2)) {
+            result.store(false, std::memory_order_relaxed);
+            return;
+          }
+          for (size_t k = inner; k-- > 0;) {
+            if (++index[k] < loops.extent[k]) break;
+            index[k] = 0;
+          }
+        }
+      });
+      return result.load();
+    }
+
+    /**
+     * Check that for all elements squared magnitude of the difference `d2` and of the reference `r2` satisfy
+     * `fast(d2, r2)` or, if it fails, `refine(d, r)` for the difference and the reference themselves. Squares overflow
+     * for large magnitudes, so `refine` should not rely on them.
+     */
+    template <typename T1, typename T2, size_t Dim, typename F, typename G>
+    bool all_close_impl(const ndarray<T1, Dim>& a, const ndarray<T2, Dim>& b, const F& fast, const G& refine) {
+      using R = std::common_type_t<std::remove_const_t<T1>, std::remove_const_t<T2>>;
+      using M = magnitude_t<R>;
+#ifndef NDEBUG
+      if (a.shape() != b.shape()) {
+        throw std::runtime_error("Arrays size is miss matched.");
+      }
+#endif
+      const T1* p = a.data();
+      const T2* q = b.data();
+      return all_of_loops(merge_axes(a.shape(), a.strides(), b.strides()), [&](size_t o1, size_t o2, size_t n, size_t s1,
+                                                                               size_t s2) {
+        auto check = [&](const auto& x, const auto& y) {
+          return all_of_row(
+              n,
+              [&](size_t i) {
+                R r = R(y(i));
+                return fast(squared_abs<M>(R(x(i)) - r), squared_abs<M>(r));
+              },
+              [&](size_t i) {
+                R r = R(y(i));
+                return refine(R(R(x(i)) - r), r);
+              });
+        };
+        const T1* x = p + o1;
+        const T2* y = q + o2;
+        if (s1 == 1 && s2 == 1) return check([x](size_t i) { return x[i]; }, [y](size_t i) { return y[i]; });
+        return check([x, s1](size_t i) { return x[i * s1]; }, [y, s2](size_t i) { return y[i * s2]; });
+      });
+    }
+  }  // namespace detail
+
+  /**
+   * Sum of all elements of an array
+   *
+   * @param array - source array, arbitrary strides are supported
+   * @param mode - summation algorithm
+   * @return sum of all elements
+   */
+  template <typename T, size_t Dim>
+  std::remove_const_t<T> sum(const ndarray<T, Dim>& array, summation mode = summation::pairwise) {
+    return detail::sum_impl(array, mode, detail::identity_map{});
+  }
+
+  /**
+   * Sum of elements of an array along an axis
+   *
+   * @param array - source array
+   * @param axis - axis to be reduced
+   * @param mode - summation algorithm
+   * @return array of dimension `Dim - 1`
+   */
+  template <typename T, size_t Dim, typename = std::enable_if_t<(Dim > 1)>>
+  ndarray<std::remove_const_t<T>, Dim - 1> sum(const ndarray<T, Dim>& array, size_t axis,
+                                               summation mode = summation::pairwise) {
+    return detail::sum_axis_impl(array, axis, mode, detail::identity_map{});
+  }
+
+  /**
+   * Largest element of a real array. Throws `std::runtime_error` for an empty array.
+   */
+  template <typename T, size_t Dim>
+  std::remove_const_t<T> max(const ndarray<T, Dim>& array) {
+    static_assert(!is_complex_v<std::remove_const_t<T>>, "Complex numbers are not ordered");
+    return detail::fold_impl(array, detail::max_op{});
+  }
+
+  /**
+   * Largest elements of a real array along an axis
+   */
+  template <typename T, size_t Dim, typename = std::enable_if_t<(Dim > 1)>>
+  ndarray<std::remove_const_t<T>, Dim - 1> max(const ndarray<T, Dim>& array, size_t axis) {
+    static_assert(!is_complex_v<std::remove_const_t<T>>, "Complex numbers are not ordered");
+    return detail::fold_axis_impl(array, axis, detail::max_op{});
+  }
+
+  /**
+   * Smallest element of a real array. Throws `std::runtime_error` for an empty array.
+   */
+  template <typename T, size_t Dim>
+  std::remove_const_t<T> min(const ndarray<T, Dim>& array) {
+    static_assert(!is_complex_v<std::remove_const_t<T>>, "Complex numbers are not ordered");
+    return detail::fold_impl(array, detail::min_op{});
+  }
+
+  /**
+   * Smallest elements of a real array along an axis
+   */
+  template <typename T, size_t Dim, typename = std::enable_if_t<(Dim > 1)>>
+  ndarray<std::remove_const_t<T>, Dim - 1> min(const ndarray<T, Dim>& array, size_t axis) {
+    static_assert(!is_complex_v<std::remove_const_t<T>>, "Complex numbers are not ordered");
+    return detail::fold_axis_impl(array, axis, detail::min_op{});
+  }
+
+  /**
+   * Frobenius norm of an array, i.e. square root of the sum of squared magnitudes of all elements
+   */
+  template <typename T, size_t Dim>
+  detail::real_t<T> norm(const ndarray<T, Dim>& array, summation mode = summation::pairwise) {
+    return std::sqrt(detail::sum_impl(array, mode, detail::squared_abs_map{}));
+  }
+
+  /**
+   * Frobenius norm of an array along an axis
+   */
+  template <typename T, size_t Dim, typename = std::enable_if_t<(Dim > 1)>>
+  ndarray<detail::real_t<T>, Dim - 1> norm(const ndarray<T, Dim>& array, size_t axis, summation mode = summation::pairwise) {
+    ndarray<detail::real_t<T>, Dim - 1> result = detail::sum_axis_impl(array, axis, mode, detail::squared_abs_map{});
+    detail::real_t<T>*                  r      = result.data();
+    detail::parallel_for(result.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) r[i] = std::sqrt(r[i]);
+    });
+    return result;
+  }
+
+  /**
+   * Sum of element-wise products of two arrays of the same shape, no complex conjugation is applied
+   *
+   * @param a - first array
+   * @param b - second array
+   * @param mode - summation algorithm
+   * @return sum of a[i] * b[i] in the common value type
+   */
+  template <typename T1, typename T2, size_t Dim>
+  std::common_type_t<std::remove_const_t<T1>, std::remove_const_t<T2>> dot(const ndarray<T1, Dim>& a, const ndarray<T2, Dim>& b,
+                                                                          summation mode = summation::pairwise) {
+    using R = std::common_type_t<std::remove_const_t<T1>, std::remove_const_t<T2>>;
+#ifndef NDEBUG
+    if (a.shape() != b.shape()) {
+      throw std::runtime_error("Arrays size is miss matched.");
+    }
+#endif
+    const T1* p   = a.data();
+    const T2* q   = b.data();
+    auto      map = [](const T1& x, const T2& y) { return R(x) * R(y); };
+    return detail::reduce_loops<R>(
+        detail::merge_axes(a.shape(), a.strides(), b.strides()),
+        [&](size_t o1, size_t o2, size_t n, size_t s1, size_t s2) {
+          return detail::with_row(p + o1, s1, q + o2, s2, map, [&](const auto& f) { return detail::sum_range<R>(0, n, f, mode); });
+        },
+        [](const R& x, const R& y) { return x + y; });
+  }
+
+  /**
+   * Trace over the last two axes of an array. For a matrix the result is a scalar, otherwise it is an array of
+   * dimension `Dim - 2` with traces of all matrices. Matrices do not have to be square, the diagonal is as long as
+   * the shorter side.
+   */
+  template <typename T, size_t Dim>
+  auto trace(const ndarray<T, Dim>& array, summation mode = summation::pairwise) {
+    static_assert(Dim >= 2, "Trace requires at least two dimensions");
+    using R         = std::remove_const_t<T>;
+    const T*     p  = array.data();
+    const size_t n  = std::min(array.shape()[Dim - 2], array.shape()[Dim - 1]);
+    const size_t s  = array.strides()[Dim - 2] + array.strides()[Dim - 1];
+    auto         fn = [&](size_t o) {
+      return detail::with_row(p + o, s, detail::identity_map{}, [&](const auto& f) { return detail::sum_range<R>(0, n, f, mode); });
+    };
+    if constexpr (Dim == 2) {
+      return fn(0);
+    } else {
+      std::array<size_t, Dim - 2> shape;
+      std::array<size_t, Dim - 2> strides;
+      std::copy(array.shape().begin(), array.shape().end() - 2, shape.begin());
+      std::copy(array.strides().begin(), array.strides().end() - 2, strides.begin());
+      return detail::reduce_outputs<R>(shape, strides, n, fn);
+    }
+  }
+
+  /**
+   * Check that two arrays are element-wise equal within a tolerance, i.e. |a - b| <= atol + rtol * |b| for all elements
+   * (same convention as NumPy). Comparison is done on squared magnitudes, so no square roots are evaluated for elements
+   * that are clearly close, and stops as soon as a mismatch is found. Elements whose squares are not finite are compared
+   * on magnitudes. NaN elements are never close.
+   *
+   * @param a - first array
+   * @param b - reference array of the same shape
+   * @param rtol - relative tolerance
+   * @param atol - absolute tolerance
+   * @return true if all elements are close
+   */
+  template <typename T1, typename T2, size_t Dim>
+  bool allclose(const ndarray<T1, Dim>& a, const ndarray<T2, Dim>& b, double rtol = 1e-5, double atol = 1e-8) {
+    using M        = detail::magnitude_t<std::common_type_t<std::remove_const_t<T1>, std::remove_const_t<T2>>>;
+    const M rtol_m = M(rtol);
+    const M atol_m = M(atol);
+    const M rtol2  = rtol_m * rtol_m;
+    const M atol2  = atol_m * atol_m;
+    // (atol + rtol * |b|)^2 >= atol^2 + rtol^2 * |b|^2, so the first check is sufficient as long as the squares are
+    // finite, the second one is exact
+    return detail::all_close_impl(
+        a, b,
+        [rtol2, atol2](M d2, M r2) {
+          M tol2 = atol2 + rtol2 * r2;
+          return d2 <= tol2 && tol2 <= std::numeric_limits<M>::max();
+        },
+        [rtol_m, atol_m](const auto& d, const auto& r) {
+          return detail::magnitude<M>(d) <= atol_m + rtol_m * detail::magnitude<M>(r);
+        });
+  }
+
+  /**
+   * Largest magnitude of the element-wise difference of two arrays of the same shape, 0 for empty arrays. Complex
+   * differences are compared on squared magnitudes, which are recomputed as magnitudes if the largest square overflows.
+   */
+  template <typename T1, typename T2, size_t Dim>
+  auto max_abs_diff(const ndarray<T1, Dim>& a, const ndarray<T2, Dim>& b) {
+    using R = std::common_type_t<std::remove_const_t<T1>, std::remove_const_t<T2>>;
+    using M = detail::magnitude_t<R>;
+#ifndef NDEBUG
+    if (a.shape() != b.shape()) {
+      throw std::runtime_error("Arrays size is miss matched.");
+    }
+#endif
+    const T1* p    = a.data();
+    const T2* q    = b.data();
+    auto      op   = [](M x, M y) { return x < y || std::isnan(y) ? y : x; };
+    auto      fold = [&](const auto& map) {
+      return detail::reduce_loops<M>(
+          detail::merge_axes(a.shape(), a.strides(), b.strides()),
+          [&](size_t o1, size_t o2, size_t n, size_t s1, size_t s2) {
+            if (n == 0) return M(0);
+            return detail::with_row(p + o1, s1, q + o2, s2, map,
+                                    [&](const auto& f) { return detail::fold_range<M>(0, n, f, op); });
+          },
+          op);
+    };
+    auto magnitude = [](const T1& x, const T2& y) { return detail::magnitude<M>(R(R(x) - R(y))); };
+    if constexpr (is_complex_v<R>) {
+      M d2 = fold([](const T1& x, const T2& y) { return detail::squared_abs<M>(R(x) - R(y)); });
+      if (!std::isinf(d2)) return std::sqrt(d2);
+    }
+    return fold(magnitude);
+  }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_REDUCTIONS_H
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_SERIALIZATION_H
+#define NDARRAY_SERIALIZATION_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "mapped_storage.h"
+#include "ndarray.h"
+
+namespace green::ndarray {
+
+  /**
+   * Header of an array stored with `save`. File layout:
+   *
+   *     offset  size  field
+   *          0     8  magic "GNDARRAY"
+   *          8     4  format version
+   *         12     4  0x01020304 in the byte order of the writer
+   *         16     1  kind of elements: 'b' bool, 'i' signed, 'u' unsigned, 'f' floating point, 'c' complex, 'V' other
+   *         17     3  reserved, zero
+   *         20     4  size of an element in bytes
+   *         24     8  dimension of the array
+   *         32     8  position of the data in the file, a multiple of 64
+   *         40  8*Dim shape
+   *
+   * followed by zero padding and the elements in C-order. All fields are stored in the byte order of the writer.
+   */
+  struct binary_header {
+    char                kind;
+    size_t              element_size;
+    std::vector<size_t> shape;
+    size_t              data_offset;
+
+    /**
+     * @return element type in the form kind and size, e.g. 'f8' for double or 'c16' for complex double
+     */
+    std::string         dtype() const { return kind + std::to_string(element_size); }
+  };
+
+  namespace detail {
+    inline constexpr char          binary_magic[8]   = {'G', 'N', 'D', 'A', 'R', 'R', 'A', 'Y'};
+    inline constexpr std::uint32_t binary_version    = 1;
+    inline constexpr std::uint32_t binary_byte_order = 0x01020304;
+    // data of a mapped file is aligned for vector loads of every element type
+    inline constexpr size_t        binary_alignment  = 64;
+
+    /**
+     * Fixed part of the header, followed by the shape
+     */
+    struct binary_prefix {
+      char          magic[8];
+      std::uint32_t version;
+      std::uint32_t byte_order;
+      char          kind;
+      char          reserved[3];
+      std::uint32_t element_size;
+      std::uint64_t dim;
+      std::uint64_t data_offset;
+    };
+    static_assert(sizeof(binary_prefix) == 40, "Binary header layout should not depend on the platform");
+
+    template <typename T>
+    constexpr char binary_kind() {
+      using U = std::remove_cv_t<T>;
+      if constexpr (std::is_same_v<U, bool>) {
+        return 'b';
+      } else if constexpr (is_complex_v<U>) {
+        return 'c';
+      } else if constexpr (std::is_floating_point_v<U>) {
+        return 'f';
+      } else if constexpr (std::is_integral_v<U>) {
+        return std::is_signed_v<U> ? 'i' : 'u';
+      } else {
+        return 'V';
+      }
+    }
+
+    inline size_t binary_data_offset(size_t dim) {
+      size_t header = sizeof(binary_prefix) + dim * sizeof(std::uint64_t);
+      return (header + binary_alignment - 1) / binary_alignment * binary_alignment;
+    }
+
+    /**
+     * Check that the stored array has elements of type `T` and dimension `Dim`
+     */
+    template <typename T, size_t Dim>
+    void check_binary_header(const binary_header& header, const std::string& path) {
+      binary_header expected{binary_kind<T>(), sizeof(T), {}, 0};
+      if (header.kind != expected.kind || header.element_size != expected.element_size) {
+        throw std::runtime_error("File '" + path + "' stores elements of type '" + header.dtype() + "', requested type is '" +
+                                 expected.dtype() + "'.");
+      }
+      if (header.shape.size() != Dim) {
+        throw std::runtime_error("File '" + path + "' stores an array of dimension " + std::to_string(header.shape.size()) +
+                                 ", requested dimension is " + std::to_string(Dim) + ".");
+      }
+    }
+
+    inline binary_header read_binary_header(const file_descriptor& file, const std::string& path) {
+      struct stat st;
+      if (fstat(file.fd, &st) != 0) throw_mapping_error("Can not stat file", path);
+      const size_t  file_size = size_t(st.st_size);
+      binary_prefix prefix;
+      if (file_size < sizeof(prefix)) throw std::runtime_error("File '" + path + "' is not an ndarray file.");
+      read_file_range(file, path, &prefix, sizeof(prefix), 0);
+      if (std::memcmp(prefix.magic, binary_magic, sizeof(binary_magic)) != 0) {
+        throw std::runtime_error("File '" + path + "' is not an ndarray file.");
+      }
+      if (prefix.byte_order != binary_byte_order) {
+        throw std::runtime_error("File '" + path + "' was written with a different byte order.");
+      }
+      if (prefix.version > binary_version) {
+        throw std::runtime_error("File '" + path + "' has unsupported format version " + std::to_string(prefix.version) + ".");
+      }
+      const std::string corrupted = "File '" + path + "' has a corrupted header.";
+      // shape is stored in front of the data
+      if (prefix.dim > (file_size - sizeof(prefix)) / sizeof(std::uint64_t)) throw std::runtime_error(corrupted);
+      if (prefix.data_offset < sizeof(prefix) + prefix.dim * sizeof(std::uint64_t) || prefix.data_offset > file_size) {
+        throw std::runtime_error(corrupted);
+      }
+      std::vector<std::uint64_t> shape(prefix.dim);
+      read_file_range(file, path, shape.data(), shape.size() * sizeof(std::uint64_t), sizeof(prefix));
+      binary_header header{prefix.kind, prefix.element_size, std::vector<size_t>(shape.begin(), shape.end()),
+                           size_t(prefix.data_offset)};
+      // number of elements and their size in bytes should be representable
+      size_t count = 1;
+      size_t bytes;
+      for (size_t extent : header.shape) {
+        if (__builtin_mul_overflow(count, extent, &count)) throw std::runtime_error(corrupted);
+      }
+      if (__builtin_mul_overflow(count, header.element_size, &bytes)) throw std::runtime_error(corrupted);
+      if (file_size - header.data_offset < bytes) throw std::runtime_error("File '" + path + "' is truncated.");
+      return header;
+    }
+  }  // namespace detail
+
+  /**
+   * Read the header of an array stored with `save`, e.g. to find out the shape before loading
+   *
+   * @param path - path to the file
+   * @return type, shape and position of the elements in the file
+   */
+  inline binary_header read_binary_header(const std::string& path) {
+    detail::file_descriptor file{open(path.c_str(), O_RDONLY)};
+    if (file.fd < 0) detail::throw_mapping_error("Can not open file", path);
+    return detail::read_binary_header(file, path);
+  }
+
+  /**
+   * Store an array in a binary file together with its element type and shape (see `binary_header`). Contiguous arrays
+   * are written directly from their memory, other views are gathered in blocks along the leading axis. The array is
+   * written into a uniquely named temporary file next to `path` that replaces `path` at the end, so an existing file
+   * stays intact if saving fails, arrays mapped from it by `load` remain valid and concurrent saves into the same path
+   * (e.g. from several MPI ranks) leave one of the arrays complete.
+   *
+   * @param path - path to the file
+   * @param array - array to be stored
+   */
+  template <typename T, size_t Dim>
+  void save(const std::string& path, const ndarray<T, Dim>& array) {
+    static_assert(std::is_trivially_copyable_v<T>, "Stored elements should be trivially copyable");
+    // unique name in the target directory, so that concurrent saves into the same path do not overwrite each other
+    std::string             temporary = path + ".XXXXXX";
+    detail::file_descriptor file{mkstemp(temporary.data())};
+    if (file.fd < 0) detail::throw_mapping_error("Can not create temporary file", temporary);
+    try {
+      if (fchmod(file.fd, 0644) != 0) detail::throw_mapping_error("Can not set permissions of file", temporary);
+      std::vector<char>     header(detail::binary_data_offset(Dim), 0);
+      detail::binary_prefix prefix{};
+      std::memcpy(prefix.magic, detail::binary_magic, sizeof(detail::binary_magic));
+      prefix.version      = detail::binary_version;
+      prefix.byte_order   = detail::binary_byte_order;
+      prefix.kind         = detail::binary_kind<T>();
+      prefix.element_size = sizeof(T);
+      prefix.dim          = Dim;
+      prefix.data_offset  = header.size();
+      std::memcpy(header.data(), &prefix, sizeof(prefix));
+      for (size_t k = 0; k < Dim; ++k) {
+        std::uint64_t extent = array.shape()[k];
+        std::memcpy(header.data() + sizeof(prefix) + k * sizeof(extent), &extent, sizeof(extent));
+      }
+      detail::write_file_range(file, temporary, header.data(), header.size());
+      if (array.is_contiguous()) {
+        detail::write_file_range(file, temporary, array.data(), array.size() * sizeof(T));
+      } else if (array.size() > 0) {
+        // gathered blocks of about 64 MiB
+        const size_t row   = array.size() / array.shape()[0];
+        const size_t block = std::max((size_t(1) << 26) / (row * sizeof(T)), size_t(1));
+        for (size_t start = 0; start < array.shape()[0]; start += block) {
+          auto chunk = array(range(start, std::min(start + block, array.shape()[0]))).copy();
+          detail::write_file_range(file, temporary, chunk.data(), chunk.size() * sizeof(T));
+        }
+      }
+      if (close(file.fd) != 0) {
+        file.fd = -1;
+        detail::throw_mapping_error("Can not write file", temporary);
+      }
+      file.fd = -1;
+      if (std::rename(temporary.c_str(), path.c_str()) != 0) detail::throw_mapping_error("Can not replace file", path);
+    } catch (...) {
+      std::remove(temporary.c_str());
+      throw;
+    }
+  }
+
+  /**
+   * Read an array stored with `save` into newly allocated memory
+   *
+   * @tparam T - type of the elements, should match the stored type
+   * @tparam Dim - dimension of the array, should match the stored dimension
+   * @param path - path to the file
+   * @return array with the stored elements
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> load(const std::string& path) {
+    static_assert(std::is_trivially_copyable_v<T>, "Loaded elements should be trivially copyable");
+    detail::file_descriptor file{open(path.c_str(), O_RDONLY)};
+    if (file.fd < 0) detail::throw_mapping_error("Can not open file", path);
+    binary_header header = detail::read_binary_header(file, path);
+    detail::check_binary_header<T, Dim>(header, path);
+    std::array<size_t, Dim> shape;
+    std::copy(header.shape.begin(), header.shape.end(), shape.begin());
+    ndarray<std::remove_const_t<T>, Dim> result(shape, uninitialized);
+    detail::read_file_range(file, path, result.data(), result.size() * sizeof(T), header.data_offset);
+    if constexpr (std::is_const_v<T>) {
+      return ndarray<T, Dim>(result.shape(), result.strides(), result.offset(), result.storage());
+    } else {
+      return result;
+    }
+  }
+
+  /**
+   * Map an array stored with `save` into memory without copying (see `map_file`). Pages are read on first access, so
+   * loading takes constant time and the elements are read at the speed of the storage device when they are used.
+   * Read-only mappings require a constant element type.
+   *
+   *     auto g = load<const std::complex<double>, 4>("g.bin", map_options{});
+   *
+   * @tparam T - type of the elements, should match the stored type
+   * @tparam Dim - dimension of the array, should match the stored dimension
+   * @param path - path to the file
+   * @param options - access mode and paging hints of the mapping
+   * @return array that references the mapped file
+   */
+  template <typename T, size_t Dim>
+  ndarray<T, Dim> load(const std::string& path, const map_options& options) {
+    binary_header header = read_binary_header(path);
+    detail::check_binary_header<T, Dim>(header, path);
+    std::array<size_t, Dim> shape;
+    std::copy(header.shape.begin(), header.shape.end(), shape.begin());
+    map_options mapping = options;
+    // a stored array has a fixed size, file is never extended
+    if (mapping.mode == map_mode::create) mapping.mode = map_mode::read_write;
+    return map_file<T, Dim>(path, shape, header.data_offset, mapping);
+  }
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_SERIALIZATION_H
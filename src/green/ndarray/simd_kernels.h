@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_SIMD_KERNELS_H
+#define NDARRAY_SIMD_KERNELS_H
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+
+#if !defined(GREEN_NDARRAY_NO_SIMD) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GREEN_NDARRAY_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace green::ndarray {
+
+  /**
+   * Instruction set used by the complex scaling kernels. Kernels are selected at runtime, so that the library does not
+   * have to be compiled for a particular CPU. Define `GREEN_NDARRAY_NO_SIMD` to always use portable loops.
+   */
+  enum class simd_level { none, avx2, avx512 };
+
+  namespace detail {
+    inline simd_level detect_simd_level() {
+#ifdef GREEN_NDARRAY_X86_DISPATCH
+      // compiler runtime also checks that the operating system saves the wide registers
+      if (__builtin_cpu_supports("avx512f")) return simd_level::avx512;
+      if (__builtin_cpu_supports("avx2")) return simd_level::avx2;
+#endif
+      return simd_level::none;
+    }
+
+    struct simd_config {
+      static inline const simd_level supported = detect_simd_level();
+      static inline simd_level       level     = supported;
+    };
+  }  // namespace detail
+
+  /**
+   * @return most capable instruction set supported by the CPU
+   */
+  inline simd_level supported_simd_level() { return detail::simd_config::supported; }
+
+  /**
+   * Restrict instruction set used by the kernels, e.g. to compare results of different code paths. Levels that are not
+   * supported by the CPU are lowered to the supported one.
+   *
+   * @param level - requested instruction set
+   */
+  inline void       set_simd_level(simd_level level) { detail::simd_config::level = std::min(level, detail::simd_config::supported); }
+  inline simd_level current_simd_level() { return detail::simd_config::level; }
+
+  namespace detail {
+    using complex_d = std::complex<double>;
+
+    /*
+     * Kernels work on contiguous arrays and allow `out == in`. Products are evaluated as (ac - bd, ad + bc) without
+     * fused multiply-add, so that every level gives the same result as `std::complex` for finite values. Non-finite
+     * products are not recovered the way `std::complex` multiplication does (C99 Annex G).
+     */
+
+    inline void scale_complex_portable(complex_d* out, const complex_d* in, size_t n, complex_d s) {
+      const double* x  = reinterpret_cast<const double*>(in);
+      double*       y  = reinterpret_cast<double*>(out);
+      const double  re = s.real(), im = s.imag();
+      for (size_t i = 0; i < n; ++i) {
+        double a = x[2 * i], b = x[2 * i + 1];
+        y[2 * i]     = a * re - b * im;
+        y[2 * i + 1] = a * im + b * re;
+      }
+    }
+
+    inline void scale_real_portable(double* out, const double* in, size_t n, double s) {
+      for (size_t i = 0; i < n; ++i) out[i] = in[i] * s;
+    }
+
+    inline void divide_real_portable(double* out, const double* in, size_t n, double s) {
+      for (size_t i = 0; i < n; ++i) out[i] = in[i] / s;
+    }
+
+    inline void real_to_complex_portable(complex_d* out, const double* in, size_t n, complex_d s) {
+      double*      y  = reinterpret_cast<double*>(out);
+      const double re = s.real(), im = s.imag();
+      for (size_t i = 0; i < n; ++i) {
+        y[2 * i]     = in[i] * re;
+        y[2 * i + 1] = in[i] * im;
+      }
+    }
+
+#ifdef GREEN_NDARRAY_X86_DISPATCH
+    __attribute__((target("avx2"))) inline void scale_complex_avx2(complex_d* out, const complex_d* in, size_t n, complex_d s) {
+      const double* x  = reinterpret_cast<const double*>(in);
+      double*       y  = reinterpret_cast<double*>(out);
+      const __m256d re = _mm256_set1_pd(s.real());
+      const __m256d im = _mm256_set1_pd(s.imag());
+      size_t        i  = 0;
+      for (; i + 2 <= n; i += 2) {
+        __m256d v = _mm256_loadu_pd(x + 2 * i);
+        // (a, b) -> (b, a) within each complex number
+        __m256d w = _mm256_permute_pd(v, 0x5);
+        _mm256_storeu_pd(y + 2 * i, _mm256_addsub_pd(_mm256_mul_pd(v, re), _mm256_mul_pd(w, im)));
+      }
+      scale_complex_portable(out + i, in + i, n - i, s);
+    }
+
+    __attribute__((target("avx2"))) inline void scale_real_avx2(double* out, const double* in, size_t n, double s) {
+      const __m256d f = _mm256_set1_pd(s);
+      size_t        i = 0;
+      for (; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(in + i), f));
+      scale_real_portable(out + i, in + i, n - i, s);
+    }
+
+    __attribute__((target("avx2"))) inline void divide_real_avx2(double* out, const double* in, size_t n, double s) {
+      const __m256d f = _mm256_set1_pd(s);
+      size_t        i = 0;
+      for (; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_loadu_pd(in + i), f));
+      divide_real_portable(out + i, in + i, n - i, s);
+    }
+
+    __attribute__((target("avx2"))) inline void real_to_complex_avx2(complex_d* out, const double* in, size_t n, complex_d s) {
+      double*       y = reinterpret_cast<double*>(out);
+      const __m256d f = _mm256_setr_pd(s.real(), s.imag(), s.real(), s.imag());
+      size_t        i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(in + i);
+        _mm256_storeu_pd(y + 2 * i, _mm256_mul_pd(_mm256_permute4x64_pd(v, 0x50), f));
+        _mm256_storeu_pd(y + 2 * i + 4, _mm256_mul_pd(_mm256_permute4x64_pd(v, 0xFA), f));
+      }
+      real_to_complex_portable(out + i, in + i, n - i, s);
+    }
+
+    __attribute__((target("avx512f"))) inline void scale_complex_avx512(complex_d* out, const complex_d* in, size_t n,
+                                                                        complex_d s) {
+      const double* x  = reinterpret_cast<const double*>(in);
+      double*       y  = reinterpret_cast<double*>(out);
+      const __m512d re = _mm512_set1_pd(s.real());
+      const __m512d im = _mm512_set1_pd(s.imag());
+      size_t        i  = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m512d v  = _mm512_loadu_pd(x + 2 * i);
+        __m512d ar = _mm512_mul_pd(v, re);
+        // masked forms with all lanes selected avoid undefined pass-through registers of the plain intrinsics
+        __m512d bi = _mm512_mul_pd(_mm512_mask_permute_pd(v, 0xFF, v, 0x55), im);
+        // there is no addsub instruction, subtract in the real lanes only
+        _mm512_storeu_pd(y + 2 * i, _mm512_mask_sub_pd(_mm512_add_pd(ar, bi), 0x55, ar, bi));
+      }
+      scale_complex_avx2(out + i, in + i, n - i, s);
+    }
+
+    __attribute__((target("avx512f"))) inline void scale_real_avx512(double* out, const double* in, size_t n, double s) {
+      const __m512d f = _mm512_set1_pd(s);
+      size_t        i = 0;
+      for (; i + 8 <= n; i += 8) _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_loadu_pd(in + i), f));
+      scale_real_portable(out + i, in + i, n - i, s);
+    }
+
+    __attribute__((target("avx512f"))) inline void divide_real_avx512(double* out, const double* in, size_t n, double s) {
+      const __m512d f = _mm512_set1_pd(s);
+      size_t        i = 0;
+      for (; i + 8 <= n; i += 8) _mm512_storeu_pd(out + i, _mm512_div_pd(_mm512_loadu_pd(in + i), f));
+      divide_real_portable(out + i, in + i, n - i, s);
+    }
+
+    __attribute__((target("avx512f"))) inline void real_to_complex_avx512(complex_d* out, const double* in, size_t n,
+                                                                          complex_d s) {
+      double*       y  = reinterpret_cast<double*>(out);
+      const __m512d f  = _mm512_setr_pd(s.real(), s.imag(), s.real(), s.imag(), s.real(), s.imag(), s.real(), s.imag());
+      const __m512i lo = _mm512_setr_epi64(0, 0, 1, 1, 2, 2, 3, 3);
+      const __m512i hi = _mm512_setr_epi64(4, 4, 5, 5, 6, 6, 7, 7);
+      size_t        i  = 0;
+      for (; i + 8 <= n; i += 8) {
+        __m512d v = _mm512_loadu_pd(in + i);
+        _mm512_storeu_pd(y + 2 * i, _mm512_mul_pd(_mm512_mask_permutexvar_pd(v, 0xFF, lo, v), f));
+        _mm512_storeu_pd(y + 2 * i + 8, _mm512_mul_pd(_mm512_mask_permutexvar_pd(v, 0xFF, hi, v), f));
+      }
+      real_to_complex_portable(out + i, in + i, n - i, s);
+    }
+#endif
+
+    /**
+     * out[i] = in[i] * s
+     */
+    inline void scale_complex(complex_d* out, const complex_d* in, size_t n, complex_d s) {
+#ifdef GREEN_NDARRAY_X86_DISPATCH
+      switch (simd_config::level) {
+        case simd_level::avx512:
+          return scale_complex_avx512(out, in, n, s);
+        case simd_level::avx2:
+          return scale_complex_avx2(out, in, n, s);
+        default:
+          break;
+      }
+#endif
+      scale_complex_portable(out, in, n, s);
+    }
+
+    /**
+     * out[i] = in[i] * s for real and imaginary parts of complex arrays, i.e. `n` is the number of doubles
+     */
+    inline void scale_real(double* out, const double* in, size_t n, double s) {
+#ifdef GREEN_NDARRAY_X86_DISPATCH
+      switch (simd_config::level) {
+        case simd_level::avx512:
+          return scale_real_avx512(out, in, n, s);
+        case simd_level::avx2:
+          return scale_real_avx2(out, in, n, s);
+        default:
+          break;
+      }
+#endif
+      scale_real_portable(out, in, n, s);
+    }
+
+    /**
+     * out[i] = in[i] / s, `n` is the number of doubles
+     */
+    inline void divide_real(double* out, const double* in, size_t n, double s) {
+#ifdef GREEN_NDARRAY_X86_DISPATCH
+      switch (simd_config::level) {
+        case simd_level::avx512:
+          return divide_real_avx512(out, in, n, s);
+        case simd_level::avx2:
+          return divide_real_avx2(out, in, n, s);
+        default:
+          break;
+      }
+#endif
+      divide_real_portable(out, in, n, s);
+    }
+
+    /**
+     * out[i] = in[i] * s for a real array `in`
+     */
+    inline void real_to_complex(complex_d* out, const double* in, size_t n, complex_d s) {
+#ifdef GREEN_NDARRAY_X86_DISPATCH
+      switch (simd_config::level) {
+        case simd_level::avx512:
+          return real_to_complex_avx512(out, in, n, s);
+        case simd_level::avx2:
+          return real_to_complex_avx2(out, in, n, s);
+        default:
+          break;
+      }
+#endif
+      real_to_complex_portable(out, in, n, s);
+    }
+  }  // namespace detail
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_SIMD_KERNELS_H
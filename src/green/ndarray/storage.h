@@ -6,39 +6,205 @@
 #ifndef NDARRAY_STORAGE_H
 #define NDARRAY_STORAGE_H
 
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <new>
 #include <stdexcept>
 
+#include "instrumentation.h"
+#include "memory_resource.h"
+
 namespace green::ndarray {
+  /**
+   * Reference counter of a shared memory block. Counter is atomic, so arrays sharing the same memory can be copied and
+   * destroyed concurrently by different threads. Define `GREEN_NDARRAY_SINGLE_THREADED` to use a plain integer instead.
+   */
+#ifdef GREEN_NDARRAY_SINGLE_THREADED
+  using ref_count_t = int;
+#else
+  using ref_count_t = std::atomic<int>;
+#endif
+
+  /**
+   * Control block of a shared memory region. For self-managed memory the control block is placed in the same allocation
+   * right after the data.
+   */
   struct shared_mem_blk {
-    void*  ptr;
-    size_t size;
-    int    count;
+    void*             ptr;
+    size_t            size;
+    ref_count_t       count;
+    // number of references that are views of other arrays, maintained in copy-on-write builds
+    ref_count_t       views;
+    // writers copy shared data before modifying it (see `ndarray::set_copy_on_write`)
+    bool              copy_on_write = false;
+    // policy used to allocate self-managed memory
+    allocation_policy policy;
+    // resource that owns self-managed memory, nullptr if control block is allocated separately
+    memory_resource*  resource;
+
+    constexpr shared_mem_blk(void* p, size_t s, int c, const allocation_policy& pol = {}, memory_resource* res = nullptr) :
+        ptr(p), size(s), count(c), views(0), policy(pol), resource(res) {}
   };
 
+  namespace detail {
+    /**
+     * Increment reference counter. New reference is always obtained from an existing one, so no ordering is required.
+     */
+    inline void add_ref(shared_mem_blk& blk) {
+#ifdef GREEN_NDARRAY_SINGLE_THREADED
+      ++blk.count;
+#else
+      blk.count.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    /**
+     * Decrement reference counter. Release-acquire ordering makes all accesses to the data through other references
+     * visible to the thread that releases the memory.
+     *
+     * @return value of the counter after decrement
+     */
+    inline int remove_ref(shared_mem_blk& blk) {
+#ifdef GREEN_NDARRAY_SINGLE_THREADED
+      return --blk.count;
+#else
+      return blk.count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+#endif
+    }
+
+    /**
+     * @return number of references to the memory block. Acquire ordering makes accesses through the references that
+     * have already been released visible to the caller.
+     */
+    inline int use_count(const shared_mem_blk& blk) {
+#ifdef GREEN_NDARRAY_SINGLE_THREADED
+      return blk.count;
+#else
+      return blk.count.load(std::memory_order_acquire);
+#endif
+    }
+
+    /**
+     * Register a view among the references of the memory block (see `ndarray::set_copy_on_write`)
+     */
+    inline void add_view(shared_mem_blk& blk) {
+#ifdef GREEN_NDARRAY_SINGLE_THREADED
+      ++blk.views;
+#else
+      blk.views.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    inline void remove_view(shared_mem_blk& blk) {
+#ifdef GREEN_NDARRAY_SINGLE_THREADED
+      --blk.views;
+#else
+      blk.views.fetch_sub(1, std::memory_order_release);
+#endif
+    }
+
+    /**
+     * @return number of references to the memory block that are views
+     */
+    inline int view_count(const shared_mem_blk& blk) {
+#ifdef GREEN_NDARRAY_SINGLE_THREADED
+      return blk.views;
+#else
+      return blk.views.load(std::memory_order_acquire);
+#endif
+    }
+
+    /**
+     * Control block shared by all empty storages. Its counter is always zero and is never modified.
+     */
+    inline shared_mem_blk empty_mem_blk{nullptr, 0, 0};
+
+    /**
+     * @return offset of the control block from the beginning of self-managed allocation of `size` bytes
+     */
+    constexpr size_t mem_blk_offset(size_t size) {
+      return (size + alignof(shared_mem_blk) - 1) / alignof(shared_mem_blk) * alignof(shared_mem_blk);
+    }
+
+    /**
+     * @return total number of bytes of self-managed allocation of `size` bytes including control block
+     */
+    constexpr size_t mem_blk_allocation_size(size_t size) { return mem_blk_offset(size) + sizeof(shared_mem_blk); }
+
+    /**
+     * Allocate data together with the control block in a single allocation from the resource
+     */
+    inline shared_mem_blk* allocate_mem_blk(size_t size, const allocation_policy& policy, memory_resource& resource) {
+      char* ptr = static_cast<char*>(resource.allocate(mem_blk_allocation_size(size), policy));
+      count_allocation(size);
+      return new (ptr + mem_blk_offset(size)) shared_mem_blk(ptr, size, 1, policy, &resource);
+    }
+
+    /**
+     * Allocate data from the resource and a separate control block. Used for memory outside of pageable host memory.
+     */
+    inline shared_mem_blk* allocate_separate_mem_blk(size_t size, const allocation_policy& policy, memory_resource& resource) {
+      void* ptr = resource.allocate(size, policy);
+      try {
+        shared_mem_blk* blk = new shared_mem_blk(ptr, size, 1, policy, &resource);
+        count_allocation(size);
+        return blk;
+      } catch (...) {
+        resource.deallocate(ptr, size, policy);
+        throw;
+      }
+    }
+  }  // namespace detail
+
   typedef void (*dealloc_fun)(shared_mem_blk& blk);
 
+  /**
+   * Release self-managed memory. Control block lives in the same allocation as the data.
+   */
   inline void  standard_deallocation(shared_mem_blk& blk) {
-    // if (!blk.count) return;
     assert(blk.count > 0);
-    --blk.count;
-    if (blk.count == 0) {
-      if (blk.ptr) std::free(blk.ptr);
-      blk.ptr = nullptr;
+    assert(blk.resource != nullptr);
+    if (detail::remove_ref(blk) == 0) {
+      void*             ptr      = blk.ptr;
+      size_t            size     = detail::mem_blk_allocation_size(blk.size);
+      allocation_policy policy   = blk.policy;
+      memory_resource*  resource = blk.resource;
+      detail::count_deallocation(blk.size);
+      blk.~shared_mem_blk();
+      resource->deallocate(ptr, size, policy);
+    }
+  }
+
+  /**
+   * Release memory obtained from a resource and its separately allocated control block
+   */
+  inline void resource_deallocation(shared_mem_blk& blk) {
+    assert(blk.count > 0);
+    assert(blk.resource != nullptr);
+    if (detail::remove_ref(blk) == 0) {
+      detail::count_deallocation(blk.size);
+      blk.resource->deallocate(blk.ptr, blk.size, blk.policy);
+      delete &blk;
+    }
+  }
+
+  /**
+   * Release memory obtained with `std::malloc` and its separately allocated control block
+   */
+  inline void free_deallocation(shared_mem_blk& blk) {
+    assert(blk.count > 0);
+    if (detail::remove_ref(blk) == 0) {
+      std::free(blk.ptr);
       delete &blk;
     }
   }
 
   inline void noop_deallocation(shared_mem_blk& blk) {
-    if (!blk.count) return;
-    --blk.count;
-    if (blk.count == 0) {
+    if (&blk == &detail::empty_mem_blk) return;
+    if (detail::remove_ref(blk) == 0) {
       delete &blk;
-      return;
     }
-    if (blk.ptr == nullptr) return;
-    assert(blk.count >= 0);
   }
 
   /**
@@ -49,15 +215,30 @@ namespace green::ndarray {
   class storage_t {
   public:
     /**
-     * Default constructor
+     * Default constructor. Empty storage does not allocate.
+     */
+             storage_t() noexcept : data_(&detail::empty_mem_blk), release_(noop_deallocation) {}
+
+    /**
+     * Create storage and allocate data of `size' bytes from the current memory resource (see `scoped_memory_resource`)
+     * @param size - number of bytes to allocate
+     * @param policy - alignment and huge page policy of the allocation
      */
-             storage_t() : data_(new shared_mem_blk{nullptr, 0, 0}), release_(noop_deallocation) {}
+    explicit storage_t(size_t size, const allocation_policy& policy = default_allocation_policy()) :
+        storage_t(size, policy, *current_memory_resource()) {}
 
     /**
-     * Create storage and allocate data of `size' bytes
+     * Create storage and allocate data of `size' bytes from the memory resource. Resource should outlive the storage.
+     * Control block of host memory shares the allocation with the data, for other memory spaces it is allocated
+     * separately.
      * @param size - number of bytes to allocate
+     * @param policy - alignment and huge page policy of the allocation
+     * @param resource - resource used to allocate and release memory
      */
-    explicit storage_t(size_t size) : data_(new shared_mem_blk{std::malloc(size), size, 1}), release_(standard_deallocation) {}
+    storage_t(size_t size, const allocation_policy& policy, memory_resource& resource) :
+        data_(resource.space() == memory_space::host ? detail::allocate_mem_blk(size, policy, resource)
+                                                     : detail::allocate_separate_mem_blk(size, policy, resource)),
+        release_(resource.space() == memory_space::host ? standard_deallocation : resource_deallocation) {}
     /**
      * Create storage for outside managed data
      *
@@ -70,20 +251,23 @@ namespace green::ndarray {
      * Move constructor
      * @param rhs - object to be moved
      */
-             storage_t(storage_t&& rhs) noexcept : data_(rhs.data_), release_(rhs.release_) { rhs.data_ = nullptr; }
+             storage_t(storage_t&& rhs) noexcept : data_(rhs.data_), release_(rhs.release_) {
+      rhs.data_    = &detail::empty_mem_blk;
+      rhs.release_ = noop_deallocation;
+    }
     /**
      * Copy constructor. New storage will point to the exact same location in memory and reference counter will be incremented.
      *
      * @param rhs - objects to be copied
      */
-             storage_t(const storage_t& rhs) : data_(rhs.data_), release_(rhs.release_) { ++(data_->count); }
+             storage_t(const storage_t& rhs) : data_(rhs.data_), release_(rhs.release_) {
+      if (data_->count) detail::add_ref(*data_);
+    }
 
     /**
      * Destructor will release possesion of the data. For self-managed data memory will be freed if needed.
      */
-    ~        storage_t() {
-      if (release_ && data_) release_(*data_);
-    }
+    ~        storage_t() { release_(*data_); }
 
     /**
      * Copy assignment
@@ -92,10 +276,11 @@ namespace green::ndarray {
      * @return storage that point at the exact same memory as `rhs`
      */
     storage_t& operator=(const storage_t& rhs) {
-      if (release_) release_(*data_);
+      if (this == &rhs) return *this;
+      release_(*data_);
       data_ = rhs.data_;
       if (data_->count) {
-        ++(data_->count);
+        detail::add_ref(*data_);
       }
       release_ = rhs.release_;
       return *this;
@@ -106,12 +291,13 @@ namespace green::ndarray {
      * @param rhs
      * @return storage that point at the exact same memory as `rhs`
      */
-    storage_t& operator=(storage_t&& rhs) {
-      if (release_) release_(*data_);
+    storage_t& operator=(storage_t&& rhs) noexcept {
+      if (this == &rhs) return *this;
+      release_(*data_);
       data_        = rhs.data_;
       release_     = rhs.release_;
-      rhs.data_    = nullptr;
-      rhs.release_ = nullptr;
+      rhs.data_    = &detail::empty_mem_blk;
+      rhs.release_ = noop_deallocation;
       return *this;
     }
 
@@ -135,15 +321,53 @@ namespace green::ndarray {
      * Reset storage to a new data and assign proper memory handling function.
      *
      * @param new_data - pointer to a new memory region.
-     * @param release_fun - function used to release data posession. by default noop function is used.
+     * @param release_fun - function used to release data posession. by default noop function is used. `standard_deallocation`
+     * means that the data was obtained with `std::malloc` and is released with `free_deallocation`.
      * @param size - size of the managed data, 0 by default.
      */
     void reset(void* new_data, dealloc_fun release_fun = noop_deallocation, size_t size = 0) {
       release_(*data_);
-      release_ = release_fun;
+      release_ = release_fun == standard_deallocation ? free_deallocation : release_fun;
       data_    = new shared_mem_blk{new_data, size, 1};
     }
 
+    /**
+     * Release current data and take ownership of an existing control block with a single reference. Used by storage
+     * backends that keep additional state next to the control block, `release_fun` is responsible for destroying it.
+     *
+     * @param blk - control block of the new memory region
+     * @param release_fun - function used to release data possession
+     */
+    void adopt(shared_mem_blk* blk, dealloc_fun release_fun) {
+      assert(blk->count == 1);
+      release_(*data_);
+      release_ = release_fun;
+      data_    = blk;
+    }
+
+    /**
+     * Enable or disable copy-on-write mode for every storage that shares the data. Mode should be selected before the
+     * data is shared with other threads. Empty storage has no data to protect and ignores the call.
+     */
+    void set_copy_on_write(bool enable) {
+      if (data_ != &detail::empty_mem_blk) data_->copy_on_write = enable;
+    }
+
+    /**
+     * Register or unregister a view among the references to the data. Empty storage ignores the calls.
+     */
+    void add_view() {
+      if (data_->count) detail::add_view(*data_);
+    }
+    void remove_view() {
+      if (data_->count) detail::remove_view(*data_);
+    }
+
+    /**
+     * @return memory space of the data, externally managed data is assumed to be in host memory
+     */
+    [[nodiscard]] memory_space space() const { return data_->resource ? data_->resource->space() : memory_space::host; }
+
     // next two functions are made public for test puropse
     [[nodiscard]] const shared_mem_blk& data() const { return *data_; }
     [[nodiscard]] dealloc_fun           release() const { return release_; }
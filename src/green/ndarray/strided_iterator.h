@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_STRIDED_ITERATOR_H
+#define NDARRAY_STRIDED_ITERATOR_H
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#include "transpose_engine.h"
+
+namespace green::ndarray {
+
+  /**
+   * Random access iterator over elements of an array in C-order. Works for arbitrary strides: axes that are contiguous
+   * with each other are merged at construction, so for a C-contiguous array iteration is a simple pointer increment
+   * with a single counter compare. Jumps within the innermost merged axis move the pointer, longer jumps recompute the
+   * position from the linear index.
+   *
+   * @tparam T - type of the elements (const-qualified for constant arrays)
+   * @tparam Dim - dimension of the array
+   */
+  template <typename T, size_t Dim>
+  class strided_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = std::remove_const_t<T>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = T*;
+    using reference         = T&;
+
+    strided_iterator() = default;
+
+    /**
+     * @param ptr - pointer to the first element of the array
+     * @param shape - shape of the array
+     * @param strides - strides of the array
+     * @param pos - linear position of the iterator, 0 for the first element or number of elements for the end
+     */
+    strided_iterator(T* ptr, const std::array<size_t, Dim>& shape, const std::array<size_t, Dim>& strides, size_t pos) :
+        base_(ptr), ptr_(ptr), loops_(detail::merge_axes(shape, strides, strides)) {
+      seek(pos);
+    }
+
+    reference         operator*() const { return *ptr_; }
+    pointer           operator->() const { return ptr_; }
+    reference         operator[](difference_type n) const { return *(*this + n); }
+
+    strided_iterator& operator++() {
+      ++pos_;
+      const size_t inner = loops_.rank - 1;
+      ptr_ += loops_.src[inner];
+      if (++index_[inner] < loops_.extent[inner]) return *this;
+      // carry into the outer axes, the outermost axis is allowed to overflow at the end of the array
+      for (size_t k = inner; k > 0; --k) {
+        ptr_ -= loops_.src[k] * loops_.extent[k];
+        index_[k] = 0;
+        ptr_ += loops_.src[k - 1];
+        if (++index_[k - 1] < loops_.extent[k - 1]) break;
+      }
+      return *this;
+    }
+
+    strided_iterator operator++(int) {
+      strided_iterator tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    strided_iterator& operator--() { return *this -= 1; }
+
+    strided_iterator  operator--(int) {
+      strided_iterator tmp = *this;
+      --(*this);
+      return tmp;
+    }
+
+    strided_iterator& operator+=(difference_type n) {
+      const size_t inner = loops_.rank - 1;
+      const size_t index = index_[inner] + size_t(n);
+      // index wraps around for negative steps that leave the innermost axis
+      if (index < loops_.extent[inner] || (inner == 0 && index <= loops_.extent[inner])) {
+        index_[inner] = index;
+        ptr_ += n * difference_type(loops_.src[inner]);
+        pos_ += size_t(n);
+        return *this;
+      }
+      seek(pos_ + size_t(n));
+      return *this;
+    }
+
+    strided_iterator& operator-=(difference_type n) { return *this += -n; }
+
+    strided_iterator  operator+(difference_type n) const {
+      strided_iterator tmp = *this;
+      return tmp += n;
+    }
+
+    friend strided_iterator operator+(difference_type n, const strided_iterator& it) { return it + n; }
+
+    strided_iterator        operator-(difference_type n) const {
+      strided_iterator tmp = *this;
+      return tmp -= n;
+    }
+
+    difference_type operator-(const strided_iterator& rhs) const { return difference_type(pos_) - difference_type(rhs.pos_); }
+
+    bool            operator==(const strided_iterator& rhs) const { return pos_ == rhs.pos_; }
+    bool            operator!=(const strided_iterator& rhs) const { return pos_ != rhs.pos_; }
+    bool            operator<(const strided_iterator& rhs) const { return pos_ < rhs.pos_; }
+    bool            operator>(const strided_iterator& rhs) const { return pos_ > rhs.pos_; }
+    bool            operator<=(const strided_iterator& rhs) const { return pos_ <= rhs.pos_; }
+    bool            operator>=(const strided_iterator& rhs) const { return pos_ >= rhs.pos_; }
+
+    /**
+     * Conversion into iterator over constant elements
+     */
+    template <typename U = T, typename = std::enable_if_t<!std::is_const_v<U>>>
+    operator strided_iterator<const U, Dim>() const {
+      strided_iterator<const U, Dim> it;
+      it.base_  = base_;
+      it.ptr_   = ptr_;
+      it.loops_ = loops_;
+      it.index_ = index_;
+      it.pos_   = pos_;
+      return it;
+    }
+
+  private:
+    template <typename, size_t>
+    friend class strided_iterator;
+
+    T*                      base_ = nullptr;
+    T*                      ptr_  = nullptr;
+    detail::copy_loops<Dim> loops_{};
+    std::array<size_t, Dim> index_{};
+    size_t                  pos_ = 0;
+
+    /**
+     * Move iterator to a linear position, the outermost axis is allowed to overflow at the end of the array
+     */
+    void                    seek(size_t pos) {
+      pos_ = pos;
+      ptr_ = base_;
+      for (size_t k = loops_.rank; k-- > 1;) {
+        // position of an empty array is always 0, so there is no division by a zero extent
+        index_[k] = pos == 0 ? 0 : pos % loops_.extent[k];
+        pos       = pos == 0 ? 0 : pos / loops_.extent[k];
+        ptr_ += index_[k] * loops_.src[k];
+      }
+      index_[0] = pos;
+      ptr_ += pos * loops_.src[0];
+    }
+  };
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_STRIDED_ITERATOR_H
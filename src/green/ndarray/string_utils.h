@@ -6,29 +6,47 @@
 #ifndef NDARRAY_STRING_UTILS_H
 #define NDARRAY_STRING_UTILS_H
 
-#include <regex>
+#include <cstddef>
 #include <string>
 
 namespace green::ndarray {
 
-  // String trimming from https://stackoverflow.com/a/18465058
+  // constexpr, so that compile-time pattern parsers (see `transpose_plan`) share them with the run-time ones
+  constexpr bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+
+  constexpr bool is_latin(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+  /**
+   * Shrink range [begin, end) of `s` to exclude leading and trailing white space
+   */
+  constexpr void trim_bounds(const char* s, size_t& begin, size_t& end) {
+    while (begin < end && is_space(s[begin])) ++begin;
+    while (end > begin && is_space(s[end - 1])) --end;
+  }
 
   inline std::string ltrim(const std::string& s) {
-    static const std::regex lws{"^[[:space:]]*", std::regex_constants::extended};
-    return std::regex_replace(s, lws, "");
+    size_t begin = 0;
+    while (begin < s.size() && is_space(s[begin])) ++begin;
+    return s.substr(begin);
   }
 
   inline std::string rtrim(const std::string& s) {
-    static const std::regex tws{"[[:space:]]*$", std::regex_constants::extended};
-    return std::regex_replace(s, tws, "");
+    size_t end = s.size();
+    while (end > 0 && is_space(s[end - 1])) --end;
+    return s.substr(0, end);
   }
 
-  inline std::string trim(const std::string& s) { return ltrim(rtrim(s)); }
+  inline std::string trim(const std::string& s) {
+    size_t begin = 0, end = s.size();
+    trim_bounds(s.data(), begin, end);
+    return s.substr(begin, end - begin);
+  }
 
   inline bool        all_latin(const std::string& s) {
-    static const std::regex non_latin("[^a-zA-Z]");
-    std::smatch             m;
-    return !std::regex_search(s, m, non_latin);
+    for (char c : s) {
+      if (!is_latin(c)) return false;
+    }
+    return true;
   }
 
 }  // namespace green::ndarray
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_TRANSPOSE_ENGINE_H
+#define NDARRAY_TRANSPOSE_ENGINE_H
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <type_traits>
+
+#include "instrumentation.h"
+#include "parallel.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace green::ndarray::detail {
+
+  /**
+   * Loop structure of a permuting copy. Axes are ordered as in the destination array, `extent` is the number of elements
+   * along an axis, `src` and `dst` are the strides (in elements) of that axis in the source and destination arrays.
+   */
+  template <size_t Dim>
+  struct copy_loops {
+    size_t                  rank = 0;
+    std::array<size_t, Dim> extent{};
+    std::array<size_t, Dim> src{};
+    std::array<size_t, Dim> dst{};
+  };
+
+  /**
+   * Build loop structure for a permuting copy. Axes of unit extent are dropped and neighbouring axes that are contiguous in
+   * both source and destination are merged into a single axis.
+   *
+   * @param extent - extents of the axes in destination order
+   * @param src - source strides in destination order
+   * @param dst - destination strides
+   * @return merged loop structure
+   */
+  template <size_t Dim>
+  copy_loops<Dim> merge_axes(const std::array<size_t, Dim>& extent, const std::array<size_t, Dim>& src,
+                             const std::array<size_t, Dim>& dst) {
+    copy_loops<Dim> loops;
+    for (size_t i = 0; i < Dim; ++i) {
+      if (extent[i] == 1) continue;
+      size_t r = loops.rank;
+      if (r > 0 && loops.src[r - 1] == src[i] * extent[i] && loops.dst[r - 1] == dst[i] * extent[i]) {
+        loops.extent[r - 1] *= extent[i];
+        loops.src[r - 1] = src[i];
+        loops.dst[r - 1] = dst[i];
+        continue;
+      }
+      loops.extent[r] = extent[i];
+      loops.src[r]    = src[i];
+      loops.dst[r]    = dst[i];
+      ++loops.rank;
+    }
+    if (loops.rank == 0) {
+      loops.rank      = 1;
+      loops.extent[0] = 1;
+      loops.src[0]    = 1;
+      loops.dst[0]    = 1;
+    }
+    return loops;
+  }
+
+  /**
+   * Edge length of a square tile. Source and destination tiles together should fit into L1 cache.
+   */
+  template <typename T>
+  constexpr size_t transpose_tile() {
+    return sizeof(T) <= 8 ? 32 : 16;
+  }
+
+  /**
+   * Generic in-cache block kernel: dst[a * da + b * db] = src[a * sa + b * sb] for a < na, b < nb
+   */
+  template <typename T>
+  inline void transpose_block(const T* src, T* dst, size_t na, size_t nb, size_t sa, size_t sb, size_t da, size_t db) {
+    for (size_t a = 0; a < na; ++a) {
+      for (size_t b = 0; b < nb; ++b) {
+        dst[a * da + b * db] = src[a * sa + b * sb];
+      }
+    }
+  }
+
+#if defined(__AVX__)
+  /**
+   * Block kernel for double precision data with unit stride of `a` in source and unit stride of `b` in destination.
+   * Tile is processed in 4x4 micro-blocks transposed in registers.
+   */
+  inline void transpose_block_unit(const double* src, double* dst, size_t na, size_t nb, size_t sb, size_t da) {
+    size_t a = 0;
+    for (; a + 4 <= na; a += 4) {
+      size_t b = 0;
+      for (; b + 4 <= nb; b += 4) {
+        __m256d r0 = _mm256_loadu_pd(src + a + (b + 0) * sb);
+        __m256d r1 = _mm256_loadu_pd(src + a + (b + 1) * sb);
+        __m256d r2 = _mm256_loadu_pd(src + a + (b + 2) * sb);
+        __m256d r3 = _mm256_loadu_pd(src + a + (b + 3) * sb);
+        __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+        __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+        __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+        __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+        _mm256_storeu_pd(dst + (a + 0) * da + b, _mm256_permute2f128_pd(t0, t2, 0x20));
+        _mm256_storeu_pd(dst + (a + 1) * da + b, _mm256_permute2f128_pd(t1, t3, 0x20));
+        _mm256_storeu_pd(dst + (a + 2) * da + b, _mm256_permute2f128_pd(t0, t2, 0x31));
+        _mm256_storeu_pd(dst + (a + 3) * da + b, _mm256_permute2f128_pd(t1, t3, 0x31));
+      }
+      transpose_block(src + a + b * sb, dst + a * da + b, 4, nb - b, 1, sb, da, 1);
+    }
+    transpose_block(src + a, dst + a * da, na - a, nb, 1, sb, da, 1);
+  }
+
+  /**
+   * Block kernel for double precision complex data with unit stride of `a` in source and unit stride of `b` in destination.
+   * Tile is processed in 2x2 micro-blocks, each complex number occupies one 128-bit lane.
+   */
+  inline void transpose_block_unit(const std::complex<double>* src, std::complex<double>* dst, size_t na, size_t nb, size_t sb,
+                                   size_t da) {
+    const double* s = reinterpret_cast<const double*>(src);
+    double*       d = reinterpret_cast<double*>(dst);
+    size_t        a = 0;
+    for (; a + 2 <= na; a += 2) {
+      size_t b = 0;
+      for (; b + 2 <= nb; b += 2) {
+        __m256d r0 = _mm256_loadu_pd(s + 2 * (a + (b + 0) * sb));
+        __m256d r1 = _mm256_loadu_pd(s + 2 * (a + (b + 1) * sb));
+        _mm256_storeu_pd(d + 2 * ((a + 0) * da + b), _mm256_permute2f128_pd(r0, r1, 0x20));
+        _mm256_storeu_pd(d + 2 * ((a + 1) * da + b), _mm256_permute2f128_pd(r0, r1, 0x31));
+      }
+      transpose_block(src + a + b * sb, dst + a * da + b, 2, nb - b, 1, sb, da, 1);
+    }
+    transpose_block(src + a, dst + a * da, na - a, nb, 1, sb, da, 1);
+  }
+#endif
+
+  template <typename T>
+  inline void transpose_block_unit(const T* src, T* dst, size_t na, size_t nb, size_t sb, size_t da) {
+    transpose_block(src, dst, na, nb, 1, sb, da, 1);
+  }
+
+  /**
+   * Execute permuting copy from `src` into `dst` described by `loops` in the calling thread.
+   *
+   * If the innermost destination axis is also the fastest source axis the copy is done in contiguous runs. Otherwise the
+   * innermost destination axis and the fastest source axis are walked in cache-sized tiles with an in-cache block kernel,
+   * while all the remaining axes are walked by an odometer.
+   *
+   * @param src - pointer to the first source element
+   * @param dst - pointer to the first destination element
+   * @param loops - merged loop structure (see `merge_axes`)
+   */
+  template <typename T, size_t Dim>
+  void permute_copy_serial(const T* src, T* dst, const copy_loops<Dim>& loops) {
+    const size_t r     = loops.rank;
+    const size_t inner = r - 1;
+    // find the axis with the fastest running source index
+    size_t       fast  = inner;
+    for (size_t i = 0; i < inner; ++i) {
+      if (loops.src[i] < loops.src[fast]) fast = i;
+    }
+    // the remaining axes are walked by an odometer
+    std::array<size_t, Dim> outer{};
+    size_t                  n_outer = 0;
+    size_t                  count   = 1;
+    for (size_t i = 0; i < inner; ++i) {
+      if (i == fast) continue;
+      outer[n_outer++] = i;
+      count *= loops.extent[i];
+    }
+    std::array<size_t, Dim> index{};
+    size_t                  src_off = 0;
+    size_t                  dst_off = 0;
+    for (size_t c = 0; c < count; ++c) {
+      const T* s = src + src_off;
+      T*       d = dst + dst_off;
+      if (fast == inner) {
+        const size_t n  = loops.extent[inner];
+        const size_t ss = loops.src[inner];
+        const size_t ds = loops.dst[inner];
+        if (ss == 1 && ds == 1) {
+          std::copy(s, s + n, d);
+        } else {
+          for (size_t i = 0; i < n; ++i) d[i * ds] = s[i * ss];
+        }
+      } else {
+        constexpr size_t tile = transpose_tile<T>();
+        const size_t     na   = loops.extent[fast];
+        const size_t     nb   = loops.extent[inner];
+        const size_t     sa   = loops.src[fast];
+        const size_t     sb   = loops.src[inner];
+        const size_t     da   = loops.dst[fast];
+        const size_t     db   = loops.dst[inner];
+        for (size_t a0 = 0; a0 < na; a0 += tile) {
+          size_t ta = std::min(tile, na - a0);
+          for (size_t b0 = 0; b0 < nb; b0 += tile) {
+            size_t   tb = std::min(tile, nb - b0);
+            const T* st = s + a0 * sa + b0 * sb;
+            T*       dt = d + a0 * da + b0 * db;
+            if (sa == 1 && db == 1) {
+              transpose_block_unit(st, dt, ta, tb, sb, da);
+            } else {
+              transpose_block(st, dt, ta, tb, sa, sb, da, db);
+            }
+          }
+        }
+      }
+      // advance odometer
+      for (size_t k = n_outer; k-- > 0;) {
+        size_t ax = outer[k];
+        src_off += loops.src[ax];
+        dst_off += loops.dst[ax];
+        if (++index[k] < loops.extent[ax]) break;
+        src_off -= loops.src[ax] * loops.extent[ax];
+        dst_off -= loops.dst[ax] * loops.extent[ax];
+        index[k] = 0;
+      }
+    }
+  }
+
+  /**
+   * Execute permuting copy from `src` into `dst` described by `loops`. Large copies are split along the outermost axis
+   * and executed in parallel.
+   *
+   * @param src - pointer to the first source element
+   * @param dst - pointer to the first destination element
+   * @param loops - merged loop structure (see `merge_axes`)
+   */
+  template <typename T, size_t Dim>
+  void permute_copy(const T* src, T* dst, const copy_loops<Dim>& loops) {
+    kernel_scope scope(kernel_kind::copy);
+    const size_t n         = loops.extent[0];
+    size_t       item_size = 1;
+    for (size_t i = 1; i < loops.rank; ++i) item_size *= loops.extent[i];
+    parallel_for(n, item_size, [&](size_t begin, size_t end) {
+      copy_loops<Dim> sub = loops;
+      sub.extent[0]       = end - begin;
+      permute_copy_serial(src + begin * loops.src[0], dst + begin * loops.dst[0], sub);
+    });
+  }
+
+}  // namespace green::ndarray::detail
+
+#endif  // NDARRAY_TRANSPOSE_ENGINE_H
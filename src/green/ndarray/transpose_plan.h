@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#ifndef NDARRAY_TRANSPOSE_PLAN_H
+#define NDARRAY_TRANSPOSE_PLAN_H
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "ndarray.h"
+#include "string_utils.h"
+#include "transpose_engine.h"
+
+namespace green::ndarray {
+
+  template <size_t Dim>
+  class transpose_kernel;
+
+  /**
+   * Parsed transpose pattern of the form "ijk->kji". Plan can be built once, either at compile time from a string
+   * literal or at run time, and applied to any number of arrays of dimension `Dim`:
+   *
+   *     constexpr transpose_plan<3> plan("ijk->kji");
+   *     ndarray<double, 3> t = plan(array);
+   *
+   * @tparam Dim - dimension of the arrays to be transposed
+   */
+  template <size_t Dim>
+  class transpose_plan {
+  public:
+    /**
+     * Parse transpose pattern. Spaces around source and target indices are ignored.
+     *
+     * @param pattern - null-terminated transpose pattern
+     */
+    constexpr explicit transpose_plan(const char* pattern) : permutation_() {
+      size_t length = 0;
+      while (pattern[length] != '\0') ++length;
+      size_t arrow = length;
+      for (size_t i = 0; i + 1 < length; ++i) {
+        if (pattern[i] == '-' && pattern[i + 1] == '>') {
+          arrow = i;
+          break;
+        }
+      }
+      if (arrow == length) {
+        throw std::runtime_error("Incorrect transpose_impl pattern.");
+      }
+      size_t from_begin = 0, from_end = arrow, to_begin = arrow + 2, to_end = length;
+      trim_bounds(pattern, from_begin, from_end);
+      trim_bounds(pattern, to_begin, to_end);
+      if (from_end - from_begin != to_end - to_begin) {
+        throw std::runtime_error("Transpose source and target indices have different size.");
+      }
+      if (from_end - from_begin != Dim) {
+        throw std::runtime_error("Number of transpose_impl indices and array dimension are different size.");
+      }
+      for (size_t i = 0; i < Dim; ++i) {
+        if (!is_latin(pattern[from_begin + i]) || !is_latin(pattern[to_begin + i])) {
+          throw std::runtime_error("Transpose indices should be latin letters.");
+        }
+      }
+      std::array<bool, Dim> used{};
+      for (size_t j = 0; j < Dim; ++j) {
+        size_t i = 0;
+        while (i < Dim && pattern[to_begin + i] != pattern[from_begin + j]) ++i;
+        if (i == Dim) {
+          throw std::runtime_error("Some LHS transpose indices are not found in RHS transpose_impl indices.");
+        }
+        if (used[i]) {
+          throw std::runtime_error("Transpose indices should not be repeated.");
+        }
+        used[i]         = true;
+        permutation_[j] = i;
+      }
+    }
+
+    explicit transpose_plan(const std::string& pattern) : transpose_plan(pattern.c_str()) {}
+
+    /**
+     * @return target position for each of the source axes
+     */
+    constexpr const std::array<size_t, Dim>& permutation() const { return permutation_; }
+
+    /**
+     * @param shape - shape of the source array
+     * @return shape of the transposed array
+     */
+    constexpr std::array<size_t, Dim> shape(const std::array<size_t, Dim>& shape) const { return permute(shape); }
+
+    /**
+     * Create a view of an array with permuted axes. No data is copied.
+     */
+    template <typename T>
+    ndarray<T, Dim> view(const ndarray<T, Dim>& array) const {
+      return ndarray<T, Dim>(permute(array.shape()), permute(array.strides()), array.offset(), array.storage(),
+                             detail::view_tag);
+    }
+
+    /**
+     * Permute array into a new C-ordered array
+     */
+    template <typename T>
+    ndarray<std::remove_const_t<T>, Dim> operator()(const ndarray<T, Dim>& array) const {
+      return view(array).copy();
+    }
+
+    /**
+     * Precompute loop structure for C-contiguous source arrays of a given shape
+     */
+    transpose_kernel<Dim> bind(const std::array<size_t, Dim>& shape) const { return transpose_kernel<Dim>(*this, shape); }
+
+  private:
+    std::array<size_t, Dim> permutation_;
+
+    constexpr std::array<size_t, Dim> permute(const std::array<size_t, Dim>& values) const {
+      std::array<size_t, Dim> result{};
+      for (size_t i = 0; i < Dim; ++i) result[permutation_[i]] = values[i];
+      return result;
+    }
+  };
+
+  /**
+   * Transpose plan bound to a source shape. Merged loop structure is computed once, so repeated transposes of
+   * C-contiguous arrays of the same shape only move the data.
+   *
+   * @tparam Dim - dimension of the arrays to be transposed
+   */
+  template <size_t Dim>
+  class transpose_kernel {
+  public:
+    /**
+     * @param plan - transpose plan
+     * @param shape - shape of the source arrays
+     */
+    transpose_kernel(const transpose_plan<Dim>& plan, const std::array<size_t, Dim>& shape) :
+        source_shape_(shape), target_shape_(plan.shape(shape)) {
+      std::array<size_t, Dim> src_strides;
+      std::array<size_t, Dim> dst_strides;
+      for (size_t k = Dim, s = 1, d = 1; k-- > 0;) {
+        src_strides[k] = s;
+        dst_strides[k] = d;
+        s *= source_shape_[k];
+        d *= target_shape_[k];
+      }
+      std::array<size_t, Dim> src_permuted;
+      for (size_t i = 0; i < Dim; ++i) src_permuted[plan.permutation()[i]] = src_strides[i];
+      size_ = 1;
+      for (size_t k = 0; k < Dim; ++k) size_ *= shape[k];
+      loops_ = detail::merge_axes(target_shape_, src_permuted, dst_strides);
+    }
+
+    /**
+     * @return shape of the source arrays
+     */
+    const std::array<size_t, Dim>& source_shape() const { return source_shape_; }
+    /**
+     * @return shape of the transposed arrays
+     */
+    const std::array<size_t, Dim>& target_shape() const { return target_shape_; }
+
+    /**
+     * Transpose `src` into `dst`. Both arrays should be C-contiguous and have source and target shapes respectively.
+     */
+    template <typename T>
+    void operator()(const ndarray<T, Dim>& src, ndarray<std::remove_const_t<T>, Dim>& dst) const {
+      if (src.shape() != source_shape_ || dst.shape() != target_shape_) {
+        throw std::runtime_error("Arrays shapes do not match transpose kernel.");
+      }
+      if (!src.is_contiguous() || !dst.is_contiguous()) {
+        throw std::logic_error("Operation requires C-contiguous array. Use make_contiguous() to obtain one.");
+      }
+      (*this)(src.data(), dst.data());
+    }
+
+    /**
+     * Transpose a new array from `src`
+     */
+    template <typename T>
+    ndarray<std::remove_const_t<T>, Dim> operator()(const ndarray<T, Dim>& src) const {
+      ndarray<std::remove_const_t<T>, Dim> dst(target_shape_, uninitialized);
+      (*this)(src, dst);
+      return dst;
+    }
+
+    /**
+     * Transpose raw C-ordered buffers
+     */
+    template <typename T>
+    void operator()(const T* src, T* dst) const {
+      if (size_ == 0) return;
+      detail::permute_copy(src, dst, loops_);
+    }
+
+  private:
+    std::array<size_t, Dim> source_shape_;
+    std::array<size_t, Dim> target_shape_;
+    size_t                  size_;
+    detail::copy_loops<Dim> loops_;
+  };
+
+  namespace detail {
+    // maximal number of parsed patterns that are kept per thread and array dimension
+    inline constexpr size_t transpose_plan_cache_size = 256;
+
+    /**
+     * Parsed transpose plan for a string pattern. Plans are memoized per thread, so that repeated transposes with the
+     * same pattern are not parsed again.
+     */
+    template <size_t Dim>
+    const transpose_plan<Dim>& cached_transpose_plan(const std::string& pattern) {
+      thread_local std::unordered_map<std::string, transpose_plan<Dim>> cache;
+      auto                                                               it = cache.find(pattern);
+      if (it != cache.end()) return it->second;
+      transpose_plan<Dim> plan(pattern);
+      if (cache.size() >= transpose_plan_cache_size) cache.clear();
+      return cache.emplace(pattern, plan).first->second;
+    }
+
+    /**
+     * Parse transpose pattern of the form "ijk->kji"
+     *
+     * @tparam Dim - dimension of the array to be transposed
+     * @param string_pattern - transpose pattern
+     * @return target position for each of the source axes
+     */
+    template <size_t Dim>
+    std::array<size_t, Dim> parse_transpose_pattern(const std::string& string_pattern) {
+      return cached_transpose_plan<Dim>(string_pattern).permutation();
+    }
+  }  // namespace detail
+
+}  // namespace green::ndarray
+
+#endif  // NDARRAY_TRANSPOSE_PLAN_H
@@ -7,8 +7,13 @@
 #define NDARRAY_COMMON_H
 
 #include <green/ndarray/ndarray.h>
+#include <unistd.h>
 
+#include <cstdio>
+#include <cstdlib>
 #include <random>
+#include <stdexcept>
+#include <string>
 
 using namespace green;
 
@@ -32,4 +37,21 @@ inline void initialize_array(std::vector<T>& array) {
   std::generate(array.begin(), array.end(), [&dist, &mersenne_engine]() -> T { return T(dist(mersenne_engine)); });
 }
 
+/**
+ * Temporary file that is removed at the end of the scope, also when a test fails
+ */
+struct temporary_file {
+  std::string path;
+  temporary_file() {
+    char name[] = "/tmp/green_ndarray_XXXXXX";
+    int  fd     = mkstemp(name);
+    if (fd < 0) throw std::runtime_error("Can not create temporary file");
+    close(fd);
+    path = name;
+  }
+  temporary_file(const temporary_file&)            = delete;
+  temporary_file& operator=(const temporary_file&) = delete;
+  ~temporary_file() { std::remove(path.c_str()); }
+};
+
 #endif  // NDARRAY_COMMON_H
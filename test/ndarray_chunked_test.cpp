@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/chunked.h>
+#include <green/ndarray/ndarray_math.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <vector>
+
+#include "common.h"
+
+namespace {
+  void write_array(const std::string& path, const ndarray::ndarray<double, 3>& array, size_t header) {
+    std::FILE*        file = std::fopen(path.c_str(), "wb");
+    std::vector<char> head(std::max(header, size_t(1)), 'h');
+    std::fwrite(head.data(), 1, header, file);
+    std::fwrite(array.data(), sizeof(double), array.size(), file);
+    std::fclose(file);
+  }
+}  // namespace
+
+TEST_CASE("NDArrayChunkedTest") {
+  ndarray::ndarray<double, 3> a(11, 4, 5);
+  initialize_array(a);
+
+  SECTION("Chunks") {
+    auto   view = ndarray::chunks(a, 4);
+    REQUIRE(view.size() == 3);
+    size_t start = 0;
+    for (const auto& block : view) {
+      REQUIRE(block.storage().data().ptr == a.storage().data().ptr);
+      REQUIRE(block.shape()[0] == (start < 8 ? 4 : 3));
+      REQUIRE(block == a(ndarray::range(start, start + block.shape()[0])));
+      start += block.shape()[0];
+    }
+    REQUIRE(start == 11);
+    // strided arrays
+    auto strided = a(ndarray::all, ndarray::range(0, 4, 2));
+    start        = 0;
+    for (const auto& block : ndarray::chunks(strided, 5)) {
+      REQUIRE(block(0, 1, 2) == a(start, 2, 2));
+      start += block.shape()[0];
+    }
+    REQUIRE(start == 11);
+    REQUIRE_THROWS_AS(ndarray::chunks(a, 0), std::logic_error);
+  }
+
+  SECTION("MappedChunks") {
+    temporary_file file;
+    write_array(file.path, a, 128);
+    auto   mapped = ndarray::map_file<const double>(file.path, std::array<size_t, 3>{11, 4, 5}, 128);
+    double total  = 0;
+    for (const auto& block : ndarray::chunks(mapped, 2)) total += ndarray::sum(block);
+    REQUIRE(std::abs(total - ndarray::sum(a)) < 1e-12 * std::abs(total));
+  }
+
+  SECTION("FileChunks") {
+    temporary_file     file;
+    const std::string& path = file.path;
+    write_array(path, a, 72);
+    {
+      ndarray::file_chunks<double, 3> stream(path, std::array<size_t, 3>{11, 4, 5}, 3, 72);
+      REQUIRE(stream.size() == 4);
+      size_t             start = 0;
+      std::vector<void*> buffers;
+      for (const auto& block : stream) {
+        REQUIRE(block == a(ndarray::range(start, start + block.shape()[0])));
+        buffers.push_back(block.storage().data().ptr);
+        start += block.shape()[0];
+      }
+      REQUIRE(start == 11);
+      // two buffers are used in turn for the blocks of the same size
+      REQUIRE(buffers[2] == buffers[0]);
+      // blocks that are kept by the caller are not overwritten
+      ndarray::ndarray<double, 3> first = stream.chunk(0);
+      ndarray::ndarray<double, 3> third = stream.chunk(2);
+      for (int repeat = 0; repeat < 2; ++repeat) {
+        for (const auto& block : stream) REQUIRE(block.shape()[0] > 0);
+      }
+      REQUIRE(first == a(ndarray::range(0, 3)));
+      REQUIRE(third == a(ndarray::range(6, 9)));
+    }
+    // empty array
+    ndarray::file_chunks<double, 3> empty(path, std::array<size_t, 3>{0, 4, 5}, 3);
+    REQUIRE(empty.begin() == empty.end());
+    REQUIRE_THROWS_AS((ndarray::file_chunks<double, 3>(path, std::array<size_t, 3>{12, 4, 5}, 3, 72)), std::runtime_error);
+    REQUIRE_THROWS_AS((ndarray::file_chunks<double, 3>(path + ".missing", std::array<size_t, 3>{1, 4, 5}, 3)),
+                      std::runtime_error);
+  }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/device_storage.h>
+#include <green/ndarray/ndarray_math.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "common.h"
+
+namespace {
+  /**
+   * Resource that emulates memory space in host memory. New blocks are filled with garbage.
+   */
+  class emulated_resource : public ndarray::memory_resource {
+  public:
+    explicit emulated_resource(ndarray::memory_space space) : space_(space) {}
+    size_t allocations   = 0;
+    size_t deallocations = 0;
+
+    void*  allocate(size_t size, const ndarray::allocation_policy&) override {
+      ++allocations;
+      void* ptr = std::malloc(std::max(size, size_t(1)));
+      std::memset(ptr, 0xff, size);
+      return ptr;
+    }
+    void deallocate(void* ptr, size_t, const ndarray::allocation_policy&) override {
+      ++deallocations;
+      std::free(ptr);
+    }
+    ndarray::memory_space space() const override { return space_; }
+
+  private:
+    ndarray::memory_space space_;
+  };
+
+  /**
+   * Backend that emulates a device in host memory. Copies are queued and only executed on synchronization.
+   */
+  class emulated_backend : public ndarray::device_backend {
+  public:
+    emulated_resource                  device{ndarray::memory_space::device};
+    emulated_resource                  pinned{ndarray::memory_space::pinned_host};
+    std::vector<std::function<void()>> queue;
+
+    ndarray::memory_resource&          resource(ndarray::memory_space space) override {
+      return space == ndarray::memory_space::device ? static_cast<ndarray::memory_resource&>(device)
+             : space == ndarray::memory_space::pinned_host ? pinned
+                                                           : *ndarray::system_memory_resource();
+    }
+    void copy_async(void* dst, ndarray::memory_space, const void* src, ndarray::memory_space, size_t size,
+                    ndarray::device_stream) override {
+      queue.push_back([=]() { std::memcpy(dst, src, size); });
+    }
+    void synchronize(ndarray::device_stream) override {
+      for (auto& copy : queue) copy();
+      queue.clear();
+    }
+  };
+}  // namespace
+
+TEST_CASE("NDArrayDeviceTest") {
+  SECTION("Transfers") {
+    emulated_backend backend;
+    ndarray::set_device_backend(&backend);
+    {
+      ndarray::ndarray<double, 3> a(4, 5, 6);
+      initialize_array(a);
+      REQUIRE(a.storage().space() == ndarray::memory_space::host);
+      auto d = ndarray::copy_to(a, ndarray::memory_space::device);
+      REQUIRE(d.storage().space() == ndarray::memory_space::device);
+      REQUIRE(d.storage().release() == ndarray::resource_deallocation);
+      REQUIRE(d.shape() == a.shape());
+      REQUIRE(backend.queue.size() == 1);
+      // slices of device arrays are described by the same metadata
+      auto row = d(2);
+      REQUIRE(row.storage().space() == ndarray::memory_space::device);
+      REQUIRE(row.data() == d.data() + 60);
+      auto h = ndarray::copy_to_host(row);
+      REQUIRE(h.storage().space() == ndarray::memory_space::pinned_host);
+      ndarray::synchronize();
+      REQUIRE(h == a(2));
+      // copy into an existing array
+      ndarray::ndarray<double, 2> back(5, 6);
+      ndarray::copy_to(d(3), back);
+      REQUIRE(backend.queue.size() == 1);
+      REQUIRE(back(0, 0) == 0.0);
+      ndarray::synchronize();
+      REQUIRE(back == a(3));
+      // host to host copies do not use the backend
+      ndarray::ndarray<double, 2> host_copy(5, 6);
+      ndarray::copy_to(a(1), host_copy);
+      REQUIRE(backend.queue.empty());
+      REQUIRE(host_copy == a(1));
+      REQUIRE(backend.device.allocations == 1);
+      REQUIRE(backend.pinned.allocations == 1);
+      // device array stays in device memory when resized
+      auto r = ndarray::device_ndarray<double>(std::array<size_t, 2>{3, 3});
+      r.resize(4, 4);
+      REQUIRE(r.storage().space() == ndarray::memory_space::device);
+      REQUIRE(backend.device.allocations == 3);
+      REQUIRE(backend.device.deallocations == 1);
+    }
+    REQUIRE(backend.device.deallocations == backend.device.allocations);
+    REQUIRE(backend.pinned.deallocations == backend.pinned.allocations);
+    ndarray::set_device_backend(nullptr);
+  }
+
+  SECTION("Allocation") {
+    emulated_backend backend;
+    ndarray::set_device_backend(&backend);
+    {
+      auto e = ndarray::device_ndarray<std::complex<double>>(std::array<size_t, 2>{0, 3});
+      REQUIRE(e.size() == 0);
+      auto h = ndarray::device_ndarray<float>(std::array<size_t, 1>{10}, ndarray::memory_space::host);
+      REQUIRE(h.storage().release() == ndarray::standard_deallocation);
+      auto p = ndarray::device_ndarray<float>(std::array<size_t, 1>{10}, ndarray::memory_space::pinned_host);
+      REQUIRE(p.storage().release() == ndarray::resource_deallocation);
+      // pool caches device blocks without touching them
+      ndarray::pool_resource pool(1ul << 20, &backend.device);
+      REQUIRE(pool.space() == ndarray::memory_space::device);
+      for (int i = 0; i < 3; ++i) {
+        ndarray::storage_t st(100, ndarray::default_allocation_policy(), pool);
+        REQUIRE(st.space() == ndarray::memory_space::device);
+      }
+      REQUIRE(pool.statistics().hits == 2);
+      REQUIRE(backend.device.allocations == 2);
+      // small blocks of device memory are not carved from slabs
+      ndarray::small_block_resource small(1024, &backend.device);
+      {
+        ndarray::storage_t st(100, ndarray::default_allocation_policy(), small);
+        REQUIRE(st.space() == ndarray::memory_space::device);
+      }
+      REQUIRE(small.slabs() == 0);
+      REQUIRE(backend.device.allocations == 3);
+      pool.release();
+    }
+    REQUIRE(backend.device.deallocations == backend.device.allocations);
+    ndarray::set_device_backend(nullptr);
+  }
+
+  SECTION("Errors") {
+    emulated_backend backend;
+    ndarray::set_device_backend(&backend);
+    ndarray::ndarray<double, 2> a(4, 6);
+    ndarray::ndarray<double, 2> b(4, 3);
+    REQUIRE_THROWS_AS(ndarray::copy_to(a(ndarray::all, ndarray::range(0, 3)), b), std::logic_error);
+    REQUIRE_THROWS_AS(ndarray::copy_to(a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::copy_to(a(ndarray::all, ndarray::range(0, 6, 2)), ndarray::memory_space::device),
+                      std::logic_error);
+    ndarray::set_device_backend(nullptr);
+#ifndef GREEN_NDARRAY_CUDA
+    REQUIRE_THROWS_AS(ndarray::device_ndarray<double>(std::array<size_t, 1>{10}), std::runtime_error);
+#endif
+  }
+}
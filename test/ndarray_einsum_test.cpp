@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/einsum.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.h"
+
+TEST_CASE("NDArrayEinsumTest") {
+  SECTION("MatrixProducts") {
+    ndarray::ndarray<double, 3> a(3, 4, 5);
+    ndarray::ndarray<double, 2> b(5, 6);
+    initialize_array(a);
+    initialize_array(b);
+    ndarray::ndarray<double, 3> ref(3, 4, 6);
+    for (size_t i = 0; i < 3; ++i) {
+      for (size_t j = 0; j < 4; ++j) {
+        for (size_t l = 0; l < 6; ++l) {
+          for (size_t k = 0; k < 5; ++k) ref(i, j, l) += a(i, j, k) * b(k, l);
+        }
+      }
+    }
+    ndarray::ndarray<double, 3> c = ndarray::einsum<3>("ijk,kl->ijl", a, b);
+    REQUIRE(ndarray::allclose(c, ref, 1e-12));
+    // transposed operands are passed without copies
+    auto at = ndarray::transpose_view(a, "ijk->kij");
+    auto bt = ndarray::transpose_view(b, "kl->lk");
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("kij,kl->ijl", at, b), ref, 1e-12));
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("ijk,lk->ijl", a, bt), ref, 1e-12));
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("kij,lk->ijl", at, bt), ref, 1e-12));
+    // result in the order of the second operand
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("ijk,kl->lij", a, b), transpose(ref, "ijl->lij"), 1e-12));
+    // arbitrary order of the result
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>(" ijk , kl -> jli ", a, b), transpose(ref, "ijl->jli"), 1e-12));
+    // outer product
+    ndarray::ndarray<double, 3> o = ndarray::einsum<3>("ij,k->ijk", b, a(0, 0));
+    REQUIRE(std::abs(o(2, 3, 4) - b(2, 3) * a(0, 0, 4)) < 1e-12);
+    // contraction over several indices
+    ndarray::ndarray<double, 2> d = ndarray::einsum<2>("ijk,ijl->kl", a, a);
+    REQUIRE(std::abs(d(1, 2) - ndarray::dot(a(ndarray::all, ndarray::all, 1), a(ndarray::all, ndarray::all, 2))) < 1e-10);
+  }
+
+  SECTION("BatchedProducts") {
+    ndarray::ndarray<std::complex<double>, 3> a(4, 3, 5);
+    ndarray::ndarray<std::complex<double>, 3> b(4, 5, 2);
+    initialize_array(a);
+    initialize_array(b);
+    a += a * 0.5i;
+    b -= b * 2.0i;
+    ndarray::ndarray<std::complex<double>, 3> ref(4, 3, 2);
+    for (size_t w = 0; w < 4; ++w) {
+      for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+          for (size_t k = 0; k < 5; ++k) ref(w, i, j) += a(w, i, k) * b(w, k, j);
+        }
+      }
+    }
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("wik,wkj->wij", a, b), ref, 1e-12));
+    // batch index is not the outermost axis, operand is copied
+    auto bv = ndarray::transpose_view(b, "wkj->kwj");
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("wik,kwj->wij", a, bv), ref, 1e-12));
+    // result is permuted from a temporary
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("wik,wkj->jwi", a, b), transpose(ref, "wij->jwi"), 1e-12));
+    // mixed value types
+    ndarray::ndarray<double, 3> r(4, 5, 2);
+    initialize_array(r);
+    ndarray::ndarray<std::complex<double>, 3> rc(4, 5, 2);
+    rc << r;
+    REQUIRE(ndarray::allclose(ndarray::einsum<3>("wik,wkj->wij", a, r), ndarray::einsum<3>("wik,wkj->wij", a, rc), 1e-12));
+    // result is written into an existing array, including a strided view of a larger one
+    ndarray::ndarray<std::complex<double>, 3> c(4, 3, 2);
+    ndarray::einsum("wik,wkj->wij", a, b, c);
+    REQUIRE(ndarray::allclose(c, ref, 1e-12));
+    ndarray::ndarray<std::complex<double>, 3> big(4, 3, 5);
+    auto                                      view = big(ndarray::all, ndarray::all, ndarray::range(1, 5, 2));
+    ndarray::einsum("wik,wkj->wij", a, b, view);
+    REQUIRE(ndarray::allclose(view, ref, 1e-12));
+    REQUIRE(big(2, 1, 0) == 0.0);
+    REQUIRE(std::abs(big(3, 2, 3) - ref(3, 2, 1)) < 1e-12 * std::abs(ref(3, 2, 1)));
+  }
+
+  SECTION("Errors") {
+    ndarray::ndarray<double, 2> a(3, 4);
+    ndarray::ndarray<double, 2> b(4, 5);
+    ndarray::ndarray<double, 2> c(3, 4);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("ij,jk>ik", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("ij->ik,jk", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("ijl,jk->ik", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("i1,1k->ik", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("ii,ik->ik", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("ij,lk->ik", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("ij,jk->il", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum<2>("ij,kj->ik", a, b), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::einsum("ij,jk->ik", a, b, c), std::runtime_error);
+  }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/fixed_ndarray.h>
+#include <green/ndarray/ndarray_math.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.h"
+
+namespace {
+  constexpr ndarray::fixed_ndarray<double, 2, 2> pauli_sum() {
+    ndarray::fixed_ndarray<double, 2, 2> x;
+    ndarray::fixed_ndarray<double, 2, 2> z;
+    x(0, 1) = x(1, 0) = 1.0;
+    z(0, 0)           = 1.0;
+    z(1, 1)           = -1.0;
+    return x + 2.0 * z;
+  }
+}  // namespace
+
+TEST_CASE("NDArrayFixedTest") {
+  SECTION("Layout") {
+    using block = ndarray::fixed_ndarray<double, 2, 3, 4>;
+    static_assert(block::size() == 24 && block::dim() == 3);
+    static_assert(block::strides()[0] == 12 && block::strides()[1] == 4 && block::strides()[2] == 1);
+    static_assert(sizeof(block) == 24 * sizeof(double));
+    constexpr auto s = pauli_sum();
+    static_assert(s(0, 0) == 2.0 && s(0, 1) == 1.0 && s(1, 0) == 1.0 && s(1, 1) == -2.0);
+    block b(1.5);
+    b(1, 2, 3) = 4.0;
+    REQUIRE(b.data()[23] == 4.0);
+    REQUIRE(*(b.end() - 2) == 1.5);
+#ifndef NDEBUG
+    REQUIRE_THROWS_AS(b(0, 3, 0), std::logic_error);
+#endif
+  }
+
+  SECTION("Arithmetic") {
+    ndarray::fixed_ndarray<std::complex<double>, 3> v(std::array<std::complex<double>, 3>{1.0, 2.0i, 3.0});
+    ndarray::fixed_ndarray<std::complex<double>, 3> w = v * 2.0 - v;
+    REQUIRE(w == v);
+    w += v;
+    w /= 2.0;
+    REQUIRE(w == v);
+    w *= 1.0i;
+    REQUIRE(w(1) == -2.0);
+    REQUIRE(w != v);
+  }
+
+  SECTION("Interoperability") {
+    ndarray::ndarray<double, 3> a(4, 2, 2);
+    initialize_array(a);
+    ndarray::fixed_ndarray<double, 2, 2> block;
+    // strided view of a dynamic array
+    block << transpose_view(a, "kij->ikj")(ndarray::all, 3);
+    REQUIRE(block(1, 0) == a(3, 1, 0));
+    REQUIRE_THROWS_AS(block << a(ndarray::range(0, 3), 0), std::runtime_error);
+    // views share memory with the fixed array
+    auto view = block.view();
+    view(0, 1) = 7.0;
+    REQUIRE(block(0, 1) == 7.0);
+    const auto& cblock = block;
+    REQUIRE(cblock.view()(0, 1) == 7.0);
+    REQUIRE(ndarray::sum(cblock.view()) == ndarray::sum(block.copy()));
+    ndarray::ndarray<double, 2> slice = a(2);
+    slice << block;
+    REQUIRE(a(2, 0, 1) == 7.0);
+    a(2) += block.view();
+    REQUIRE(a(2, 0, 1) == 14.0);
+  }
+}
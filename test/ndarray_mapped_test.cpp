@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/mapped_storage.h>
+#include <green/ndarray/ndarray_math.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+#include "common.h"
+
+namespace {
+  template <typename T>
+  void write_file(const std::string& path, const std::vector<T>& data, size_t header) {
+    std::FILE*        file = std::fopen(path.c_str(), "wb");
+    std::vector<char> head(header, 'h');
+    if (header > 0) std::fwrite(head.data(), 1, header, file);
+    std::fwrite(data.data(), sizeof(T), data.size(), file);
+    std::fclose(file);
+  }
+}  // namespace
+
+TEST_CASE("NDArrayMappedTest") {
+  SECTION("ReadOnly") {
+    temporary_file                    file;
+    std::vector<std::complex<double>> data(3 * 4 * 500);
+    initialize_array(data);
+    write_file(file.path, data, 4096 + 64);
+    ndarray::ndarray<const std::complex<double>, 3> a;
+    {
+      ndarray::map_options options;
+      options.advice = ndarray::map_advice::sequential;
+      options.populate = true;
+      auto mapped    = ndarray::map_file<const std::complex<double>>(file.path, std::array<size_t, 3>{3, 4, 500}, 4096 + 64,
+                                                                     options);
+      REQUIRE(mapped.offset() == 4);
+      REQUIRE(mapped.storage().release() == ndarray::mmap_deallocation);
+      REQUIRE(mapped(2, 3, 499) == data.back());
+      REQUIRE(mapped(1, 2, 3) == data[1 * 2000 + 2 * 500 + 3]);
+      // mapping stays alive while any view references it
+      a = mapped(ndarray::all, ndarray::range(1, 3));
+      REQUIRE(mapped.storage().data().count == 2);
+    }
+    REQUIRE(a.storage().data().count == 1);
+    REQUIRE(a(0, 1, 7) == data[2 * 500 + 7]);
+    std::complex<double> ref = std::accumulate(data.begin() + 2500, data.begin() + 3500, std::complex<double>(0));
+    REQUIRE(std::abs(ndarray::sum(a(1)) - ref) < 1e-12 * std::abs(ref));
+  }
+
+  SECTION("ReadWrite") {
+    temporary_file      file;
+    std::vector<double> data(100);
+    initialize_array(data);
+    write_file(file.path, data, 0);
+    {
+      ndarray::map_options options;
+      options.mode = ndarray::map_mode::read_write;
+      auto a       = ndarray::map_file<double>(file.path, std::array<size_t, 2>{10, 10}, 0, options);
+      a(3, 4)      = -1.0;
+      options.mode = ndarray::map_mode::copy_on_write;
+      auto b       = ndarray::map_file<double>(file.path, std::array<size_t, 1>{100}, 0, options);
+      REQUIRE(b(34) == -1.0);
+      b(0) = -2.0;
+      REQUIRE(a(0, 0) == data[0]);
+    }
+    auto c = ndarray::map_file<const double>(file.path, std::array<size_t, 1>{100});
+    REQUIRE(c(34) == -1.0);
+    REQUIRE(c(0) == data[0]);
+    // file is extended in create mode
+    ndarray::map_options options;
+    options.mode = ndarray::map_mode::create;
+    auto d       = ndarray::map_file<float>(file.path, std::array<size_t, 1>{1000}, 800, options);
+    d(999)       = 5.0f;
+    REQUIRE(ndarray::map_file<const float>(file.path, std::array<size_t, 1>{1}, 800 + 999 * sizeof(float))(0) == 5.0f);
+  }
+
+  SECTION("Errors") {
+    temporary_file      file;
+    std::vector<double> data(10);
+    write_file(file.path, data, 0);
+    REQUIRE_THROWS_AS(ndarray::map_file<double>(file.path, std::array<size_t, 1>{10}), std::logic_error);
+    REQUIRE_THROWS_AS(ndarray::map_file<const double>(file.path, std::array<size_t, 1>{5}, 4), std::logic_error);
+    REQUIRE_THROWS_AS(ndarray::map_file<const double>(file.path, std::array<size_t, 1>{11}), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::map_file<const double>(file.path + ".missing", std::array<size_t, 1>{1}),
+                      std::runtime_error);
+    REQUIRE(ndarray::map_file<const double>(file.path + ".missing", std::array<size_t, 2>{0, 10}).size() == 0);
+  }
+}
@@ -5,7 +5,10 @@
 
 #include <green/ndarray/ndarray_math.h>
 
+#include <algorithm>
 #include <catch2/catch_test_macros.hpp>
+#include <functional>
+#include <vector>
 
 #include "common.h"
 
@@ -23,7 +26,7 @@ TEST_CASE("NDArrayMathTest") {
     arr1 -= arr2;
     REQUIRE(std::abs(arr1(0, 1, 0, 2) - arr4(0, 1, 0, 2)) < 1e-12);
 #ifndef NDEBUG
-    ndarray::ndarray<double, 4> arr1_1(3, 2, 3, 4);
+    ndarray::ndarray<double, 4> arr1_1(2, 3, 3, 4);
     REQUIRE_THROWS(arr1 + arr1_1);
     REQUIRE_THROWS(arr1 - arr1_1);
 #endif
@@ -193,4 +196,735 @@ TEST_CASE("NDArrayMathTest") {
       }
     }
   }
-}
\ No newline at end of file
+
+  SECTION("TransposePlan") {
+    constexpr ndarray::transpose_plan<3> plan(" ijk ->kij");
+    static_assert(plan.permutation()[0] == 1 && plan.permutation()[1] == 2 && plan.permutation()[2] == 0);
+    static_assert(plan.shape({2, 3, 4})[0] == 4);
+    ndarray::ndarray<double, 3> array(2, 3, 4);
+    initialize_array(array);
+    ndarray::ndarray<double, 3> ref = transpose(array, "ijk->kij");
+    REQUIRE(plan(array) == ref);
+    REQUIRE(transpose(array, plan) == ref);
+    REQUIRE(transpose_view(array, plan).storage().data().ptr == array.storage().data().ptr);
+    REQUIRE(plan.view(array)(3, 1, 2) == array(1, 2, 3));
+    REQUIRE(ndarray::transpose_plan<3>(std::string("ijk->kij")).permutation() == plan.permutation());
+    // kernel bound to a shape reuses its loop structure for any number of arrays
+    auto                        kernel = plan.bind(array.shape());
+    ndarray::ndarray<double, 3> out(4, 2, 3);
+    kernel(array, out);
+    REQUIRE(out == ref);
+    REQUIRE(kernel(array) == ref);
+    REQUIRE(kernel.target_shape() == ref.shape());
+    ndarray::ndarray<double, 3> other(2, 3, 4);
+    other.set_value(1.0);
+    kernel(other, out);
+    REQUIRE(out(3, 1, 2) == 1.0);
+    REQUIRE_THROWS_AS(kernel(ref, out), std::runtime_error);
+    REQUIRE_THROWS_AS(kernel(transpose_view(ref, "kij->ijk"), out), std::logic_error);
+    // errors
+    REQUIRE_THROWS_AS(ndarray::transpose_plan<3>("ijk"), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::transpose_plan<3>("ijk->kii"), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::transpose_plan<3>("iik->kij"), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::transpose_plan<3>("ijk->kim"), std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::transpose_plan<2>("ijk->kij"), std::runtime_error);
+    REQUIRE(ndarray::trim(" \tijk \n") == "ijk");
+    REQUIRE_FALSE(ndarray::all_latin("ij1"));
+    REQUIRE(ndarray::trim("  ") == "");
+    // same helpers are used by the compile-time parser
+    static_assert(ndarray::is_latin('K') && !ndarray::is_latin('1') && ndarray::is_space('\v'));
+  }
+
+  SECTION("TransposeBlocked") {
+    ndarray::ndarray<double, 5> array(3, 37, 2, 41, 5);
+    initialize_array(array);
+    ndarray::ndarray<double, 5> result = transpose(array, "ijklm->lkmji");
+    REQUIRE(result.shape() == std::array<size_t, 5>{41, 2, 5, 37, 3});
+    bool equal = true;
+    for (size_t i = 0; i < 3; ++i) {
+      for (size_t j = 0; j < 37; ++j) {
+        for (size_t k = 0; k < 2; ++k) {
+          for (size_t l = 0; l < 41; ++l) {
+            for (size_t m = 0; m < 5; ++m) {
+              equal &= array(i, j, k, l, m) == result(l, k, m, j, i);
+            }
+          }
+        }
+      }
+    }
+    REQUIRE(equal);
+    ndarray::ndarray<std::complex<double>, 3> zarray(2, 35, 19);
+    initialize_array(zarray);
+    ndarray::ndarray<std::complex<double>, 2> zslice  = zarray(1);
+    ndarray::ndarray<std::complex<double>, 2> zresult = transpose(zslice, "ij->ji");
+    for (size_t i = 0; i < 35; ++i) {
+      for (size_t j = 0; j < 19; ++j) {
+        equal &= zslice(i, j) == zresult(j, i);
+      }
+    }
+    REQUIRE(equal);
+    ndarray::ndarray<double, 3> identity = transpose(array(1, 2), "ijk->ijk");
+    REQUIRE(identity == array(1, 2));
+  }
+
+  SECTION("TransposeView") {
+    ndarray::ndarray<double, 4> array(3, 4, 5, 6);
+    initialize_array(array);
+    ndarray::ndarray<double, 4> view = transpose_view(array, "ijkl->lijk");
+    REQUIRE(view.storage().data().ptr == array.storage().data().ptr);
+    REQUIRE(array.storage().data().count == 2);
+    REQUIRE(view.shape() == std::array<size_t, 4>{6, 3, 4, 5});
+    REQUIRE(view.strides() == std::array<size_t, 4>{1, 120, 30, 6});
+    REQUIRE_FALSE(view.is_contiguous());
+    REQUIRE(array.is_contiguous());
+    for (size_t i = 0; i < 3; ++i) {
+      for (size_t l = 0; l < 6; ++l) {
+        REQUIRE(view(l, i, 2, 3) == array(i, 2, 3, l));
+      }
+    }
+    // slices of a view keep its strides
+    ndarray::ndarray<double, 2> slice = view(4, 1);
+    REQUIRE(slice.strides() == std::array<size_t, 2>{30, 6});
+    REQUIRE(slice(3, 2) == array(1, 3, 2, 4));
+    // materialization
+    ndarray::ndarray<double, 4> copy = view.copy();
+    REQUIRE(copy.is_contiguous());
+    REQUIRE(copy == transpose(array, "ijkl->lijk"));
+    ndarray::ndarray<double, 4> contiguous = view.make_contiguous();
+    REQUIRE(contiguous.storage().data().ptr != array.storage().data().ptr);
+    REQUIRE(contiguous == copy);
+    REQUIRE(array.make_contiguous().storage().data().ptr == array.storage().data().ptr);
+    const ndarray::ndarray<const double, 4> read_only = array;
+    static_assert(std::is_same_v<decltype(read_only.make_contiguous()), ndarray::ndarray<const double, 4>>);
+    static_assert(std::is_same_v<decltype(read_only.copy()), ndarray::ndarray<double, 4>>);
+    ndarray::ndarray<std::complex<double>, 4> zarray(6, 3, 4, 5);
+    zarray << view;
+    REQUIRE(zarray == copy);
+    ndarray::ndarray<double, 4> target(6, 3, 4, 5);
+    target << view;
+    REQUIRE(target == copy);
+    // element-wise operations work on views, reshape requires contiguous arrays
+    view += copy;
+    REQUIRE(view(4, 2, 3, 1) == 2.0 * copy(4, 2, 3, 1));
+    REQUIRE(array(2, 3, 1, 4) == 2.0 * copy(4, 2, 3, 1));
+    REQUIRE_THROWS_AS(view.reshape(6, 60), std::logic_error);
+    // transposed view of a transposed array is back in C-order
+    REQUIRE(transpose_view(view, "lijk->ijkl").is_contiguous());
+  }
+
+  SECTION("Expressions") {
+    ndarray::ndarray<double, 3> a(2, 3, 4);
+    ndarray::ndarray<double, 3> b(2, 3, 4);
+    ndarray::ndarray<double, 3> c(2, 3, 4);
+    initialize_array(a);
+    initialize_array(b);
+    initialize_array(c);
+    c *= 0.3;
+    ndarray::ndarray<double, 3> result = a + 2.0 * b - c;
+    REQUIRE(std::equal(result.begin(), result.end(), a.begin(), [&](const double& r, const double& x) {
+      size_t i = &x - a.data();
+      return std::abs(r - (x + 2.0 * b.data()[i] - c.data()[i])) < 1e-12;
+    }));
+    // expression is evaluated lazily and reads the current values of its operands
+    auto expr = -(a - b) / 4.0 + 1.0;
+    a += 1.0;
+    REQUIRE(std::abs(expr(1, 2, 3) - (-(a(1, 2, 3) - b(1, 2, 3)) / 4.0 + 1.0)) < 1e-12);
+    REQUIRE(expr.shape() == a.shape());
+    // mixed value types follow std::common_type rules
+    ndarray::ndarray<std::complex<double>, 3> z(2, 3, 4);
+    initialize_array(z);
+    auto zexpr = a * 1.0i + z;
+    static_assert(std::is_same_v<decltype(zexpr)::value_type, std::complex<double>>);
+    ndarray::ndarray<std::complex<double>, 3> zresult = zexpr;
+    REQUIRE(std::abs(zresult(0, 1, 2) - (a(0, 1, 2) * 1.0i + z(0, 1, 2))) < 1e-12);
+    // inplace evaluation
+    ndarray::ndarray<double, 3> d = c.copy();
+    d += a - 0.5 * b;
+    REQUIRE(std::abs(d(1, 0, 3) - (c(1, 0, 3) + a(1, 0, 3) - 0.5 * b(1, 0, 3))) < 1e-12);
+    d -= a - 0.5 * b;
+    REQUIRE(d == c);
+    ndarray::ndarray<double, 3> e(2, 3, 4);
+    const double*               e_data = e.data();
+    e << a + b + c;
+    REQUIRE(e.data() == e_data);
+    REQUIRE(std::abs(e(1, 1, 1) - (a(1, 1, 1) + b(1, 1, 1) + c(1, 1, 1))) < 1e-12);
+    // expression keeps temporary operands alive
+    auto tmp = ndarray::ndarray<double, 2>(3, 4) + 2.0;
+    REQUIRE(std::abs(tmp(2, 3) - 2.0) < 1e-12);
+#ifndef NDEBUG
+    ndarray::ndarray<double, 3> f(3, 3, 4);
+    REQUIRE_THROWS(a + 2.0 * f);
+    REQUIRE_THROWS(f += a - b);
+#endif
+  }
+  SECTION("StridedKernels") {
+    ndarray::ndarray<double, 3> a(5, 6, 7);
+    ndarray::ndarray<double, 3> b(5, 6, 7);
+    initialize_array(a);
+    initialize_array(b);
+    b *= 0.5;
+    // unit stride along the last axis
+    auto va = a(ndarray::range(1, 5, 2), ndarray::all, ndarray::range(1, 6));
+    auto vb = b(ndarray::range(0, 4, 2), ndarray::all, ndarray::range(0, 5));
+    // non-unit stride along the last axis
+    auto ta = transpose_view(a, "ijk->kji")(ndarray::range(0, 2), ndarray::all, ndarray::range(0, 5));
+    ndarray::ndarray<double, 3> r1 = va + 2.0 * vb;
+    ndarray::ndarray<double, 3> r2 = ta - va;
+    REQUIRE(r1.shape() == std::array<size_t, 3>{2, 6, 5});
+    for (size_t i = 0; i < 2; ++i) {
+      for (size_t j = 0; j < 6; ++j) {
+        for (size_t k = 0; k < 5; ++k) {
+          REQUIRE(std::abs(r1(i, j, k) - (a(2 * i + 1, j, k + 1) + 2.0 * b(2 * i, j, k))) < 1e-12);
+          REQUIRE(std::abs(r2(i, j, k) - (a(k, j, i) - a(2 * i + 1, j, k + 1))) < 1e-12);
+        }
+      }
+    }
+    // inplace operations and assignment to views modify the parent array
+    ndarray::ndarray<double, 3> c = a.copy();
+    auto                        vc = c(ndarray::all, 2);
+    vc -= c(ndarray::all, 3);
+    REQUIRE(std::abs(c(4, 2, 6) - (a(4, 2, 6) - a(4, 3, 6))) < 1e-12);
+    REQUIRE(c(4, 1, 6) == a(4, 1, 6));
+    vc.set_value(1.5);
+    REQUIRE(c(3, 2, 5) == 1.5);
+    REQUIRE(c(3, 3, 5) == a(3, 3, 5));
+    vc << -vc * 2.0;
+    REQUIRE(c(3, 2, 5) == -3.0);
+    // extent-1 axes do not merge axes around them
+    ndarray::ndarray<double, 3> u(2, 1, 7);
+    ndarray::ndarray<double, 3> w(2, 1, 3);
+    initialize_array(u);
+    initialize_array(w);
+    ndarray::ndarray<double, 3> u0 = u.copy();
+    auto                        vu = u(ndarray::all, ndarray::all, ndarray::range(0, 3));
+    REQUIRE(vu.strides() == std::array<size_t, 3>{7, 7, 1});
+    ndarray::ndarray<double, 3> sum = vu + w;
+    vu.set_value(1.0);
+    for (size_t i = 0; i < 2; ++i) {
+      for (size_t k = 0; k < 7; ++k) {
+        REQUIRE(u(i, 0, k) == (k < 3 ? 1.0 : u0(i, 0, k)));
+        if (k < 3) REQUIRE(sum(i, 0, k) == u0(i, 0, k) + w(i, 0, k));
+      }
+    }
+    auto vt = transpose_view(u, "ijk->kji")(ndarray::range(1, 4), ndarray::all, ndarray::all);
+    vt << -1.0 * vt;
+    REQUIRE(u(1, 0, 3) == -u0(1, 0, 3));
+    REQUIRE(u(1, 0, 4) == u0(1, 0, 4));
+    // conversions and comparison of strided arrays
+    auto z = va.astype<std::complex<double>>();
+    REQUIRE(z.is_contiguous());
+    REQUIRE(z == va);
+    REQUIRE(va == va.copy());
+    REQUIRE_FALSE(va == vb);
+    ndarray::ndarray<std::complex<double>, 3> zt(5, 6, 7);
+    auto                                      zv = transpose_view(zt, "ijk->kji");
+    zv << transpose_view(a, "ijk->kji");
+    REQUIRE(zt == a);
+    // strided iteration follows C-order of the view
+    std::vector<double> values(va.begin(), va.end());
+    REQUIRE(values.size() == va.size());
+    REQUIRE(values[0] == va(0, 0, 0));
+    REQUIRE(values[5] == va(0, 1, 0));
+    REQUIRE(values.back() == va(1, 5, 4));
+    REQUIRE(std::equal(va.begin(), va.end(), va.copy().begin()));
+    for (double& x : ta) x = 0.0;
+    REQUIRE(a(4, 3, 1) == 0.0);
+    REQUIRE(a(4, 3, 2) != 0.0);
+  }
+  SECTION("StridedIterators") {
+    ndarray::ndarray<double, 3> a(5, 6, 7);
+    initialize_array(a);
+    // random access over the merged loops of a strided view
+    auto v = transpose_view(a, "ijk->kji")(ndarray::range(1, 6), ndarray::all, ndarray::range(0, 5, 2));
+    REQUIRE(size_t(v.end() - v.begin()) == v.size());
+    REQUIRE(v.begin()[13] == v(0, 4, 1));
+    REQUIRE(*(v.begin() + 29) == v(1, 3, 2));
+    REQUIRE(*(v.end() - 1) == v(4, 5, 2));
+    REQUIRE(*(--v.end()) == v(4, 5, 2));
+    REQUIRE(*((v.begin() + 40) -= 22) == v(1, 0, 0));
+    REQUIRE(*(3 + v.begin()) == v(0, 1, 0));
+    REQUIRE(v.begin() < v.end());
+    REQUIRE(v.end() - 5 > v.begin() + 7);
+    // sorting an array and a view
+    std::vector<double> values(a.begin(), a.end());
+    std::sort(a.begin(), a.end());
+    REQUIRE(std::is_sorted(a.data(), a.data() + a.size()));
+    std::sort(values.begin(), values.end());
+    REQUIRE(std::equal(values.begin(), values.end(), a.begin()));
+    ndarray::ndarray<double, 3> before = a.copy();
+    std::vector<double>         view_values(v.begin(), v.end());
+    std::sort(v.begin(), v.end(), std::greater<>());
+    REQUIRE(std::is_sorted(v.begin(), v.end(), std::greater<>()));
+    REQUIRE(std::is_permutation(view_values.begin(), view_values.end(), v.begin()));
+    // elements outside of the view are untouched
+    for (size_t j = 0; j < 6; ++j) {
+      for (size_t k = 0; k < 7; ++k) REQUIRE(a(1, j, k) == before(1, j, k));
+      for (size_t i = 0; i < 5; ++i) REQUIRE(a(i, j, 0) == before(i, j, 0));
+    }
+  }
+  SECTION("ComplexKernels") {
+    using complex_t = std::complex<double>;
+    // odd sizes exercise remainders of vector loops
+    ndarray::ndarray<double, 2> re(3, 13);
+    ndarray::ndarray<double, 2> im(3, 13);
+    initialize_array(re);
+    initialize_array(im);
+    im *= -0.3;
+    ndarray::ndarray<complex_t, 2> a = re + 1.0i * im;
+    const complex_t                s(1.25, -0.75);
+    auto close = [](complex_t x, complex_t y) { return std::abs(x - y) <= 1e-14 * std::abs(y); };
+    auto check = [&](const ndarray::ndarray<complex_t, 2>& x, auto ref) {
+      for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 13; ++j) {
+          if (!close(x(i, j), ref(i, j))) return false;
+        }
+      }
+      return true;
+    };
+    const ndarray::simd_level supported = ndarray::supported_simd_level();
+    for (auto level : {ndarray::simd_level::none, ndarray::simd_level::avx2, ndarray::simd_level::avx512}) {
+      ndarray::set_simd_level(level);
+      REQUIRE(ndarray::current_simd_level() == std::min(level, supported));
+      ndarray::ndarray<complex_t, 2> x = a.copy();
+      x *= s;
+      REQUIRE(check(x, [&](size_t i, size_t j) { return a(i, j) * s; }));
+      x /= s;
+      REQUIRE(check(x, [&](size_t i, size_t j) { return a(i, j); }));
+      x *= 2.5;
+      REQUIRE(check(x, [&](size_t i, size_t j) { return a(i, j) * 2.5; }));
+      x /= 3;
+      REQUIRE(check(x, [&](size_t i, size_t j) { return a(i, j) * 2.5 / 3.0; }));
+      ndarray::ndarray<complex_t, 2> y = a * s;
+      REQUIRE(check(y, [&](size_t i, size_t j) { return a(i, j) * s; }));
+      y = s * a;
+      REQUIRE(check(y, [&](size_t i, size_t j) { return s * a(i, j); }));
+      y = a / s;
+      REQUIRE(check(y, [&](size_t i, size_t j) { return a(i, j) / s; }));
+      y = a * 0.5;
+      REQUIRE(check(y, [&](size_t i, size_t j) { return a(i, j) * 0.5; }));
+      // real array scaled by a complex factor
+      y = re * s;
+      REQUIRE(check(y, [&](size_t i, size_t j) { return re(i, j) * s; }));
+      y = s * re;
+      REQUIRE(check(y, [&](size_t i, size_t j) { return s * re(i, j); }));
+      // strided views use generic loops
+      auto v = y(ndarray::all, ndarray::range(1, 12, 2));
+      v *= s;
+      REQUIRE(close(y(2, 3), s * s * re(2, 3)));
+      REQUIRE(close(y(2, 2), s * re(2, 2)));
+    }
+    ndarray::set_simd_level(supported);
+  }
+
+  SECTION("ComplexViews") {
+    using complex_t = std::complex<double>;
+    ndarray::ndarray<double, 3> re(4, 5, 6);
+    ndarray::ndarray<double, 3> im(4, 5, 6);
+    initialize_array(re);
+    initialize_array(im);
+    ndarray::ndarray<complex_t, 3> g = re - 2.0i * im;
+    REQUIRE(ndarray::real(g) == re);
+    REQUIRE(ndarray::imag(g) == ndarray::ndarray<double, 3>(-2.0 * im));
+    // views share memory with the complex array
+    auto gr = ndarray::real(g);
+    gr *= 2.0;
+    ndarray::imag(g).set_value(1.0);
+    REQUIRE(g(3, 2, 1) == complex_t(2.0 * re(3, 2, 1), 1.0));
+    // parts of strided views
+    auto v = g(ndarray::range(1, 4, 2), 2, ndarray::range(0, 6, 3));
+    auto vr = ndarray::real(v);
+    REQUIRE(vr.shape() == std::array<size_t, 2>{2, 2});
+    REQUIRE(vr(1, 1) == g(3, 2, 3).real());
+    REQUIRE(ndarray::imag(v)(0, 1) == 1.0);
+    // trailing axis of real and imaginary parts
+    auto rv = ndarray::view_as_real(v);
+    REQUIRE(rv.shape() == std::array<size_t, 3>{2, 2, 2});
+    REQUIRE(rv(1, 0, 0) == g(3, 2, 0).real());
+    REQUIRE(rv(1, 0, 1) == g(3, 2, 0).imag());
+    auto cv = ndarray::view_as_complex(rv);
+    REQUIRE(cv.data() == v.data());
+    REQUIRE(cv.strides() == v.strides());
+    REQUIRE(cv == v);
+    ndarray::ndarray<const complex_t, 3> cg = g;
+    auto                                 cr = ndarray::real(cg);
+    static_assert(std::is_same_v<decltype(cr), ndarray::ndarray<const double, 3>>);
+    REQUIRE(sum(cr) == sum(ndarray::real(g)));
+    // conversion to real discards imaginary part
+    ndarray::ndarray<double, 3> r(4, 5, 6);
+    r << g;
+    REQUIRE(r == ndarray::real(g));
+    REQUIRE_THROWS_AS(ndarray::view_as_complex(re), std::runtime_error);
+    ndarray::ndarray<double, 2> pairs(3, 4);
+    REQUIRE_THROWS_AS(ndarray::view_as_complex(pairs(ndarray::all, ndarray::range(1, 3))), std::runtime_error);
+  }
+
+  SECTION("Broadcasting") {
+    ndarray::ndarray<double, 4> a(2, 3, 4, 4);
+    ndarray::ndarray<double, 1> shift(4);
+    ndarray::ndarray<double, 2> col(4, 1);
+    initialize_array(a);
+    initialize_array(shift);
+    initialize_array(col);
+    ndarray::ndarray<double, 4> ref = a.copy();
+    // per-orbital shift of the last axis
+    a += shift;
+    for (size_t k = 0; k < 2; ++k) {
+      for (size_t s = 0; s < 3; ++s) {
+        for (size_t i = 0; i < 4; ++i) {
+          for (size_t j = 0; j < 4; ++j) {
+            REQUIRE(std::abs(a(k, s, i, j) - (ref(k, s, i, j) + shift(j))) < 1e-12);
+          }
+        }
+      }
+    }
+    a -= shift;
+    REQUIRE(a == ref);
+    // broadcasting of both operands: (4, 1) and (4) give (4, 4)
+    ndarray::ndarray<double, 2> outer = col * 2.0 - shift;
+    REQUIRE(outer.shape() == std::array<size_t, 2>{4, 4});
+    REQUIRE(std::abs(outer(2, 3) - (2.0 * col(2, 0) - shift(3))) < 1e-12);
+    // lower dimensional expressions are broadcast as a whole
+    ndarray::ndarray<double, 4> b = a + (shift + 1.0) * 0.5 - col;
+    REQUIRE(std::abs(b(1, 2, 3, 1) - (a(1, 2, 3, 1) + (shift(1) + 1.0) * 0.5 - col(3, 0))) < 1e-12);
+    // zero-stride views
+    ndarray::ndarray<double, 3> view = ndarray::broadcast_to(shift, std::array<size_t, 3>{5, 3, 4});
+    REQUIRE(view.strides() == std::array<size_t, 3>{0, 0, 1});
+    REQUIRE(view.storage().data().ptr == shift.storage().data().ptr);
+    REQUIRE(view(4, 2, 1) == shift(1));
+    REQUIRE(ndarray::broadcast_to(col, std::array<size_t, 2>{4, 6})(3, 5) == col(3, 0));
+    ndarray::ndarray<double, 3> copy = view.copy();
+    REQUIRE(copy(3, 1, 2) == shift(2));
+    // incompatible shapes
+    ndarray::ndarray<double, 1> wrong(3);
+    REQUIRE_THROWS_AS(a + wrong, std::runtime_error);
+    REQUIRE_THROWS_AS(a += wrong, std::runtime_error);
+    REQUIRE_THROWS_AS(ndarray::broadcast_to(wrong, std::array<size_t, 2>{2, 4}), std::runtime_error);
+    // destination is never broadcast
+    REQUIRE_THROWS_AS(col += outer, std::runtime_error);
+  }
+
+  SECTION("Reductions") {
+    ndarray::ndarray<double, 3> a(5, 7, 300);
+    initialize_array(a);
+    double ref = 0;
+    double mx  = a(0, 0, 0);
+    double mn  = a(0, 0, 0);
+    double nrm = 0;
+    for (size_t i = 0; i < 5; ++i) {
+      for (size_t j = 0; j < 7; ++j) {
+        for (size_t k = 0; k < 300; ++k) {
+          ref += a(i, j, k);
+          mx = std::max(mx, a(i, j, k));
+          mn = std::min(mn, a(i, j, k));
+          nrm += a(i, j, k) * a(i, j, k);
+        }
+      }
+    }
+    for (auto mode : {ndarray::summation::naive, ndarray::summation::pairwise, ndarray::summation::kahan}) {
+      REQUIRE(std::abs(ndarray::sum(a, mode) - ref) < 1e-9 * std::abs(ref));
+    }
+    REQUIRE(ndarray::max(a) == mx);
+    REQUIRE(ndarray::min(a) == mn);
+    REQUIRE(std::abs(ndarray::norm(a) - std::sqrt(nrm)) < 1e-9 * std::sqrt(nrm));
+    REQUIRE(std::abs(ndarray::dot(a, a) - nrm) < 1e-9 * nrm);
+    // reductions along an axis
+    ndarray::ndarray<double, 2> s1 = ndarray::sum(a, 1);
+    ndarray::ndarray<double, 2> m2 = ndarray::max(a, 2);
+    REQUIRE(s1.shape() == std::array<size_t, 2>{5, 300});
+    REQUIRE(m2.shape() == std::array<size_t, 2>{5, 7});
+    double s = 0;
+    double m = a(3, 4, 0);
+    for (size_t j = 0; j < 7; ++j) s += a(2, j, 17);
+    for (size_t k = 0; k < 300; ++k) m = std::max(m, a(3, 4, k));
+    REQUIRE(std::abs(s1(2, 17) - s) < 1e-12);
+    REQUIRE(m2(3, 4) == m);
+    REQUIRE(std::abs(ndarray::sum(ndarray::sum(a, 0), 0)(123) - ndarray::sum(a(ndarray::all, ndarray::all, 123))) < 1e-12);
+    REQUIRE_THROWS_AS(ndarray::sum(a, 3), std::logic_error);
+    // strided views give the same results as their contiguous copies
+    auto view = ndarray::transpose_view(a, "ijk->kji")(ndarray::range(1, 300, 3), ndarray::all, ndarray::range(0, 5, 2));
+    auto copy = view.copy();
+    REQUIRE(std::abs(ndarray::sum(view) - ndarray::sum(copy)) < 1e-12 * std::abs(ndarray::sum(copy)));
+    REQUIRE(ndarray::min(view) == ndarray::min(copy));
+    REQUIRE(std::abs(ndarray::dot(view, copy) - ndarray::dot(copy, copy)) < 1e-12 * ndarray::dot(copy, copy));
+    REQUIRE(ndarray::sum(view, 1) == ndarray::sum(copy, 1));
+    // compensated summation does not lose small terms
+    ndarray::ndarray<double, 1> big(10001);
+    big.set_value(1e-16);
+    big(0) = 1.0;
+    REQUIRE(ndarray::sum(big, ndarray::summation::naive) == 1.0);
+    REQUIRE(std::abs(ndarray::sum(big, ndarray::summation::kahan) - (1.0 + 1e-12)) < 1e-15);
+    // complex arrays and traces
+    ndarray::ndarray<std::complex<double>, 3> c(3, 4, 4);
+    initialize_array(c);
+    std::complex<double> tr = 0;
+    double               cn = 0;
+    for (size_t i = 0; i < 4; ++i) tr += c(1, i, i);
+    for (auto x = c.begin(); x != c.end(); ++x) cn += std::norm(*x);
+    REQUIRE(std::abs(ndarray::trace(c)(1) - tr) < 1e-12);
+    REQUIRE(std::abs(ndarray::trace(c(1, ndarray::all, ndarray::all)) - tr) < 1e-12);
+    REQUIRE(std::abs(ndarray::norm(c) - std::sqrt(cn)) < 1e-12);
+    REQUIRE(std::abs(ndarray::sum(c) - std::accumulate(c.begin(), c.end(), std::complex<double>(0))) < 1e-10);
+    // reductions of empty arrays
+    ndarray::ndarray<double, 2> empty(std::array<size_t, 2>{0, 3});
+    REQUIRE(ndarray::sum(empty) == 0.0);
+    REQUIRE_THROWS_AS(ndarray::max(empty), std::runtime_error);
+  }
+
+  SECTION("Allclose") {
+    ndarray::ndarray<std::complex<double>, 3> a(4, 5, 70);
+    initialize_array(a);
+    ndarray::ndarray<std::complex<double>, 3> b = a.copy();
+    REQUIRE(ndarray::allclose(a, b));
+    REQUIRE(ndarray::max_abs_diff(a, b) == 0.0);
+    // relative tolerance is scaled by the magnitude of the reference
+    b(2, 3, 60) *= 1.0 + 1e-6;
+    REQUIRE(ndarray::allclose(a, b));
+    REQUIRE_FALSE(ndarray::allclose(a, b, 1e-7, 0.0));
+    REQUIRE(std::abs(ndarray::max_abs_diff(a, b) - 1e-6 * std::abs(a(2, 3, 60))) < 1e-12 * std::abs(a(2, 3, 60)));
+    // values close to the tolerance boundary are compared exactly
+    b = a.copy();
+    b(1, 1, 1) += std::complex<double>(3e-8, 4e-8);
+    REQUIRE(ndarray::allclose(a, b, 0.0, 5.0001e-8));
+    REQUIRE_FALSE(ndarray::allclose(a, b, 0.0, 4.9999e-8));
+    REQUIRE(std::abs(ndarray::max_abs_diff(a, b) - 5e-8) < 1e-15);
+    REQUIRE_FALSE(a == b);
+    b(1, 1, 1) = std::complex<double>(std::nan(""), 0.0);
+    REQUIRE_FALSE(ndarray::allclose(a, b, 1.0, 1.0));
+    REQUIRE(std::isnan(ndarray::max_abs_diff(a, b)));
+    // squares of large magnitudes overflow, such elements are compared on magnitudes
+    {
+      ndarray::ndarray<double, 1> x(300);
+      ndarray::ndarray<double, 1> y(300);
+      x.set_value(1e200);
+      y.set_value(1e200);
+      REQUIRE(ndarray::allclose(x, y));
+      y(100) = -1e200;
+      REQUIRE_FALSE(ndarray::allclose(x, y));
+      REQUIRE(ndarray::max_abs_diff(x, y) == 2e200);
+      y(100) = 1e200 * (1.0 + 1e-3);
+      REQUIRE_FALSE(ndarray::allclose(x, y));
+      REQUIRE(ndarray::allclose(x, y, 2e-3));
+      ndarray::ndarray<std::complex<double>, 1> xc = x.astype<std::complex<double>>();
+      ndarray::ndarray<std::complex<double>, 1> yc = x.astype<std::complex<double>>();
+      REQUIRE(ndarray::allclose(xc, yc));
+      yc(7) = std::complex<double>(0.0, -1e200);
+      REQUIRE_FALSE(ndarray::allclose(xc, yc));
+      REQUIRE(std::abs(ndarray::max_abs_diff(xc, yc) - std::sqrt(2.0) * 1e200) < 1e188);
+      ndarray::ndarray<float, 1> xf(10);
+      ndarray::ndarray<float, 1> yf(10);
+      xf.set_value(1e20f);
+      yf.set_value(1e20f);
+      yf(3) = -1e20f;
+      REQUIRE_FALSE(ndarray::allclose(xf, yf));
+      REQUIRE(ndarray::max_abs_diff(xf, yf) == 2e20f);
+    }
+    // strided views
+    b = a.copy();
+    auto va = ndarray::transpose_view(a, "ijk->kji")(ndarray::range(3, 70, 2));
+    auto vb = ndarray::transpose_view(b, "ijk->kji")(ndarray::range(3, 70, 2));
+    REQUIRE(ndarray::allclose(va, vb.copy()));
+    b(3, 4, 4) += 1.0;
+    REQUIRE(ndarray::allclose(va, vb));
+    b(3, 4, 7) += 1.0;
+    REQUIRE_FALSE(ndarray::allclose(va, vb));
+    REQUIRE(std::abs(ndarray::max_abs_diff(va, vb) - 1.0) < 1e-12);
+    // mixed types
+    ndarray::ndarray<double, 3> r(4, 5, 70);
+    initialize_array(r);
+    ndarray::ndarray<float, 3>  f = r.astype<float>();
+    REQUIRE(ndarray::allclose(f, r, 1e-6));
+    REQUIRE_FALSE(ndarray::allclose(f, r, 0.0, 0.0));
+  }
+
+  SECTION("CopyOnWrite") {
+    ndarray::ndarray<double, 3> a(3, 4, 5);
+    initialize_array(a);
+    ndarray::ndarray<double, 3> ref = a.copy();
+    REQUIRE_FALSE(a.is_copy_on_write());
+#ifndef GREEN_NDARRAY_COPY_ON_WRITE
+    REQUIRE_THROWS_AS(a.set_copy_on_write(), std::logic_error);
+    a.set_copy_on_write(false);
+#else
+    a.set_copy_on_write();
+    // sharing does not allocate
+    ndarray::ndarray<double, 3> b = a;
+    REQUIRE(b.is_copy_on_write());
+    REQUIRE(b.storage().data().ptr == a.storage().data().ptr);
+    const auto& cb = b;
+    REQUIRE(cb(1, 2, 3) == ref(1, 2, 3));
+    REQUIRE(b.storage().data().ptr == a.storage().data().ptr);
+    // first write detaches the writer
+    b(1, 2, 3) = -1.0;
+    REQUIRE(b.storage().data().ptr != a.storage().data().ptr);
+    REQUIRE(b.is_copy_on_write());
+    REQUIRE(a.storage().data().count == 1);
+    REQUIRE(a == ref);
+    REQUIRE(b(1, 2, 3) == -1.0);
+    // unique arrays are modified in place
+    const void* ptr = b.storage().data().ptr;
+    b(0, 0, 0)      = 2.0;
+    b += 1.0;
+    REQUIRE(b.storage().data().ptr == ptr);
+    // expressions, compound operators and raw pointers detach as well
+    ndarray::ndarray<double, 3> c = a;
+    c *= 2.0;
+    REQUIRE(a == ref);
+    REQUIRE(c == ndarray::ndarray<double, 3>(ref * 2.0));
+    ndarray::ndarray<double, 3> d = a;
+    d << ref * 3.0;
+    REQUIRE(a == ref);
+    ndarray::ndarray<double, 3> e = a;
+    e.data()[0]                   = 7.0;
+    *e.begin()                    = 7.0;
+    REQUIRE(a == ref);
+    // slices of an unshared array are written in place
+    {
+      ndarray::ndarray<double, 3> u = ref.copy();
+      u.set_copy_on_write();
+      const void* ptr = u.storage().data().ptr;
+      u(ndarray::range(0, 2)) += ref(ndarray::range(0, 2));
+      u(1) << ref(2);
+      u(2, ndarray::range(0, 2)).set_value(2.0);
+      ndarray::transpose_view(u, "ijk->kji")(0, 0, 0) = 1.0;
+      REQUIRE(u.storage().data().ptr == ptr);
+      REQUIRE(u(1, 2, 3) == ref(2, 2, 3));
+      REQUIRE(u(0, 1, 1) == 2.0 * ref(0, 1, 1));
+      REQUIRE(u(2, 1, 4) == 2.0);
+      REQUIRE(u(0, 0, 0) == 1.0);
+      // copies of views are views of the same parent
+      auto view      = u(1);
+      auto view_copy = view;
+      view_copy(0, 0) = -3.0;
+      REQUIRE(u(1, 0, 0) == -3.0);
+      // parent with views is written in place, a new holder gets its own elements
+      ndarray::ndarray<double, 3> holder = u;
+      REQUIRE(holder.storage().data().ptr != ptr);
+      u(1, 0, 0) = -5.0;
+      REQUIRE(view(0, 0) == -5.0);
+      view(0, 1) = -6.0;
+      REQUIRE(u(1, 0, 1) == -6.0);
+      REQUIRE(holder(1, 0, 0) == -3.0);
+      REQUIRE(holder(1, 0, 1) == ref(2, 0, 1));
+    }
+    // slice of a shared array detaches the parent first, other holders are not affected
+    {
+      ndarray::ndarray<double, 3> parent = a;
+      parent(1) << ref(2);
+      parent(0, ndarray::range(0, 2)).set_value(0.0);
+      REQUIRE(parent.storage().data().ptr != a.storage().data().ptr);
+      REQUIRE(parent(1, 3, 4) == ref(2, 3, 4));
+      REQUIRE(parent(0, 1, 2) == 0.0);
+      REQUIRE(a == ref);
+    }
+    // views of a shared array created by free functions can not tell their parent
+    {
+      ndarray::ndarray<double, 3> parent = a;
+      auto                        view   = ndarray::transpose_view(parent, "ijk->kji");
+      REQUIRE_THROWS_AS(view(0, 0, 0) = 1.0, std::logic_error);
+      parent.detach_if_shared();
+      ndarray::transpose_view(parent, "ijk->kji")(0, 0, 0) = 1.0;
+      REQUIRE(parent(0, 0, 0) == 1.0);
+      REQUIRE(a == ref);
+      ndarray::ndarray<double, 3> snapshot = view.copy();
+      snapshot.set_value(0.0);
+      REQUIRE(a == ref);
+    }
+    // view that is the last holder of its memory is written in place
+    {
+      ndarray::ndarray<double, 3> parent = a.copy();
+      parent.set_copy_on_write();
+      auto last  = parent(0);
+      parent     = ndarray::ndarray<double, 3>();
+      last(0, 0) = -4.0;
+      REQUIRE(last(0, 0) == -4.0);
+    }
+    // constant views never detach
+    ndarray::ndarray<const double, 3> cv = a;
+    a(0, 0, 0)                           = 5.0;
+    REQUIRE(cv(0, 0, 0) == ref(0, 0, 0));
+    REQUIRE(a(0, 0, 0) == 5.0);
+#ifdef GREEN_NDARRAY_INSTRUMENT
+    // operands of expressions are only read and never copied
+    {
+      ndarray::ndarray<double, 3> shared = a;
+      ndarray::ndarray<double, 3> d2     = ref.copy();
+      ndarray::reset_instrumentation();
+      ndarray::ndarray<double, 3> c2 = a * 2.0;
+      d2 += a;
+      auto f2 = a.astype<float>();
+      REQUIRE(ndarray::sum(a) == ndarray::sum(shared));
+      REQUIRE(ndarray::instrumentation_snapshot().deep_copies == 1);
+      REQUIRE(a.storage().data().ptr == shared.storage().data().ptr);
+    }
+#endif
+    // mode survives reallocation
+    a.resize(2, 2, 2);
+    REQUIRE(a.is_copy_on_write());
+#endif
+    // default mode shares writes
+    ndarray::ndarray<double, 1> f(10);
+    ndarray::ndarray<double, 1> g = f;
+    g(3)                          = 1.0;
+    REQUIRE(f(3) == 1.0);
+  }
+
+  SECTION("Instrumentation") {
+    using ndarray::kernel_kind;
+    ndarray::ndarray<double, 3> a(4, 5, 6);
+    initialize_array(a);
+    ndarray::reset_instrumentation();
+    ndarray::set_kernel_timing(true);
+    const auto before = ndarray::instrumentation_snapshot();
+    // reset clears counters and timings, live memory stays accounted
+    REQUIRE(before.allocations == 0);
+    REQUIRE(before.deep_copies == 0);
+    REQUIRE(before.peak_live_bytes == before.live_bytes);
+    for (const auto& timing : before.kernels) {
+      REQUIRE(timing.calls == 0);
+      REQUIRE(timing.seconds == 0.0);
+    }
+    {
+      ndarray::ndarray<double, 3>               t = transpose(a, "ijk->kji");
+      ndarray::ndarray<std::complex<double>, 3> z = a.astype<std::complex<double>>();
+      ndarray::ndarray<double, 3>               r = a * 2.0;
+      REQUIRE(sum(r) > 0.0);
+      // views do not allocate
+      auto view = t(ndarray::range(1, 3));
+      REQUIRE(view.size() == 40);
+    }
+    const auto after = ndarray::instrumentation_snapshot();
+    ndarray::set_kernel_timing(false);
+#ifdef GREEN_NDARRAY_INSTRUMENT
+    const size_t bytes = a.size() * (2 * sizeof(double) + sizeof(std::complex<double>));
+    REQUIRE(after.allocations == 3);
+    REQUIRE(after.deallocations == 3);
+    REQUIRE(after.allocated_bytes == bytes);
+    REQUIRE(after.live_bytes == before.live_bytes);
+    REQUIRE(after.peak_live_bytes == before.live_bytes + bytes);
+    // transpose() and astype()
+    REQUIRE(after.deep_copies == 2);
+    REQUIRE(after.copied_bytes == a.size() * (sizeof(double) + sizeof(std::complex<double>)));
+    REQUIRE(after.kernel(kernel_kind::copy).calls == 1);
+    REQUIRE(after.kernel(kernel_kind::elementwise).calls == 2);
+    REQUIRE(after.kernel(kernel_kind::reduction).calls == 1);
+    REQUIRE(after.kernel(kernel_kind::contraction).calls == 0);
+    REQUIRE(after.kernel(kernel_kind::elementwise).seconds > 0.0);
+    // timing is disabled, counters are still updated
+    a.copy();
+    REQUIRE(ndarray::instrumentation_snapshot().kernel(kernel_kind::copy).calls == 1);
+    REQUIRE(ndarray::instrumentation_snapshot().deep_copies == 3);
+    ndarray::reset_instrumentation();
+    const auto reset = ndarray::instrumentation_snapshot();
+    REQUIRE(reset.allocations == 0);
+    REQUIRE(reset.deep_copies == 0);
+    REQUIRE(reset.peak_live_bytes == reset.live_bytes);
+    REQUIRE(reset.live_bytes == before.live_bytes);
+#else
+    static_assert(!ndarray::instrumentation_enabled);
+    REQUIRE(after.allocations == 0);
+    REQUIRE(after.peak_live_bytes == 0);
+    REQUIRE(after.deep_copies == 0);
+    REQUIRE(after.kernel(kernel_kind::copy).calls == 0);
+#endif
+  }
+}
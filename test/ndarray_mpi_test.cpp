@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/mpi_storage.h>
+#include <green/ndarray/ndarray_math.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.h"
+
+TEST_CASE("NDArrayMPITest") {
+  SECTION("SharedWindow") {
+    auto a = ndarray::shared_window_ndarray<double>(std::array<size_t, 3>{4, 5, 6});
+    REQUIRE(a.storage().release() == ndarray::mpi_window_deallocation);
+    REQUIRE(a.is_contiguous());
+    int node_size;
+    MPI_Comm_size(ndarray::shared_window_comm(a), &node_size);
+    int rank = ndarray::shared_window_rank(a);
+    ndarray::ndarray<double, 3> ref(4, 5, 6);
+    initialize_array(ref);
+    if (rank == 0) a << ref;
+    ndarray::shared_window_fence(a);
+    REQUIRE(a == ref);
+    // every rank writes its own element, writes are visible to all ranks of the node
+    ndarray::shared_window_fence(a);
+    if (rank < 4) a(rank, 0, 0) = -rank;
+    ndarray::shared_window_fence(a);
+    REQUIRE(a(0, 0, 0) == 0.0);
+    if (node_size > 1) REQUIRE(a(1, 0, 0) == -1.0);
+    ndarray::shared_window_fence(a);
+    // window stays alive while a view references it
+    ndarray::ndarray<const double, 2> view;
+    {
+      auto b = ndarray::shared_window_ndarray<double>(std::array<size_t, 2>{10, 10});
+      if (ndarray::shared_window_rank(b) == 0) b.set_value(3.0);
+      ndarray::shared_window_fence(b);
+      view = b(ndarray::range(2, 4));
+    }
+    REQUIRE(view.storage().data().count == 1);
+    REQUIRE(view(1, 9) == 3.0);
+    // empty window
+    auto e = ndarray::shared_window_ndarray<double>(std::array<size_t, 2>{0, 10});
+    REQUIRE(e.size() == 0);
+  }
+
+  SECTION("Errors") {
+    ndarray::ndarray<double, 2> a(3, 4);
+    REQUIRE_THROWS_AS(ndarray::shared_window_rank(a), std::logic_error);
+    REQUIRE_THROWS_AS(ndarray::shared_window_fence(a), std::logic_error);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  int result = Catch::Session().run(argc, argv);
+  MPI_Finalize();
+  return result;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/ndarray_math.h>
+#include <green/ndarray/parallel.h>
+
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace {
+  /**
+   * Simple executor that runs tasks on a fixed number of threads with round-robin task assignment
+   */
+  struct thread_executor {
+    size_t                               n_threads;
+    std::shared_ptr<std::atomic<size_t>> calls = std::make_shared<std::atomic<size_t>>(0);
+
+    void operator()(size_t n_tasks, const std::function<void(size_t)>& task) const {
+      ++(*calls);
+      std::vector<std::thread> threads;
+      for (size_t t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t]() {
+          for (size_t i = t; i < n_tasks; i += n_threads) task(i);
+        });
+      }
+      for (auto& th : threads) th.join();
+    }
+  };
+
+  /**
+   * Restore default parallel settings at the end of the scope
+   */
+  struct parallel_settings_guard {
+    size_t threshold = ndarray::parallel_threshold();
+    size_t grain     = ndarray::parallel_grain();
+    ~parallel_settings_guard() {
+      ndarray::set_parallel_threshold(threshold);
+      ndarray::set_parallel_grain(grain);
+      ndarray::set_parallel_executor({});
+    }
+  };
+}  // namespace
+
+TEST_CASE("NDArrayParallelTest") {
+  parallel_settings_guard guard;
+
+  SECTION("Chunks") {
+    ndarray::set_parallel_threshold(100);
+    ndarray::set_parallel_grain(10);
+    std::vector<std::pair<size_t, size_t>> chunks(100);
+    std::atomic<size_t>                    n_chunks{0};
+    ndarray::detail::parallel_for(95, 1, [&](size_t b, size_t e) { chunks[n_chunks++] = {b, e}; });
+    // below threshold everything is executed as a single chunk
+    REQUIRE(n_chunks == 1);
+    REQUIRE(chunks[0] == std::pair<size_t, size_t>{0, 95});
+    n_chunks = 0;
+    ndarray::detail::parallel_for(105, 1, [&](size_t b, size_t e) { chunks[n_chunks++] = {b, e}; });
+    REQUIRE(n_chunks == 11);
+    std::sort(chunks.begin(), chunks.begin() + n_chunks);
+    for (size_t i = 0; i < n_chunks; ++i) {
+      REQUIRE(chunks[i].first == i * 10);
+      REQUIRE(chunks[i].second == std::min(size_t(105), (i + 1) * 10));
+    }
+    // items of 5 elements give chunks of 2 items
+    n_chunks = 0;
+    ndarray::detail::parallel_for(21, 5, [&](size_t b, size_t e) { chunks[n_chunks++] = {b, e}; });
+    REQUIRE(n_chunks == 11);
+  }
+
+  SECTION("Executor") {
+    thread_executor executor{3};
+    ndarray::set_parallel_threshold(64);
+    ndarray::set_parallel_grain(16);
+    ndarray::set_parallel_executor(executor);
+
+    ndarray::ndarray<double, 3> a(7, 9, 11);
+    ndarray::ndarray<double, 3> b(7, 9, 11);
+    REQUIRE(*executor.calls > 0);
+    initialize_array(a);
+    initialize_array(b);
+    std::vector<double> ref(a.size());
+    for (size_t i = 0; i < a.size(); ++i) ref[i] = a.data()[i] + 2.0 * b.data()[i];
+
+    ndarray::ndarray<double, 3> c = a + 2.0 * b;
+    REQUIRE(std::equal(ref.begin(), ref.end(), c.begin()));
+    c -= a;
+    c += a;
+    c *= 2.0;
+    c /= 2.0;
+    REQUIRE(std::equal(ref.begin(), ref.end(), c.begin(), [](double x, double y) { return std::abs(x - y) < 1e-12; }));
+    ndarray::ndarray<double, 3> d = -c;
+    REQUIRE(std::abs(d(6, 8, 10) + ref.back()) < 1e-12);
+    c.set_value(3.0);
+    REQUIRE(std::all_of(c.begin(), c.end(), [](double x) { return x == 3.0; }));
+
+    ndarray::ndarray<double, 3> e = a.copy();
+    REQUIRE(e == a);
+    e(3, 4, 5) += 1.0;
+    REQUIRE_FALSE(e == a);
+    auto z = a.astype<std::complex<double>>();
+    REQUIRE(z == a);
+    ndarray::ndarray<std::complex<double>, 3> z2(7, 9, 11);
+    z2 << a;
+    REQUIRE(z2 == a);
+    ndarray::ndarray<double, 3> t = transpose(a, "ijk->kji");
+    REQUIRE(t(10, 8, 6) == a(6, 8, 10));
+    REQUIRE(t(3, 1, 2) == a(2, 1, 3));
+    ndarray::ndarray<double, 3> s = transpose_view(a, "ijk->kji") + 1.0;
+    REQUIRE(s(10, 8, 6) == a(6, 8, 10) + 1.0);
+    REQUIRE(s(3, 1, 2) == a(2, 1, 3) + 1.0);
+  }
+
+  SECTION("DefaultBackend") {
+    // OpenMP if enabled, serial execution otherwise
+    ndarray::set_parallel_threshold(64);
+    ndarray::set_parallel_grain(16);
+    ndarray::ndarray<std::complex<double>, 2> a(33, 17);
+    initialize_array(a);
+    ndarray::ndarray<std::complex<double>, 2> b = a * 2.0 - a;
+    REQUIRE(b == a);
+    ndarray::ndarray<std::complex<double>, 2> t = transpose(transpose(a, "ij->ji"), "ij->ji");
+    REQUIRE(t == a);
+  }
+  SECTION("Reductions") {
+    // chunking does not depend on the number of threads, so results are bitwise reproducible
+    ndarray::ndarray<double, 3> a(7, 33, 65);
+    initialize_array(a);
+    auto   view   = ndarray::transpose_view(a, "ijk->kji");
+    double serial = ndarray::sum(view);
+    double axis   = ndarray::sum(a, 1)(3, 7);
+    ndarray::set_parallel_threshold(64);
+    ndarray::set_parallel_grain(16);
+    double chunked = ndarray::sum(view);
+    double slice   = ndarray::sum(a(ndarray::all, 5));
+    thread_executor executor{3};
+    ndarray::set_parallel_executor(executor);
+    for (size_t it = 0; it < 10; ++it) {
+      REQUIRE(ndarray::sum(view) == chunked);
+      REQUIRE(ndarray::sum(a(ndarray::all, 5)) == slice);
+    }
+    REQUIRE(*executor.calls > 0);
+    REQUIRE(std::abs(chunked - serial) < 1e-12 * std::abs(serial));
+    REQUIRE(ndarray::sum(a, 1)(3, 7) == axis);
+    REQUIRE(ndarray::max(view) == ndarray::max(a));
+    REQUIRE(std::abs(ndarray::dot(view, view) - ndarray::dot(a, a)) < 1e-12 * ndarray::dot(a, a));
+    ndarray::ndarray<double, 3> b = view.copy();
+    REQUIRE(ndarray::allclose(view, b));
+    b(60, 20, 1) += 1e-3;
+    REQUIRE_FALSE(ndarray::allclose(view, b));
+    REQUIRE(std::abs(ndarray::max_abs_diff(b, view) - 1e-3) < 1e-9);
+  }
+#ifndef GREEN_NDARRAY_SINGLE_THREADED
+  SECTION("SharedViews") {
+    // concurrent copies and releases of views of the same array
+    ndarray::ndarray<double, 3> a(8, 16, 16);
+    initialize_array(a);
+    std::vector<std::thread> threads;
+    std::atomic<size_t>      mismatches{0};
+    for (size_t t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t]() {
+        for (size_t it = 0; it < 2000; ++it) {
+          ndarray::ndarray<double, 2> slice = a(it % 8);
+          ndarray::ndarray<double, 2> other(slice);
+          other = slice;
+          if (other(t, 3) != a(it % 8, t, 3)) ++mismatches;
+        }
+      });
+    }
+    for (auto& th : threads) th.join();
+    REQUIRE(mismatches == 0);
+    REQUIRE(a.storage().data().count == 1);
+  }
+#endif
+}
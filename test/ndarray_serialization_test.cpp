@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2023 University of Michigan
+ *
+ */
+
+#include <green/ndarray/ndarray_math.h>
+#include <green/ndarray/serialization.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <glob.h>
+#include <numeric>
+#include <thread>
+
+#include "common.h"
+
+namespace {
+  /**
+   * @return number of temporary files left by `save` next to `path`
+   */
+  size_t temporaries(const std::string& path) {
+    glob_t found;
+    if (glob((path + ".??????").c_str(), 0, nullptr, &found) != 0) return 0;
+    size_t count = found.gl_pathc;
+    globfree(&found);
+    return count;
+  }
+}  // namespace
+
+TEST_CASE("NDArraySerializationTest") {
+  SECTION("SaveLoad") {
+    temporary_file                            file;
+    ndarray::ndarray<std::complex<double>, 3> a(3, 4, 5);
+    initialize_array(a);
+    ndarray::save(file.path, a);
+    auto header = ndarray::read_binary_header(file.path);
+    REQUIRE(header.dtype() == "c16");
+    REQUIRE(header.shape == std::vector<size_t>{3, 4, 5});
+    REQUIRE(header.data_offset == 64);
+    auto b = ndarray::load<std::complex<double>, 3>(file.path);
+    REQUIRE(b.storage().data().ptr != a.storage().data().ptr);
+    REQUIRE(b == a);
+    auto c = ndarray::load<const std::complex<double>, 3>(file.path);
+    REQUIRE(c == a);
+
+    ndarray::ndarray<std::int32_t, 1> i(7);
+    std::iota(i.begin(), i.end(), -3);
+    ndarray::save(file.path, i);
+    REQUIRE(ndarray::read_binary_header(file.path).dtype() == "i4");
+    REQUIRE(ndarray::load<std::int32_t, 1>(file.path) == i);
+    // no temporary file is left behind
+    REQUIRE(temporaries(file.path) == 0);
+  }
+
+  SECTION("ConcurrentSave") {
+    temporary_file              file;
+    ndarray::ndarray<double, 2> a(64, 64);
+    ndarray::ndarray<double, 2> b(64, 64);
+    a.set_value(1.0);
+    b.set_value(2.0);
+    auto writer = [&file](const ndarray::ndarray<double, 2>& array) {
+      for (int i = 0; i < 20; ++i) ndarray::save(file.path, array);
+    };
+    std::thread first(writer, std::cref(a));
+    std::thread second(writer, std::cref(b));
+    first.join();
+    second.join();
+    auto loaded = ndarray::load<double, 2>(file.path);
+    REQUIRE((loaded == a || loaded == b));
+    REQUIRE(temporaries(file.path) == 0);
+  }
+
+  SECTION("Views") {
+    temporary_file              file;
+    ndarray::ndarray<double, 3> a(6, 5, 4);
+    initialize_array(a);
+    auto view = ndarray::transpose(a(ndarray::range(1, 6, 2), ndarray::all, ndarray::range(1)), "ijk->kji");
+    ndarray::save(file.path, view);
+    REQUIRE(ndarray::read_binary_header(file.path).shape == std::vector<size_t>{3, 5, 3});
+    REQUIRE(ndarray::load<double, 3>(file.path) == view.copy());
+    ndarray::ndarray<double, 2> empty(size_t(0), 10);
+    ndarray::save(file.path, empty);
+    REQUIRE(ndarray::load<double, 2>(file.path).shape() == empty.shape());
+  }
+
+  SECTION("Map") {
+    temporary_file                            file;
+    ndarray::ndarray<std::complex<double>, 2> a(13, 7);
+    initialize_array(a);
+    ndarray::save(file.path, a);
+    ndarray::ndarray<const std::complex<double>, 2> mapped;
+    {
+      ndarray::map_options options;
+      options.advice = ndarray::map_advice::sequential;
+      mapped         = ndarray::load<const std::complex<double>, 2>(file.path, options);
+    }
+    REQUIRE(mapped.storage().release() == ndarray::mmap_deallocation);
+    REQUIRE(mapped.offset() * sizeof(std::complex<double>) == 64);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(mapped.data()) % 64 == 0);
+    REQUIRE(mapped == a);
+    // array mapped from the previous file stays valid when the file is replaced
+    ndarray::save(file.path, ndarray::ndarray<double, 1>(3));
+    REQUIRE(mapped == a);
+    // changes of writable mappings are stored in the file
+    ndarray::save(file.path, a);
+    {
+      ndarray::map_options options;
+      options.mode    = ndarray::map_mode::read_write;
+      auto writable   = ndarray::load<std::complex<double>, 2>(file.path, options);
+      writable(12, 6) = 1.0i;
+    }
+    REQUIRE(ndarray::load<std::complex<double>, 2>(file.path)(12, 6) == 1.0i);
+  }
+
+  SECTION("Errors") {
+    temporary_file              file;
+    ndarray::ndarray<double, 2> a(2, 3);
+    ndarray::save(file.path, a);
+    REQUIRE_THROWS_AS((ndarray::load<float, 2>(file.path)), std::runtime_error);
+    REQUIRE_THROWS_AS((ndarray::load<std::int64_t, 2>(file.path)), std::runtime_error);
+    REQUIRE_THROWS_AS((ndarray::load<double, 3>(file.path)), std::runtime_error);
+    REQUIRE_THROWS_AS((ndarray::load<double, 2>(file.path, ndarray::map_options{})), std::logic_error);
+    REQUIRE_THROWS_AS((ndarray::load<double, 2>(file.path + ".missing")), std::runtime_error);
+    // truncated data
+    REQUIRE(truncate(file.path.c_str(), 64 + 5 * sizeof(double)) == 0);
+    REQUIRE_THROWS_AS((ndarray::load<double, 2>(file.path)), std::runtime_error);
+    REQUIRE_THROWS_AS((ndarray::load<const double, 2>(file.path, ndarray::map_options{})), std::runtime_error);
+    // corrupted shape and dimension
+    auto patch = [&file](size_t offset, std::uint64_t value) {
+      std::fstream stream(file.path, std::ios::in | std::ios::out | std::ios::binary);
+      stream.seekp(std::streamoff(offset));
+      stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto corrupted = [&file]() {
+      try {
+        ndarray::read_binary_header(file.path);
+      } catch (const std::runtime_error& e) {
+        return std::string(e.what()).find("corrupted header") != std::string::npos;
+      }
+      return false;
+    };
+    ndarray::ndarray<double, 2> b(2, 2);
+    ndarray::save(file.path, b);
+    patch(40, std::uint64_t(1) << 32);
+    patch(48, std::uint64_t(1) << 29);
+    REQUIRE(corrupted());
+    REQUIRE_THROWS_AS((ndarray::load<double, 2>(file.path)), std::runtime_error);
+    patch(40, std::uint64_t(1) << 63);
+    patch(48, 2);
+    REQUIRE(corrupted());
+    ndarray::save(file.path, b);
+    patch(24, std::uint64_t(1) << 61);
+    REQUIRE(corrupted());
+    // not an array file
+    std::ofstream(file.path) << "some text that is long enough to hold a header, but is not a header";
+    REQUIRE_THROWS_AS(ndarray::read_binary_header(file.path), std::runtime_error);
+  }
+}
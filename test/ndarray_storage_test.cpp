@@ -5,9 +5,14 @@
 
 #include <green/ndarray/storage.h>
 
+#include <algorithm>
 #include <catch2/catch_test_macros.hpp>
 #include <complex>
 #include <functional>
+#include <limits>
+#include <map>
+#include <thread>
+#include <vector>
 
 namespace gn = green::ndarray;
 
@@ -17,6 +22,43 @@ size_t getAddress(std::function<void(gn::shared_mem_blk&)> f) {
   return (size_t)*fnPointer;
 }
 
+namespace {
+  struct counting_resource : gn::memory_resource {
+    size_t allocations   = 0;
+    size_t deallocations = 0;
+    void*  allocate(size_t size, const gn::allocation_policy& policy) override {
+      ++allocations;
+      return gn::aligned_allocate(size, policy);
+    }
+    void deallocate(void* ptr, size_t, const gn::allocation_policy&) override {
+      ++deallocations;
+      std::free(ptr);
+    }
+  };
+
+  /**
+   * Resource that counts blocks released with another size or policy than they were allocated with
+   */
+  struct policy_checking_resource : gn::memory_resource {
+    std::map<void*, std::pair<size_t, gn::allocation_policy>> blocks;
+    size_t                                                     mismatches = 0;
+    void* allocate(size_t size, const gn::allocation_policy& policy) override {
+      void* ptr   = gn::aligned_allocate(size, policy);
+      blocks[ptr] = {size, policy};
+      return ptr;
+    }
+    void deallocate(void* ptr, size_t size, const gn::allocation_policy& policy) override {
+      const auto& [original_size, original] = blocks.at(ptr);
+      if (size != original_size || policy.alignment != original.alignment ||
+          policy.huge_page_threshold != original.huge_page_threshold) {
+        ++mismatches;
+      }
+      blocks.erase(ptr);
+      std::free(ptr);
+    }
+  };
+}  // namespace
+
 TEST_CASE("Storage") {
   SECTION("Create") {
     gn::storage_t* st1 = new gn::storage_t;
@@ -91,6 +133,10 @@ TEST_CASE("Storage") {
     st1.reset(x.data());
     const gn::shared_mem_blk* ref = &st1.data();
     REQUIRE(ref->ptr == x.data());
+    // memory obtained with malloc is released with free
+    st1.reset(std::malloc(64), gn::standard_deallocation, 64);
+    REQUIRE(getAddress(st1.release()) == (size_t)&gn::free_deallocation);
+    REQUIRE(st1.data().size == 64);
   }
   SECTION("Change Storage type") {
     std::vector<double> x(100);
@@ -123,4 +169,186 @@ TEST_CASE("Storage") {
     REQUIRE_THROWS(st2.get<std::complex<double>>());
 #endif
   }
-}
\ No newline at end of file
+
+  SECTION("Aligned allocation") {
+    gn::storage_t st1(100);
+    REQUIRE(size_t(st1.data().ptr) % 64 == 0);
+    REQUIRE(st1.data().policy.alignment == 64);
+    gn::allocation_policy policy{4096, 0};
+    gn::storage_t         st2(100, policy);
+    REQUIRE(size_t(st2.data().ptr) % 4096 == 0);
+    REQUIRE(st2.data().size == 100);
+    gn::allocation_policy huge{64, 1ul << 20};
+    gn::storage_t         st3(4ul << 20, huge);
+    REQUIRE(size_t(st3.data().ptr) % gn::huge_page_size == 0);
+    gn::storage_t st4(100, huge);
+    REQUIRE(size_t(st4.data().ptr) % 64 == 0);
+    REQUIRE_THROWS_AS(gn::storage_t(100, gn::allocation_policy{48, 0}), std::invalid_argument);
+    auto          old_policy                    = gn::default_allocation_policy();
+    gn::default_allocation_policy().alignment = 256;
+    gn::storage_t st5(10);
+    REQUIRE(size_t(st5.data().ptr) % 256 == 0);
+    gn::default_allocation_policy() = old_policy;
+  }
+  SECTION("Pool resource") {
+    gn::pool_resource pool;
+    {
+      gn::scoped_memory_resource scope(pool);
+      for (int i = 0; i < 10; ++i) {
+        gn::storage_t st(100 * 100 * sizeof(double));
+        REQUIRE(st.data().resource == &pool);
+        REQUIRE(size_t(st.data().ptr) % 64 == 0);
+      }
+      // different size class should not reuse the cached block
+      gn::storage_t st(10);
+      REQUIRE(pool.statistics().misses == 2);
+    }
+    gn::pool_statistics stats = pool.statistics();
+    REQUIRE(stats.hits == 9);
+    REQUIRE(stats.misses == 2);
+    REQUIRE(stats.blocks_held == 2);
+    REQUIRE(stats.bytes_held == gn::pool_resource::size_class(100 * 100 * sizeof(double)) +
+                                    gn::pool_resource::size_class(gn::detail::mem_blk_allocation_size(10)));
+    REQUIRE(gn::pool_resource::size_class(100 * 100 * sizeof(double)) == 80 * 1024);
+    REQUIRE(gn::pool_resource::size_class(100) == 128);
+    // outside of the scope default resource is used
+    gn::storage_t st(100);
+    REQUIRE(st.data().resource == gn::default_memory_resource());
+    REQUIRE(dynamic_cast<gn::small_block_resource*>(gn::default_memory_resource()) != nullptr);
+    pool.release();
+    REQUIRE(pool.statistics().bytes_held == 0);
+    REQUIRE(pool.statistics().blocks_held == 0);
+  }
+
+  SECTION("Pool resource limit") {
+    gn::pool_resource pool(1024);
+    {
+      gn::storage_t st1(512, gn::default_allocation_policy(), pool);
+      gn::storage_t st2(600, gn::default_allocation_policy(), pool);
+      gn::storage_t st3(2000, gn::default_allocation_policy(), pool);
+    }
+    // only the first released block fits into the limit
+    REQUIRE(pool.statistics().blocks_held == 1);
+    REQUIRE(pool.statistics().bytes_held <= 1024);
+  }
+  SECTION("Pool resource policies") {
+    policy_checking_resource upstream;
+    {
+      gn::pool_resource     pool(std::numeric_limits<size_t>::max(), &upstream);
+      gn::allocation_policy plain{64, 0};
+      gn::allocation_policy huge{64, 1 << 20};
+      gn::allocation_policy other_huge{64, 3 << 20};
+      const size_t          size = 4 << 20;
+      void*                 ptr  = pool.allocate(size, plain);
+      pool.deallocate(ptr, size, plain);
+      // block without huge pages is not reused for a huge page request
+      void* huge_ptr = pool.allocate(size, huge);
+      REQUIRE(pool.statistics().misses == 2);
+      REQUIRE(size_t(huge_ptr) % gn::huge_page_size == 0);
+      pool.deallocate(huge_ptr, size, huge);
+      // blocks with the same huge page advice are interchangeable and keep their original policy
+      void* reused = pool.allocate(size, other_huge);
+      REQUIRE(reused == huge_ptr);
+      REQUIRE(pool.statistics().hits == 1);
+      // blocks above the limit are returned with their original policy as well
+      gn::pool_resource small(64, &upstream);
+      void*             big = small.allocate(1000, huge);
+      small.deallocate(big, 1000, plain);
+      pool.deallocate(reused, size, other_huge);
+      pool.release();
+    }
+    REQUIRE(upstream.blocks.empty());
+    REQUIRE(upstream.mismatches == 0);
+  }
+  SECTION("Single allocation") {
+    counting_resource resource;
+    {
+      gn::scoped_memory_resource scope(resource);
+      // empty storages share a static control block and do not allocate
+      gn::storage_t st1;
+      gn::storage_t st2(st1);
+      gn::storage_t st3;
+      st3 = st1;
+      REQUIRE(&st1.data() == &st2.data());
+      REQUIRE(&st1.data() == &st3.data());
+      REQUIRE(st2.data().count == 0);
+      gn::storage_t st4(100);
+      REQUIRE(resource.allocations == 1);
+      // control block is placed right after the data
+      REQUIRE((const char*)&st4.data() >= (const char*)st4.data().ptr + 100);
+      REQUIRE((const char*)&st4.data() < (const char*)st4.data().ptr + 100 + alignof(gn::shared_mem_blk));
+      gn::storage_t st5(std::move(st4));
+      REQUIRE(st4.data().ptr == nullptr);
+      REQUIRE(st5.data().count == 1);
+      st4 = st5;
+      REQUIRE(st5.data().count == 2);
+    }
+    REQUIRE(resource.allocations == 1);
+    REQUIRE(resource.deallocations == 1);
+  }
+  SECTION("Small blocks") {
+    counting_resource upstream;
+    {
+      gn::small_block_resource small(512, &upstream);
+      std::vector<gn::storage_t> storages;
+      {
+        gn::scoped_memory_resource scope(small);
+        for (size_t i = 0; i < 2000; ++i) storages.emplace_back(8 * (i % 40));
+        // 2000 blocks of up to 384 bytes fit into a few slabs
+        REQUIRE(upstream.allocations == small.slabs());
+        REQUIRE(small.slabs() <= 8);
+        // neighbouring storages are carved from the same slab
+        auto distance = (const char*)storages[2].data().ptr - (const char*)storages[1].data().ptr;
+        REQUIRE(distance == 64);
+        REQUIRE(size_t(storages[7].data().ptr) % 64 == 0);
+        // released blocks are reused by allocations of the same class
+        void* ptr   = storages[5].data().ptr;
+        storages[5] = gn::storage_t();
+        storages[5] = gn::storage_t(40);
+        REQUIRE(storages[5].data().ptr == ptr);
+        // large and over-aligned blocks bypass the slabs
+        gn::storage_t large(4096);
+        gn::storage_t aligned(16, gn::allocation_policy{4096, 0});
+        REQUIRE(upstream.allocations == small.slabs() + 2);
+        REQUIRE(size_t(aligned.data().ptr) % 4096 == 0);
+      }
+      REQUIRE(upstream.deallocations == 2);
+    }
+    REQUIRE(upstream.deallocations == upstream.allocations);
+  }
+  SECTION("Small blocks in threads") {
+    counting_resource upstream;
+    {
+      gn::small_block_resource small(512, &upstream);
+      // every thread releases blocks allocated by a thread of the previous pair
+      std::vector<std::vector<gn::storage_t>> storages(8);
+      auto                                    work = [&](size_t t) {
+        gn::scoped_memory_resource scope(small);
+        for (size_t i = 0; i < 1000; ++i) storages[t].emplace_back(8 * (i % 40));
+        if (t > 1) storages[t - 2].clear();
+      };
+      for (size_t round = 0; round < 2; ++round) {
+        for (size_t t = 0; t < storages.size(); t += 2) {
+          std::thread first(work, t), second(work, t + 1);
+          first.join();
+          second.join();
+        }
+        if (round == 0) {
+          // blocks of exited threads are returned to the shared lists and reused by new threads
+          size_t slabs = small.slabs();
+          for (auto& s : storages) s.clear();
+          std::thread(work, 0).join();
+          REQUIRE(small.slabs() == slabs);
+          storages[0].clear();
+        }
+      }
+      std::vector<const void*> pointers;
+      for (const auto& s : storages)
+        for (const auto& st : s) pointers.push_back(st.data().ptr);
+      std::sort(pointers.begin(), pointers.end());
+      REQUIRE(std::adjacent_find(pointers.begin(), pointers.end()) == pointers.end());
+      REQUIRE(upstream.allocations == small.slabs());
+    }
+    REQUIRE(upstream.deallocations == upstream.allocations);
+  }
+}
@@ -96,6 +96,47 @@ TEST_CASE("NDArrayTest") {
     REQUIRE(array.shape() == shape);
   }
 
+  SECTION("Init Uninitialized") {
+    std::array<size_t, 3>       shape{3, 4, 5};
+    ndarray::ndarray<double, 3> array(shape, ndarray::uninitialized);
+    ndarray::ndarray<double, 3> array2(std::vector<size_t>{3, 4, 5}, ndarray::uninitialized);
+    REQUIRE(array.shape() == shape);
+    REQUIRE(array2.shape() == shape);
+    REQUIRE(array.size() == 60);
+    REQUIRE(array.strides()[0] == 20);
+    REQUIRE(array.storage().data().size == 60 * sizeof(double));
+    REQUIRE(array.storage().data().count == 1);
+    initialize_array(array);
+    array2 << array;
+    REQUIRE(std::equal(array.begin(), array.end(), array2.begin()));
+  }
+
+  SECTION("Init With External Memory") {
+    std::vector<double>         data(2 * 3 * 5);
+    initialize_array(data);
+    std::vector<double>         data_copy = data;
+    ndarray::ndarray<double, 3> array(data.data(), 2, 3, 5);
+    REQUIRE(array.data() == data.data());
+    REQUIRE(array.storage().data().size == data.size() * sizeof(double));
+    REQUIRE(std::equal(data.begin(), data.end(), data_copy.begin()));
+    REQUIRE(array(1, 2, 3) == data[1 * 15 + 2 * 5 + 3]);
+    ndarray::ndarray<double, 3> zero_array(data.data(), std::array<size_t, 3>{2, 3, 5}, ndarray::zero_fill);
+    REQUIRE(std::all_of(data.begin(), data.end(), [](double x) { return x == 0.0; }));
+  }
+
+  SECTION("Init With Allocation Policy") {
+    ndarray::allocation_policy  policy{512, 0};
+    ndarray::ndarray<double, 3> array(std::array<size_t, 3>{3, 4, 5}, policy);
+    REQUIRE(size_t(array.data()) % 512 == 0);
+    REQUIRE(std::all_of(array.begin(), array.end(), [](double x) { return x == 0.0; }));
+    ndarray::ndarray<double, 3> array2(std::vector<size_t>{3, 4, 5}, policy, ndarray::uninitialized);
+    REQUIRE(size_t(array2.data()) % 512 == 0);
+    // resize keeps allocation policy
+    array.resize(5, 6, 7);
+    REQUIRE(size_t(array.data()) % 512 == 0);
+    REQUIRE(array.storage().data().policy.alignment == 512);
+  }
+
   SECTION("Init NULL Array and assign new reference") {
     std::array<size_t, 4>       shape{2, 2, 1, 1};
     std::vector<double>         data{1, 2, 30, 2};
@@ -149,6 +190,52 @@ TEST_CASE("NDArrayTest") {
     REQUIRE(array2_ref.shape()[2] == 5);
   }
 
+  SECTION("Strided Slice") {
+    ndarray::ndarray<double, 3> array(6, 7, 12);
+    initialize_array(array);
+    // a(:, 3, 2:10)
+    auto view = array(ndarray::all, 3, ndarray::range(2, 10));
+    REQUIRE(view.shape() == std::array<size_t, 2>{6, 8});
+    REQUIRE(view.strides() == std::array<size_t, 2>{7 * 12, 1});
+    REQUIRE(!view.is_contiguous());
+    REQUIRE(view.storage().data().ptr == array.storage().data().ptr);
+    for (size_t i = 0; i < 6; ++i) {
+      for (size_t k = 0; k < 8; ++k) {
+        REQUIRE(view(i, k) == array(i, 3, k + 2));
+      }
+    }
+    // every other element along the first axis, trailing axes are taken entirely
+    auto even = array(ndarray::range(0, 6, 2));
+    REQUIRE(even.shape() == std::array<size_t, 3>{3, 7, 12});
+    REQUIRE(even(2, 4, 5) == array(4, 4, 5));
+    // step that does not divide the extent, stop beyond the extent is clamped
+    auto odd = array(1, ndarray::range(1, 100, 3), ndarray::all);
+    REQUIRE(odd.shape() == std::array<size_t, 2>{2, 12});
+    REQUIRE(odd(1, 11) == array(1, 4, 11));
+    // views of views
+    auto sub = even(ndarray::all, ndarray::range(1, 7, 2), 5);
+    REQUIRE(sub.shape() == std::array<size_t, 2>{3, 3});
+    REQUIRE(sub(1, 2) == array(2, 5, 5));
+    // writes through the view are visible in the parent array
+    sub(0, 0) = -1.0;
+    REQUIRE(array(0, 1, 5) == -1.0);
+    // rows along the last axis are still contiguous
+    REQUIRE(array(ndarray::range(1, 3)).is_contiguous());
+    REQUIRE(array(2, ndarray::all).is_contiguous());
+    // empty range
+    auto empty = array(ndarray::range(4, 4));
+    REQUIRE(empty.size() == 0);
+    REQUIRE(empty.copy().size() == 0);
+    // copy of a strided view is contiguous
+    ndarray::ndarray<double, 2> copy = view.copy();
+    REQUIRE(copy.is_contiguous());
+    REQUIRE(copy(5, 7) == array(5, 3, 9));
+    const ndarray::ndarray<double, 3>& carray = array;
+    ndarray::ndarray<const double, 2>  cview  = carray(ndarray::all, ndarray::all, 0);
+    REQUIRE(cview(3, 4) == array(3, 4, 0));
+    REQUIRE_THROWS_AS(array(ndarray::range(0, 6, 0)), std::logic_error);
+  }
+
   SECTION("Scalar") {
     ndarray::ndarray<double, 5> array(1, 2, 3, 4, 5);
     initialize_array(array);
@@ -309,6 +396,57 @@ TEST_CASE("NDArrayTest") {
     REQUIRE(ref_val == &array(0, 0, 0, 0, 0));
   }
 
+  SECTION("Reserve") {
+    ndarray::ndarray<double, 2> array(10, 10);
+    REQUIRE(array.capacity() == 100);
+    const void* ptr = array.storage().data().ptr;
+    // shrinking and growing within capacity reuse memory
+    array.resize(5, 3);
+    REQUIRE(array.storage().data().ptr == ptr);
+    REQUIRE(array.capacity() == 100);
+    array.resize(10, 10);
+    REQUIRE(array.storage().data().ptr == ptr);
+    array.resize(11, 10);
+    REQUIRE(array.storage().data().ptr != ptr);
+    REQUIRE(array.capacity() == 110);
+    // reserve keeps elements
+    array.resize(3, 4);
+    initialize_array(array);
+    auto ref = array.copy();
+    array.reserve(1000);
+    REQUIRE(array.capacity() == 1000);
+    REQUIRE(std::equal(ref.begin(), ref.end(), array.begin()));
+    ptr = array.storage().data().ptr;
+    array.resize(20, 50);
+    REQUIRE(array.storage().data().ptr == ptr);
+    array.resize(3, 4);
+    array.reserve(10);
+    REQUIRE(array.capacity() == 1000);
+    // shrink_to_fit releases unused memory
+    array << ref;
+    array.shrink_to_fit();
+    REQUIRE(array.capacity() == 12);
+    REQUIRE(std::equal(ref.begin(), ref.end(), array.begin()));
+    // empty arrays can reserve memory in advance
+    ndarray::ndarray<double, 2> empty;
+    empty.reserve(64);
+    REQUIRE(empty.capacity() == 64);
+    ptr = empty.storage().data().ptr;
+    empty.resize(8, 8);
+    REQUIRE(empty.storage().data().ptr == ptr);
+    // shared memory is never reused
+    ndarray::ndarray<double, 2> shared = empty;
+    REQUIRE(shared.capacity() == shared.size());
+    REQUIRE_THROWS_AS(shared.reserve(100), std::logic_error);
+    shared.resize(std::array<size_t, 2>{2, 2}, false);
+    REQUIRE(shared.storage().data().ptr != ptr);
+    // external memory is not owned
+    std::vector<double>         external(100);
+    ndarray::ndarray<double, 1> ext(external.data(), std::array<size_t, 1>{100});
+    ext.resize(50);
+    REQUIRE(ext.data() != external.data());
+  }
+
   SECTION("View") {
     ndarray::ndarray<double, 5> darray(4, 2, 3, 4, 4);
     initialize_array(darray);
@@ -329,6 +467,24 @@ TEST_CASE("NDArrayTest") {
     REQUIRE(darray.shape() == darray5.shape());
     REQUIRE(
         std::equal(darray.begin(), darray.end(), darray5.begin(), [](double a, double b) { return std::abs(a - b) < 1e-12; }));
+    // strided views keep strides and offset of the source
+    auto zslice = zarray(ndarray::range(1, 4, 2), 1, ndarray::all, ndarray::range(1, 3));
+    auto dslice = zslice.view<double>();
+    REQUIRE(dslice.shape() == std::array<size_t, 4>{2, 3, 2, 4});
+    REQUIRE(dslice(1, 2, 1, 1) == zslice(1, 2, 1, 0).imag());
+    REQUIRE(dslice(0, 1, 0, 2) == zslice(0, 1, 0, 1).real());
+    auto zback = dslice.view<std::complex<double>>();
+    REQUIRE(zback.data() == zslice.data());
+    REQUIRE(zback.strides() == zslice.strides());
+    auto dcol = darray(ndarray::all, ndarray::all, 1, ndarray::range(1, 3), ndarray::range(2, 4));
+    REQUIRE(dcol.view<std::complex<double>>()(3, 1, 1, 0).imag() == darray(3, 1, 1, 2, 3));
+    // offset that is not aligned to the new type is reported instead of truncated
+    auto dshift = darray(ndarray::all, ndarray::all, ndarray::all, ndarray::all, ndarray::range(1, 3));
+    REQUIRE_THROWS_AS(dshift.view<std::complex<double>>(), std::runtime_error);
+    auto dodd = darray(ndarray::all, ndarray::all, ndarray::all, ndarray::range(0, 4, 2), ndarray::range(0, 4, 2));
+    REQUIRE_THROWS_AS(dodd.view<std::complex<double>>(), std::logic_error);
+    REQUIRE_THROWS_AS(zarray(ndarray::all, ndarray::all, ndarray::all, ndarray::all, 1).view<double>(),
+                      std::logic_error);
   }
 
   SECTION("Astype") {